@@ -199,6 +199,17 @@ void EState<PT>::show() const {
 }
 
 
+template <class PT>
+tuple<VUI, VUI> EState<PT>::ueNdx() const {
+  const unsigned int na = pstns.size();
+  VUI keys = {};
+  keys.reserve(na);
+  for (unsigned int i = 0; i < na; i++) {
+    keys.push_back(posNdx(i));
+  }
+  return KBase::ueIndicesByKey<unsigned int>(keys);
+}
+
 template <class PT>
 bool EState<PT>::equivNdx(unsigned int i, unsigned int j) const {
   if (i >= pstns.size()) {
@@ -325,10 +336,6 @@ EState<PT>* EState<PT>::doSUSN(ReportingLevel rl) const {
     throw KException("EState<PT>::doSUSN: eIndices' size should be equal to number of actors");
   }
 
-  // Utilities to actors of the currently occupied positions.
-  // All have same beliefs in this demo
-  const auto u = aUtil[0];
-
   const auto vpm = eMod->vpm; // get the 'victory probability model'
   const unsigned int numP = pstns.size();
   auto uUnique = uMatH(0);
@@ -358,175 +365,64 @@ EState<PT>* EState<PT>::doSUSN(ReportingLevel rl) const {
   // which can provide the extra structure of a derived class.
   auto s2 = makeNewEState();
 
-  if (0 != s2->pstns.size()) {
-    throw KException("EState<PT>::doSUSN: s2 shouldn't have any positions yet");
-  }
-  for (unsigned int h = 0; h < numA; h++) {
-    s2->pstns.push_back(nullptr);
-  }
-  // TODO: clean up the nesting of lambda-functions: ~200 lines is too long
-  // perhaps create a hypothetical state and run setOneAUtil(h,Silent) on it
-
-  // Evaluate h's estimate of the expected utility, to h, of
-  // advocating position mp. To do this, build a hypothetical utility matrix representing
-  // h's estimates of the direct utilities to all other actors of h adopting this
-  // Position. Do that by modifying the h-column of h's matrix.
-  // Then compute the expected probability distribution, over h's hypothetical position
-  // and everyone else's actual position. Finally, compute the expected utility to
-  // each actor, given that distribution, and pick out the value for h's expected utility.
-  // That is the expected value to h of adopting the position.
-  // ehFN :: (int, EPosition<PT>) ==> double
-  auto ehFN = [this, rl, u](unsigned int h, const EPosition<PT> & eph)  {
-    // This correctly handles duplicated/unique options
-    // We modify the given utility matrix so that the h-column
-    // corresponds to the given mph, but we need to prune duplicates as well.
-    // This entails some type-juggling.
-
-    const int eNdx = eph.getIndex();
-    if (0 > eNdx) {
-      throw KException("EState<PT>::doSUSN: index must be non-negative");
-    }
-    auto uVec = actorUtilVectFn(h, eNdx);
-
-    // all have same beliefs in this demo: verify
-    const KMatrix uh0 = aUtil[h]; // constant
-    if (KBase::maxAbs(u - uh0) >= 1E-10) {
-      throw KException("EState<PT>::doSUSN: all actors dont have beliefs");
-    }
-    auto uh = uh0; // to be modified
-
-    for (unsigned int i = 0; i < eMod->numAct; i++) {
-      // lookup h's prior evaluation of utils over the enumerated space
-      // of utility to actor i of this hypothetical position by h
-      double uih = uVec[i];
-      uh(i, h) = uih;
-    }
-
-
-    // 'uh' now has the correct h-column. Now we need to see how many options
-    // are unique in the hypothetical state, and keep only those columns.
-    // This entails juggling back and forth between the all current positions
-    // and the one hypothetical position (mph at h).
-    // Thus, the next call to expUtilMat will consider only unique options.
-
-    // Compare indices to see if the positions are equivalent.
-    // For h, use the hypothetical 'eph', and for all others use
-    // the stored pointers.
-    // Cannot use State::equivNdx because the comparisons for index 'h'
-    // use the hypothetical mph, not pstns[h]
-    auto equivHNdx = [this, h, eph](const unsigned int i, const unsigned int j) {
-      int ni = (i == h) ? eph.getIndex() : posNdx(i);
-      int nj = (j == h) ? eph.getIndex() : posNdx(j);
-      return (ni == nj);
-    };
-
-    auto ns = KBase::uiSeq(0, model->numAct - 1);
-    const VUI uNdx = get<0>(KBase::ueIndices<unsigned int>(ns, equivHNdx));
-    const unsigned int numU = uNdx.size();
-    auto hypUtil = KMatrix(eMod->numAct, numU);
-    // we need now to go through 'uh', copying column J the first time
-    // the J-th position is determined to be equivalent to something in the unique list
-    for (unsigned int i = 0; i < eMod->numAct; i++) {
-      for (unsigned int j1 = 0; j1 < numU; j1++) {
-        unsigned int j2 = uNdx[j1];
-        hypUtil(i, j1) = uh(i, j2); // hypothetical utility in column h
-      }
-    }
-
-    if (false) {
-      LOG(INFO) << "constructed hypUtil matrix:";
-      hypUtil.mPrintf(" %8.2f ");
+  // The State constructor pre-sizes pstns with null pointers,
+  // so check that nothing has been filled in yet rather than that it is empty.
+  for (auto p : s2->pstns) {
+    if (nullptr != p) {
+      throw KException("EState<PT>::doSUSN: s2 shouldn't have any positions yet");
     }
+  }
+  s2->pstns.resize(numA, nullptr);
 
+  bool parP = KBase::testMultiThreadSQLite(false, rl);
 
-    if (ReportingLevel::Low < rl) {
-      LOG(INFO) << "--------------------------------------- ";
-      LOG(INFO) << KBase::getFormattedString("Assessing utility to %2i of hypo-pos: ", h);
-      LOG(INFO) << eph;
-      LOG(INFO) << "Hypo-util minus base util: ";
-      (uh - uh0).mPrintf(" %+.4E ");
+  // concurrent execution works, but mixes up the printed log.
+  // So we disable it if reporting is desired.
+  parP = parP && (rl <= ReportingLevel::Low);
+  if (ReportingLevel::Silent < rl) {
+    if (parP) {
+      LOG(INFO) << "Will continue with multi-threaded execution";
     }
-
-    const KMatrix eu = expUtilMat(rl,
-                                  eMod->numAct, pstns.size(), eMod->vpm,
-                                  hypUtil); // uh or hypUtil
-    const double euh = eu(h, 0);
-    if (0.0 > euh) {
-      throw KException("EState<PT>::doSUSN: euh must be non-negative");
+    else {
+      LOG(INFO) << "Will continue with single-threaded execution";
     }
-    return euh;
-  };
-  // end of ehFN
-
+  }
 
+  // For each actor h and each option theta[t], h's estimate of the expected utility
+  // to h of advocating theta[t] while everyone else keeps their actual position.
+  // All the (h,t) hypotheses are scored in one batch, sharing the coalitions
+  // among the positions which the hypothesis does not change.
+  const KMatrix heu = hypExpUtilMat(rl, parP);
 
+  // Because the 'neighbors' of any position are ALL the enumerated positions,
+  // a hill-climb from h's current position reaches the best option in one sweep.
+  // This picks exactly what GHCSearch would (first strict maximum, and only if it
+  // beats the current position by more than sTol) without re-evaluating anything.
   // 'Returns' void in order to have the right type-signature for threading.
-  // Does a generic hill climb to find the best next position for actor h,
-  // and stores it in s2.
-  // To do that, it uses three functions for evaluation, neighbors, and show:
-  // efn, nghbrPerms, and sfn.
-  auto newPosFn = [this, ehFN, rl,  u, eu0, s2](const unsigned int h)  {
-    if (ReportingLevel::Low < rl) {
-      LOG(INFO) << "Started newPosFn for "<<h;
-    }
-    s2->pstns[h] = nullptr;
-    auto ph = ((const EPosition<PT>*)(pstns[h]));
-    auto ghc = new KBase::GHCSearch<EPosition<PT>>();
-
-    ghc->eval = [ehFN, h](const EPosition<PT>  eph)  {
-      return ehFN(h, eph);
-    };
+  auto newPosFn = [this, rl, &heu, eu0, s2](const unsigned int h)  {
+    const double sTol = 0.001; // stable-tol, as previously used for GHCSearch
     const unsigned int numOpt = eMod->numOptions();
-
-    // The 'neighbors' in general are ALL the enumerated positions,
-    // so it does not even use the actor's current position
-    auto nfn = [this, rl, numOpt](const EPosition<PT> & ) {
-      vector<EPosition<PT>> ns = {};
-      //ns.resize(numOpt); // compiler tries to fill with EPosition(), and fails.
-      for (unsigned int i=0; i<numOpt; i++) {
-        auto ep = EPosition<PT>(eMod, i);
-        ns.push_back(ep);
-      }
-      if (ReportingLevel::Low < rl) {
-        LOG(INFO) << "Found "<<ns.size()<<" neighbors";
-      }
-      if (0 >= ns.size()) {
-        throw KException("EState<PT>::doSUSN: ns must be positive");
+    const unsigned int n0 = posNdx(h);
+    const double v0 = heu(h, n0);
+    unsigned int nBest = n0;
+    double vBest = v0;
+    for (unsigned int t = 0; t < numOpt; t++) {
+      if (heu(h, t) > vBest) {
+        vBest = heu(h, t);
+        nBest = t;
       }
-      return ns;
-    };
-
-    ghc->nghbrs = nfn;
-
-    // show some representation of this position on cout
-    ghc->show = [](const EPosition<PT> & ep) {
-      LOG(INFO) << ep ;
-      return;
-    };
-
-    if (ReportingLevel::Low < rl) {
-      LOG(INFO) << "---------------------------------------- ";
-      LOG(INFO) << KBase::getFormattedString("Search for best next-position of actor %2i ", h);
     }
-    auto rslt = ghc->run(*ph, // start from h's current positions
-                         ReportingLevel::Silent,
-                         100, // iter max
-                         3, 0.001); // stable-max, stable-tol
-    double vBest = get<0>(rslt);
-    EPosition<PT> pBest = get<1>(rslt);
-    unsigned int iterN = get<2>(rslt);
-    unsigned int stblN = get<3>(rslt);
-    delete ghc;
-    ghc = nullptr;
+    if (!(vBest > v0 + sTol)) {
+      vBest = v0;
+      nBest = n0;
+    }
+    auto posBest = new EPosition<PT>(eMod, nBest);
 
     if (ReportingLevel::Medium < rl) {
-      LOG(INFO) << KBase::getFormattedString("Iter: %u  Stable: %u \n", iterN, stblN);
       LOG(INFO) << KBase::getFormattedString("Best value for %2i: %+.6f \n", h, vBest);
-      LOG(INFO) << "Best position:    " << pBest;
+      LOG(INFO) << "Best position:    " << (*posBest);
     }
 
-    auto posBest = new EPosition<PT>(pBest);
-
     // Actually record the new position
     s2->pstns[h] = posBest;
     // no need for mutex, as s2->pstns is the only shared var,
@@ -541,7 +437,7 @@ EState<PT>* EState<PT>::doSUSN(ReportingLevel rl) const {
         LOG(INFO) << KBase::getFormattedString("  du = %+.6f \n", du);
       }
     }
-    // Logically, du should always be non-negative, as GHC never returns a worse value than the starting point.
+    // Logically, du should always be non-negative, as we never return a worse value than the starting point.
     // However, actors plan on the assumption that all others do not change - yet they do.
     const double eps = 0.0001; //  enough to avoid problems with round-off error
     if (-eps > du) {
@@ -551,28 +447,9 @@ EState<PT>* EState<PT>::doSUSN(ReportingLevel rl) const {
   };
   // end of newPosFn
 
-  bool parP = KBase::testMultiThreadSQLite(false, rl);
-
-  // concurrent execution works, but mixes up the printed log.
-  // So we disable it if reporting is desired.
-  parP = parP && (rl <= ReportingLevel::Low);
-  if (ReportingLevel::Silent < rl) {
-    if (parP) {
-      LOG(INFO) << "Will continue with multi-threaded execution";
-    }
-    else {
-      LOG(INFO) << "Will continue with single-threaded execution";
-    }
-  }
-
   // Each actor, h, finds the position which maximizes their EU in this situation.
-  if (parP) {
-    KBase::groupThreads(newPosFn, 0, numA - 1);
-  }
-  else {
-    for (unsigned int h = 0; h < numA; h++) {
-      newPosFn(h);
-    }
+  for (unsigned int h = 0; h < numA; h++) {
+    newPosFn(h);
   }
   if (nullptr == s2) {
     throw KException("EState<PT>::doSUSN: s2 is a null pointer");
@@ -881,14 +758,182 @@ EState<PT>* EState<PT>::doMCN(ReportingLevel rl) const {
 // end of doMCN
 
 template<class PT>
-KMatrix EState<PT>::hypExpUtilMat () const {
-  KMatrix eu;
+KMatrix EState<PT>::hypExpUtilMat (ReportingLevel rl, bool parP) const {
+  const unsigned int numA = eMod->numAct;
+  const unsigned int numOpt = eMod->numOptions();
+  if (numA != pstns.size()) {
+    throw KException("EState<PT>::hypExpUtilMat: count of actors and count of positions should match");
+  }
+  if (numA != aUtil.size()) {
+    throw KException("EState<PT>::hypExpUtilMat: every actor must have a utility matrix");
+  }
 
-  // TODO: fix or delete hypExpUtilMat?
-  throw KException("EState<PT>::hypExpUtilMat: dummy method");
+  // all have same beliefs in this demo: verify
+  const KMatrix u = aUtil[0];
+  for (unsigned int h = 1; h < numA; h++) {
+    if (KBase::maxAbs(u - aUtil[h]) >= 1E-10) {
+      throw KException("EState<PT>::hypExpUtilMat: all actors dont have beliefs");
+    }
+  }
 
-  return eu;
+  // Cache everything which does not depend on the hypothesis:
+  // voting rules, weights, the columns of u, and the index into theta
+  // of each actor's current position.
+  vector<VotingRule> vrs = {};
+  vector<double> wts = {};
+  vector<vector<double>> uCols = {};
+  vector<unsigned int> pNdx = {};
+  for (unsigned int j = 0; j < numA; j++) {
+    auto aj = (const EActor<PT>*)(eMod->actrs[j]);
+    vrs.push_back(aj->vr);
+    wts.push_back(aj->sCap);
+    vector<double> cj = {};
+    for (unsigned int k = 0; k < numA; k++) {
+      cj.push_back(u(k, j));
+    }
+    uCols.push_back(cj);
+    pNdx.push_back(posNdx(j));
+  }
+
+  // The uniqueness test is done on theta-indices, so it needs only O(1) work per actor:
+  // firstHolder[t] is the lowest actor currently at theta[t] (numA if none), and
+  // nPrev[j] counts the actors before j who share j's position.
+  vector<unsigned int> firstHolder(numOpt, numA);
+  vector<unsigned int> nPrev(numA, 0);
+  for (unsigned int j = 0; j < numA; j++) {
+    const unsigned int nj = pNdx[j];
+    if (numA == firstHolder[nj]) {
+      firstHolder[nj] = j;
+    }
+    for (unsigned int k = 0; k < j; k++) {
+      if (pNdx[k] == nj) {
+        nPrev[j]++;
+      }
+    }
+  }
+
+  // Coalition strengths for and against column ci over column cj, summed
+  // in exactly the same order as Model::coalitions.
+  const double minC = 1E-8; // same floor as Model::coalitions
+  auto pairC = [numA, minC, &vrs, &wts](const vector<double> & ci, const vector<double> & cj) {
+    double cij = minC;
+    double cji = minC;
+    for (unsigned int k = 0; k < numA; k++) {
+      const double vkij = Model::vote(vrs[k], wts[k], ci[k], cj[k]);
+      if (vkij > 0) {
+        cij = cij + vkij;
+      }
+      if (vkij < 0) {
+        cji = cji - vkij;
+      }
+    }
+    return tuple<double, double>(cij, cji);
+  };
+
+  // The shared base: coalitions between every pair of current positions.
+  // A hypothesis by h changes only the h-column, so everything else is looked up here.
+  auto cBase = KMatrix(numA, numA);
+  for (unsigned int i = 0; i < numA; i++) {
+    for (unsigned int j = 0; j < i; j++) {
+      auto cc = pairC(uCols[i], uCols[j]);
+      cBase(i, j) = get<0>(cc);
+      cBase(j, i) = get<1>(cc);
+    }
+    cBase(i, i) = minC;
+  }
+
+  auto heu = KMatrix(numA, numOpt);
+
+  // Fill row h: h's expected utility from each option, others unchanged.
+  // Rows are written by exactly one thread each, so no mutex is needed.
+  auto rowFn = [this, rl, numA, numOpt, minC, &pairC, &cBase, &uCols, &pNdx, &firstHolder, &nPrev, &heu](unsigned int h) {
+    const double tol = 1E-10; // same round-off allowance as expUtilMat
+    VUI uNdx = {};
+    uNdx.reserve(numA);
+    for (unsigned int t = 0; t < numOpt; t++) {
+      const vector<double> uVec = actorUtilVectFn(h, t);
+      if (numA != uVec.size()) {
+        throw KException("EState<PT>::hypExpUtilMat: actorUtilVectFn must return a value for every actor");
+      }
+      for (auto ui : uVec) {
+        if ((ui + tol < 0.0) || (1.0 + tol < ui)) {
+          throw KException("EState<PT>::hypExpUtilMat: utility out of range [0,1]");
+        }
+      }
+
+      // unique positions of the hypothetical state, in order of first occurrence,
+      // exactly as ueIndices would have found them
+      uNdx.clear();
+      for (unsigned int j = 0; j < numA; j++) {
+        bool firstP = false;
+        if (j == h) {
+          firstP = !(firstHolder[t] < h);
+        }
+        else {
+          const bool hWasBefore = (h < j) && (pNdx[h] == pNdx[j]);
+          const bool othersBefore = (nPrev[j] > (hWasBefore ? 1 : 0));
+          const bool hNowBefore = (h < j) && (t == pNdx[j]);
+          firstP = !othersBefore && !hNowBefore;
+        }
+        if (firstP) {
+          uNdx.push_back(j);
+        }
+      }
+      const unsigned int numU = uNdx.size();
+
+      auto c = KMatrix(numU, numU);
+      for (unsigned int i1 = 0; i1 < numU; i1++) {
+        const unsigned int ai = uNdx[i1];
+        for (unsigned int j1 = 0; j1 < i1; j1++) {
+          const unsigned int aj = uNdx[j1];
+          if ((ai != h) && (aj != h)) {
+            c(i1, j1) = cBase(ai, aj);
+            c(j1, i1) = cBase(aj, ai);
+          }
+          else {
+            auto cc = pairC((ai == h) ? uVec : uCols[ai], (aj == h) ? uVec : uCols[aj]);
+            c(i1, j1) = get<0>(cc);
+            c(j1, i1) = get<1>(cc);
+          }
+        }
+        c(i1, i1) = minC;
+      }
+
+      const auto ppv = Model::probCE2(eMod->pcem, eMod->vpm, c);
+      const auto p = get<0>(ppv); // column
+      double euh = 0.0;
+      for (unsigned int j1 = 0; j1 < numU; j1++) {
+        const unsigned int aj = uNdx[j1];
+        const double uhj = (aj == h) ? uVec[h] : uCols[aj][h];
+        euh = euh + uhj*p(j1, 0);
+      }
+      if (euh + tol < 0.0) {
+        throw KException("EState<PT>::hypExpUtilMat: euh must be non-negative");
+      }
+      if (1.0 + tol < euh) {
+        throw KException("EState<PT>::hypExpUtilMat: euh must not exceed 1.0");
+      }
+      heu(h, t) = euh;
+    }
+
+    if (ReportingLevel::Medium < rl) {
+      LOG(INFO) << KBase::getFormattedString("Hypothetical EU to %2u of each option:", h);
+      KBase::hSlice(heu, h).mPrintf(" %.4f ");
+    }
+    return;
+  };
+
+  if (parP) {
+    KBase::groupThreads(rowFn, 0, numA - 1);
+  }
+  else {
+    for (unsigned int h = 0; h < numA; h++) {
+      rowFn(h);
+    }
+  }
+  return heu;
 }
+// end of hypExpUtilMat
 
 template<class PT>
 VUI EState<PT>::powerWeightedSimilarity(const KMatrix& uMat, unsigned int ti, unsigned int nSim) const
@@ -935,6 +980,8 @@ VUI EState<PT>::powerWeightedSimilarity(const KMatrix& uMat, unsigned int ti, un
 /// Calculate the probability distribution over states from this perspective
 template<class PT>
 tuple <KMatrix, VUI> EState<PT>::pDist(int persp) const {
+  static const unsigned int profSite = KBase::Profiler::site("pDist");
+  KBase::ProfTimer profTimer(profSite);
   const unsigned int numA = eMod->numAct;
   // for this demo, the number of positions is exactly the number of actors
   const unsigned int numP = numA;
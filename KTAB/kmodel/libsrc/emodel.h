@@ -177,6 +177,9 @@ protected:
   virtual EState<PT>* makeNewEState() const = 0;
   virtual void setAllAUtil(ReportingLevel rl) = 0;
 
+  // positions are equivalent exactly when their indices into theta are equal
+  virtual tuple<VUI, VUI> ueNdx() const;
+
   // Calculate the values to the actors of the tj-th option, theta[j].
   // This needs to be done for any possible position, not just those
   // currently advocated.
@@ -207,7 +210,12 @@ protected:
   // as a column-vector. Again, this is from the perspective of whoever developed uMat.
   KMatrix  expUtilMat  (KBase::ReportingLevel rl, unsigned int numA, unsigned int numP,  KBase::VPModel vpm, const KMatrix & uMat) const;
 
-  KMatrix hypExpUtilMat () const;
+  // Expected utility to h of h alone adopting each option, theta[t], with all
+  // others holding their current positions: a [numA, numOptions] matrix.
+  // Every hypothesis shares the coalition strengths among the other occupied
+  // positions, so only the replaced h-column is re-scored for each option.
+  // Rows are independent, so they are computed concurrently if parP.
+  KMatrix hypExpUtilMat (KBase::ReportingLevel rl, bool parP) const;
 
   EModel<PT>*  eMod = nullptr; // saves a lot of type-casting later
   
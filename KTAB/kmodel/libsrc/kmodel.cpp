@@ -37,10 +37,9 @@ using KBase::nameFromEnum;
 // --------------------------------------------
 // Global Variables
 
-static std::mutex mtx_spce_log; // control access to log inside Model::scalarPCE
-
 // --------------------------------------------
 string Model::lastExceptionMsg = string();
+unsigned int Model::maxNumActor = 250;
 
 string Model::getLastError() {
   return lastExceptionMsg;
@@ -183,12 +182,20 @@ Model::~Model() {
 
 
 void Model::run() {
-  if (1 != history.size()) {
-    throw KException("Model::run: History size should not be more than 1 at this stage.");
+  if (0 == history.size()) {
+    throw KException("Model::run: History must hold at least the initial state.");
   }
-  State* s0 = history[0];
-  bool done = false;
-  unsigned int iter = 0;
+  // Normally there is just the initial state. There are more when resuming
+  // a run, which carries on from the last of them.
+  State* s0 = history[history.size() - 1];
+  unsigned int iter = history.size() - 1;
+  // A resumed run may already have met its stopping condition, in which
+  // case it takes no further turns.
+  bool done = (0 < iter) && stop(iter, s0);
+  if (done) {
+    LOG(INFO) << "Model::run: the resumed run had already stopped at iteration" << iter;
+  }
+  auto prof0 = Profiler::snapshot();
 
   while (!done) {
     if (nullptr == s0) {
@@ -201,16 +208,51 @@ void Model::run() {
     LOG(INFO) << "Starting Model::run iteration" << iter;
     auto s1 = s0->step();
     addState(s1);
+    if (Profiler::enabled()) {
+      logProfile(iter, prof0);
+    }
     done = stop(iter, s1);
     s0 = s1;
   }
   return;
 }
 
+
+void Model::logProfile(unsigned int t, vector<ProfRecord> & prev) {
+  auto cur = Profiler::snapshot();
+  auto dlt = Profiler::delta(cur, prev);
+  prev = cur;
+
+  LOG(INFO) << "Profile" << Profiler::toJSON(t, dlt);
+
+  if (!Profiler::csvFile.empty()) {
+    FILE* f = fopen(Profiler::csvFile.c_str(), "a");
+    if (nullptr == f) {
+      throw KException("Model::logProfile: could not open " + Profiler::csvFile);
+    }
+    fseek(f, 0, SEEK_END);
+    bool header = (0 == ftell(f));
+    fputs(Profiler::toCSV(t, dlt, header).c_str(), f);
+    fclose(f);
+  }
+
+  // the RunStats table goes with the information tables
+  if ((0 < sqlFlags.size()) && sqlFlags[0]) {
+    for (auto tbl : KTables) {
+      if ("RunStats" == tbl->tabName) {
+        sqlRunStats(t, dlt);
+        break;
+      }
+    }
+  }
+  return;
+}
+
 unsigned int Model::addActor(Actor* a) {
   if (nullptr == a) {
     throw KException("Model::addActor Actor a is a null pointer");
   }
+  a->id = ((int)(actrs.size()));
   actrs.push_back(a);
   numAct = ((unsigned int)(actrs.size()));
   return numAct;
@@ -294,6 +336,14 @@ double Model::estNRA(double rh, double  ri, BigRAdjust ra) {
 }
 
 int Model::actrNdx(const Actor* a) const {
+  if (nullptr == a) {
+    return -1;
+  }
+  const int id = a->getID();
+  if ((0 <= id) && (id < ((int)numAct)) && (a == actrs[id])) {
+    return id;
+  }
+  // only reached for actors not added to this model
   int ai = -1;
   for (unsigned int i = 0; i < numAct; i++) {
     if (a == actrs[i]) {
@@ -515,6 +565,8 @@ KMatrix Model::vProb(VPModel vpm, const KMatrix & c) {
 
 KMatrix Model::coalitions(function<double(unsigned int ak, unsigned int pi, unsigned int pj)> vfn,
                           unsigned int numAct, unsigned int numOpt) {
+  static const unsigned int profSite = KBase::Profiler::site("coalitions");
+  KBase::ProfTimer profTimer(profSite);
   // if several actors occupy the same position, then numAct > numOpt
   const double minC = 1E-8;
   auto c = KMatrix(numOpt, numOpt);
@@ -568,6 +620,8 @@ KMatrix Model::vProb(VotingRule vr, VPModel vpm, const KMatrix & w, const KMatri
 }
 
 tuple<KMatrix, KMatrix> Model::probCE2(PCEModel pcm, VPModel vpm, const KMatrix & cltnStrngth) {
+  static const unsigned int profSite = KBase::Profiler::site("probCE2");
+  KBase::ProfTimer profTimer(profSite);
   const double pTol = 1E-8;
   unsigned int numOpt = cltnStrngth.numR();
   auto p = KMatrix(numOpt, 1);
@@ -832,34 +886,43 @@ KMatrix Model::scalarPCE(unsigned int numAct, unsigned int numOpt, const KMatrix
   const auto p = get<0>(pv2); //column
   const auto pv = get<1>(pv2); // square
 
-  mtx_spce_log.lock();
-  if (ReportingLevel::Low < rl) {
-    LOG(INFO) << "Num actors:" << numAct;
-    LOG(INFO) << "Num options:" << numOpt;
-
-    if ((numAct <= 20) && (numOpt <= 20)) {
-      LOG(INFO) << "Actor strengths:";
-      w.mPrintf(" %6.2f ");
-      LOG(INFO) << "Voting rule:" << vr;
-      // printf("         aka %s \n", KBase::vrName(vr).c_str());
-      LOG(INFO) << "Utility to actors of options:";
-      u.mPrintf(" %+8.3f ");
-
-      LOG(INFO) << "Coalition strengths of (i:j):";
-      c.mPrintf(" %8.3f ");
-
-      LOG(INFO) << "Probability Opt_i > Opt_j";
-      pv.mPrintf(" %.4f ");
-      LOG(INFO) << "Probability Opt_i";
-      p.mPrintf(" %.4f ");
-    }
-    LOG(INFO) << "Found stable PCE distribution";
+  if ((ReportingLevel::Low < rl) && KTRACE_ON(High)) {
+    showScalarPCE(w, u, vr, c, pv, p);
   }
-  mtx_spce_log.unlock();
   return p;
 }
 
 
+void Model::showScalarPCE(const KMatrix & w, const KMatrix & u, VotingRule vr,
+                          const KMatrix & c, const KMatrix & pv, const KMatrix & p) {
+  const unsigned int numAct = u.numR();
+  const unsigned int numOpt = u.numC();
+  // one log record, so that reports from concurrent callers do not interleave
+  TraceBuf tb;
+  tb << "Num actors: " << numAct << "\n";
+  tb << "Num options: " << numOpt << "\n";
+
+  if ((numAct <= 20) && (numOpt <= 20)) {
+    tb << "Actor strengths:\n";
+    tb << w.mFormat(" %6.2f ") << "\n";
+    tb << "Voting rule: " << vr << "\n";
+    // printf("         aka %s \n", KBase::vrName(vr).c_str());
+    tb << "Utility to actors of options:\n";
+    tb << u.mFormat(" %+8.3f ") << "\n";
+
+    tb << "Coalition strengths of (i:j):\n";
+    tb << c.mFormat(" %8.3f ") << "\n";
+
+    tb << "Probability Opt_i > Opt_j\n";
+    tb << pv.mFormat(" %.4f ") << "\n";
+    tb << "Probability Opt_i\n";
+    tb << p.mFormat(" %.4f ") << "\n";
+  }
+  tb << "Found stable PCE distribution";
+  return;
+}
+
+
 // -------------------------------------------------
 Actor::Actor(string n, string d) {
   name = n;
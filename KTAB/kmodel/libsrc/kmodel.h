@@ -44,6 +44,8 @@
 #include "kutils.h"
 #include "kmatrix.h"
 #include "prng.h"
+#include "profiler.h"
+#include "ktrace.h"
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <map>
@@ -254,6 +256,10 @@ public:
   unsigned int numCat = 0;
   VUI match = {}; // must be of length numItm
 
+  // A key which is equal for two MtchPstn exactly when operator== says they are,
+  // so that sets of them can be hashed rather than compared pairwise.
+  VUI eqvKey() const;
+
 protected:
   virtual void print(ostream& os) const;
 
@@ -298,7 +304,9 @@ public:
   Model(const Model& that) = delete;
 
   static const unsigned int minNumActor = 3;
-  static const unsigned int maxNumActor = 250; //quite generous, as we expect 10-30.
+  // 250 is quite generous, as we expect 10-30, but scaling studies may raise it
+  // (e.g. smpc --maxactors) before a larger model is read or built.
+  static unsigned int maxNumActor;
 
   static const unsigned int maxScenNameLen = 512; // might be auto-generated in sensitivy analysis
   static const unsigned int maxScenDescLen = 512; // see above
@@ -361,6 +369,11 @@ public:
   static KMatrix scalarPCE(unsigned int numAct, unsigned int numOpt, const KMatrix & w,
                            const KMatrix & u, VotingRule vr, VPModel vpm, PCEModel pcem, ReportingLevel rl);
 
+  // log the inputs and results of scalarPCE, as it does above ReportingLevel::Low.
+  // c, pv and p are the coalitions, victory probabilities and outcome probabilities.
+  static void showScalarPCE(const KMatrix & w, const KMatrix & u, VotingRule vr,
+                            const KMatrix & c, const KMatrix & pv, const KMatrix & p);
+
 
   static KMatrix markovIncentivePCE(const KMatrix & coalitions, VPModel vpm);
 
@@ -396,6 +409,9 @@ public:
 
 	void sqlBargainVote(unsigned int t, vector< std::tuple<uint64_t, uint64_t>> barginidspair_i_j, vector<double> Vote_mat, unsigned int act_k);
 
+  // output one turn's profile (see KBase::Profiler) to the RunStats table
+  void sqlRunStats(unsigned int t, const vector<ProfRecord> & rs);
+
   void LogInfoTables(); // JAH 20160731
 
   void createTableIndices();
@@ -433,13 +449,41 @@ public:
   static void configLogger(string logFile);
   static string getLastError();
 
+  // Sharded SQLite results: with "Shard=<k>" in the connection string, a run writes to
+  // <Database>_shard<k>.db instead of <Database>.db, so that runs of a sweep in separate
+  // processes each have their own file and never wait on another's exclusive lock.
+  // The shards can be queried where they are, or merged into one database later.
+  static QString shardDBName(const QString & base, int k);
+
+  // Run a read-only query on each shard file, concurrently and each over its own
+  // connection, passing every row to rowFn. Calls to rowFn are serialized, but rows
+  // from different shards arrive interleaved.
+  static void queryShards(const vector<QString> & shardFiles, const string & sql,
+    function<void(unsigned int shardNdx, const QSqlQuery & row)> rowFn);
+
+  // Append every table of the shard files to the SQLite database target, creating any
+  // table it lacks. Throws, before writing anything, if a scenario is in two shards,
+  // or if there are more than maxMergeShards of them.
+  static void mergeShards(const QString & target, const vector<QString> & shardFiles);
+
+  // The shards are all attached to the target for the one transaction, so SQLite's
+  // default limit on attached databases (SQLITE_MAX_ATTACHED) bounds their number.
+  static const unsigned int maxMergeShards = 10;
+
+  // The same, for shards 0 to numShards-1 of the database in the last connection string.
+  static void mergeShards(unsigned int numShards);
+
 protected:
   //static string createTableSQL(unsigned int tn);
-  static const int NumTables = 13; //TODO: constant need to be redefined when new table is added
+  static const int NumTables = 14; //TODO: constant need to be redefined when new table is added
   static const int NumSQLLogGrps = 5; // TODO : Add one to this num when new logging group is added
   // note that the function to write to table #k must be kept
   // synchronized with the result of createSQL(k) !
 
+  // report the profile of turn t (the change since prev, which is then updated)
+  // to the log, to Profiler::csvFile if set, and to the RunStats table if present
+  void logProfile(unsigned int t, vector<ProfRecord> & prev);
+
 
 
   // Note that, with composite models, there many be dozens interacting.
@@ -457,6 +501,7 @@ protected:
   static QString databaseName;
   static QString userName;
   static QString password;
+  static int shard; // -1 when results are not sharded
   QSqlDatabase *qtDB = nullptr;
   mutable QSqlQuery query;
   void configSqlite() const;
@@ -534,6 +579,11 @@ protected:
 
   KMatrix uProb = KMatrix(); // probability of each Unique state
 
+  // The unique and equivalent indices of the positions in this state, as for uIndices and eIndices.
+  // By default, this tests pairs of positions with equivNdx via KBase::ueIndices.
+  // Derived classes whose positions can be hashed should override it to avoid the O(n*u) scan.
+  virtual tuple<VUI, VUI> ueNdx() const;
+
   virtual void setAllAUtil(ReportingLevel rl) = 0;
 
   virtual void setOneAUtil(unsigned int perspH, ReportingLevel rl); // TODO: make this non-dummy
@@ -571,6 +621,12 @@ public:
   string name = "GA"; // a short name, usually 2-5 characters
   string desc = "Generic Actor"; // short description, like a line or two.
 
+  // dense index of this actor in Model::actrs, assigned by Model::addActor
+  // (negative until then), so that per-actor data can be flat arrays indexed by it
+  int getID() const {
+    return id;
+  }
+
 
   // the most common kinds of votes for actors are the following:
 
@@ -602,6 +658,8 @@ public:
 
 
 protected:
+  friend class Model;
+  int id = -1;
 };
 
 // JAH 20160728 KTAB logging table object
@@ -25,6 +25,8 @@
 #include <easylogging++.h>
 #include <sstream>
 #include <algorithm>
+#include <mutex>
+#include <set>
 
 #include "kmodel.h"
 
@@ -46,6 +48,7 @@ int Model::port=5432; // Default port for postgresql
 QString Model::databaseName;
 QString Model::userName;
 QString Model::password;
+int Model::shard = -1;
 
 void Model::initDBDriver(QString connectionName) {
   if (QSqlDatabase::contains(connectionName)) {
@@ -539,6 +542,20 @@ KTable * Model::createSQL(unsigned int n)
     name = "ScenarioDesc";
     grpID = 0;
     break;
+
+  case 13:
+    // wall time and call counts of the profiled phases of each turn
+    sql = "create table if not exists RunStats ("  \
+          "ScenarioId VARCHAR(32) NOT NULL DEFAULT 'None', "\
+          "Turn_t     INTEGER     NOT NULL DEFAULT 0, "\
+          "Phase      VARCHAR(64) NOT NULL DEFAULT 'None', "\
+          "Calls      INTEGER     NOT NULL DEFAULT 0, "\
+          "Seconds    FLOAT       NOT NULL DEFAULT 0.0"\
+          ");";
+    name = "RunStats";
+    grpID = 0;
+    break;
+
   default:
     throw(KException("Model::createSQL unrecognized table number"));
   }
@@ -553,6 +570,8 @@ KTable * Model::createSQL(unsigned int n)
 
 void Model::sqlAUtil(unsigned int t)
 {
+  static const unsigned int profSite = KBase::Profiler::site("sql");
+  KBase::ProfTimer profTimer(profSite);
   if (t >= history.size()) {
     throw KException("Model::sqlAUtil: Specified turn number is beyond the size of history");
   }
@@ -608,6 +627,8 @@ void Model::sqlAUtil(unsigned int t)
 // module run
 void Model::sqlPosEquiv(unsigned int t)
 {
+  static const unsigned int profSite = KBase::Profiler::site("sql");
+  KBase::ProfTimer profTimer(profSite);
   if (t >= history.size()) {
     throw KException("Model::sqlPosEquiv: Specified turn number is beyond the size of history");
   }
@@ -650,6 +671,8 @@ void Model::sqlPosEquiv(unsigned int t)
 
 void Model::sqlBargainEntries(unsigned int t, int bargainId, int initiator, int receiver, double val)
 {
+  static const unsigned int profSite = KBase::Profiler::site("sql");
+  KBase::ProfTimer profTimer(profSite);
   // prepare the sql statement to insert
   string sql = string("INSERT INTO Bargn (ScenarioId, Turn_t, BargnID, Init_Act_i, Recd_Act_j, Value) VALUES ('")
     + scenId + "', :turn_t, :bargnid, :init_i, :recd_j, :value)";
@@ -679,6 +702,8 @@ void Model::sqlBargainEntries(unsigned int t, int bargainId, int initiator, int
 
 void Model::sqlBargainCoords(unsigned int t, int bargnID, const KBase::VctrPstn & initPos, const KBase::VctrPstn & rcvrPos)
 {
+  static const unsigned int profSite = KBase::Profiler::site("sql");
+  KBase::ProfTimer profTimer(profSite);
   int nDim = initPos.numR();
   if (nDim != rcvrPos.numR()) {
     throw KException("Model::sqlBargainCoords: dimension mismatch between initiator and receiver actor's positions");
@@ -720,6 +745,8 @@ void Model::sqlBargainCoords(unsigned int t, int bargnID, const KBase::VctrPstn
 
 void Model::sqlBargainUtil(unsigned int t, vector<uint64_t> bargnIds,  KBase::KMatrix Util_mat)
 {
+  static const unsigned int profSite = KBase::Profiler::site("sql");
+  KBase::ProfTimer profTimer(profSite);
   int Util_mat_row = Util_mat.numR();
   int Util_mat_col = Util_mat.numC();
 
@@ -812,6 +839,8 @@ void Model::LogInfoTables()
 
 void Model::sqlBargainVote(unsigned int t, vector< tuple<uint64_t, uint64_t>> barginidspair_i_j, vector<double> Vote_mat,unsigned int act_k)
 {
+  static const unsigned int profSite = KBase::Profiler::site("sql");
+  KBase::ProfTimer profTimer(profSite);
   int Util_mat_row = Vote_mat.size();
 
   // prepare the sql statement to insert
@@ -852,6 +881,8 @@ void Model::sqlBargainVote(unsigned int t, vector< tuple<uint64_t, uint64_t>> ba
 // module run
 void Model::sqlPosProb(unsigned int t)
 {
+  static const unsigned int profSite = KBase::Profiler::site("sql");
+  KBase::ProfTimer profTimer(profSite);
   if (t >= history.size()) {
     throw KException("Model::sqlPosProb: Specified turn number is beyond the size of history");
   }
@@ -895,10 +926,36 @@ void Model::sqlPosProb(unsigned int t)
   qtDB->commit();
   return;
 }
+void Model::sqlRunStats(unsigned int t, const vector<ProfRecord> & rs)
+{
+  string sql = string("INSERT INTO RunStats (ScenarioId, Turn_t, Phase, Calls, Seconds) VALUES ('")
+    + scenId + "', :turn_t, :phase, :calls, :seconds)";
+  query.prepare(QString::fromStdString(sql));
+
+  qtDB->transaction();
+  for (auto r : rs) {
+    if (0 == r.calls) {
+      continue;
+    }
+    query.bindValue(":turn_t", t);
+    query.bindValue(":phase", QString::fromStdString(r.name));
+    query.bindValue(":calls", (qulonglong) r.calls);
+    query.bindValue(":seconds", r.seconds);
+    if (!query.exec()) {
+      LOG(INFO) << query.lastError().text().toStdString();
+      throw KException("Model::sqlRunStats: DB query failed");
+    }
+  }
+  qtDB->commit();
+  return;
+}
+
 // populates record for table PosProb for each step of
 // module run
 void Model::sqlPosVote(unsigned int t)
 {
+  static const unsigned int profSite = KBase::Profiler::site("sql");
+  KBase::ProfTimer profTimer(profSite);
   if (t >= history.size()) {
     throw KException("Model::sqlPosVote: Specified turn number is beyond the size of history");
   }
@@ -982,7 +1039,8 @@ bool Model::loginCredentials(string connString) {
     Port,
     Database,
     Uid,
-    Pwd
+    Pwd,
+    Shard
   };
 
   std::map<std::string, userParams> mapStringToUserParams =
@@ -993,6 +1051,7 @@ bool Model::loginCredentials(string connString) {
     { "database", userParams::Database },
     { "uid", userParams::Uid },
     { "pwd", userParams::Pwd },
+    { "shard", userParams::Shard },
   };
 
   auto trimWhites = [](string &input) {
@@ -1022,6 +1081,17 @@ bool Model::loginCredentials(string connString) {
     trimWhites(value);
   };
 
+  // a whole, non-negative number; anything else is an error in the string
+  auto parseCount = [](const string & value, int & n) {
+    if (value.empty() || (string::npos != value.find_first_not_of("0123456789"))
+      || (9 < value.size())) {
+      return false;
+    }
+    n = std::stoi(value);
+    return true;
+  };
+
+  shard = -1; // unless this connection string names one
   string parsedParam;
   std::stringstream  inputCredential(const_cast<char*>(connString.c_str()));
   while (getline(inputCredential, parsedParam, ';'))
@@ -1061,7 +1131,11 @@ bool Model::loginCredentials(string connString) {
       server = QString::fromStdString(value);
       break;
     case userParams::Port:
-      port = std::stoi(value);
+      if (!parseCount(value, port)) {
+        lastExceptionMsg = "Error! Port must be a whole number, not " + value;
+        LOG(INFO) << lastExceptionMsg;
+        return false;
+      }
       break;
     case userParams::Database:
       databaseName = QString::fromStdString(value);
@@ -1072,6 +1146,14 @@ bool Model::loginCredentials(string connString) {
     case userParams::Pwd:
       password = QString::fromStdString(value);
       break;
+    case userParams::Shard:
+      if (!parseCount(value, shard)) {
+        lastExceptionMsg = "Error! A shard number must be a non-negative whole number, not " + value;
+        LOG(INFO) << lastExceptionMsg;
+        shard = -1;
+        return false;
+      }
+      break;
     default:
       lastExceptionMsg = "Error in input credentials format";
       LOG(INFO) << lastExceptionMsg;
@@ -1112,12 +1194,199 @@ bool Model::loginCredentials(string connString) {
   }
 
   if (!dbDriver.compare("QSQLITE")) {
-    databaseName.append(".db");
+    databaseName = shardDBName(databaseName, shard);
+  }
+  else if (0 <= shard) {
+    LOG(INFO) << "Shard is ignored except with QSQLITE: a postgres server already takes concurrent writers";
+    shard = -1;
   }
 
   return true;
 }
 
+QString Model::shardDBName(const QString & base, int k) {
+  if (0 > k) {
+    return base + ".db";
+  }
+  return base + QString::fromStdString("_shard" + std::to_string(k) + ".db");
+}
+
+void Model::queryShards(const vector<QString> & shardFiles, const string & sql,
+  function<void(unsigned int shardNdx, const QSqlQuery & row)> rowFn) {
+  if (shardFiles.empty()) {
+    return;
+  }
+  std::mutex rowLock;
+  vector<string> errors(shardFiles.size());
+
+  // a QSqlDatabase connection may only be used in the thread which made it
+  auto qShard = [&](unsigned int n) {
+    const QString cName = QString::fromStdString("kShardQuery" + std::to_string(n));
+    {
+      QSqlDatabase sdb = QSqlDatabase::addDatabase("QSQLITE", cName);
+      sdb.setDatabaseName(shardFiles[n]);
+      if (!sdb.open()) {
+        errors[n] = "could not open " + shardFiles[n].toStdString();
+      }
+      else {
+        QSqlQuery sq(sdb);
+        sq.setForwardOnly(true);
+        if (!sq.exec(QString::fromStdString(sql))) {
+          errors[n] = shardFiles[n].toStdString() + ": " + sq.lastError().text().toStdString();
+        }
+        else {
+          while (sq.next()) {
+            std::lock_guard<std::mutex> lk(rowLock);
+            rowFn(n, sq);
+          }
+        }
+        sq.finish();
+        sdb.close();
+      }
+    }
+    QSqlDatabase::removeDatabase(cName);
+  };
+  groupThreads(qShard, 0, shardFiles.size() - 1);
+
+  for (const auto & e : errors) {
+    if (!e.empty()) {
+      LOG(INFO) << e;
+      throw KException("Model::queryShards: " + e);
+    }
+  }
+  return;
+}
+
+void Model::mergeShards(const QString & target, const vector<QString> & shardFiles) {
+  if (maxMergeShards < shardFiles.size()) {
+    throw KException("Model::mergeShards: can merge at most " + std::to_string(maxMergeShards)
+      + " shards at once, not " + std::to_string(shardFiles.size()));
+  }
+
+  // A scenario can only be in one shard: check them all before anything is written
+  std::map<string, unsigned int> scenShard = {};
+  string dupScen = "";
+  queryShards(shardFiles, "SELECT ScenarioId FROM ScenarioDesc",
+    [&scenShard, &dupScen](unsigned int n, const QSqlQuery & row) {
+    const string sId = row.value(0).toString().toStdString();
+    if (!scenShard.insert({ sId, n }).second) {
+      dupScen = sId;
+    }
+  });
+  if (!dupScen.empty()) {
+    throw KException("Model::mergeShards: scenario " + dupScen + " is in more than one shard");
+  }
+
+  const QString cName = "kShardMerge";
+  string err = "";
+  {
+    QSqlDatabase mdb = QSqlDatabase::addDatabase("QSQLITE", cName);
+    mdb.setDatabaseName(target);
+    if (!mdb.open()) {
+      err = "could not open " + target.toStdString();
+    }
+    QSqlQuery mq(mdb);
+    auto mExec = [&mq, &err](const QString & sql) {
+      if (err.empty() && !mq.exec(sql)) {
+        err = sql.toStdString() + ": " + mq.lastError().text().toStdString();
+      }
+      return err.empty();
+    };
+    mExec("PRAGMA journal_mode = MEMORY");
+    mExec("PRAGMA synchronous = OFF");
+
+    // SQLite refuses ATTACH inside a transaction, so every shard is attached
+    // first and the whole merge is then one transaction: a failure anywhere
+    // leaves the target as it was. (Hence maxMergeShards.)
+    auto alias = [](unsigned int n) {
+      return QString::fromStdString("shard" + std::to_string(n));
+    };
+    unsigned int numAttached = 0;
+    for (unsigned int n = 0; err.empty() && (n < shardFiles.size()); n++) {
+      QString fName = shardFiles[n];
+      fName.replace("'", "''");
+      if (mExec("ATTACH DATABASE '" + fName + "' AS " + alias(n))) {
+        numAttached = n + 1;
+      }
+    }
+
+    std::set<QString> have = {};
+    if (mExec("SELECT name FROM main.sqlite_master WHERE type = 'table'")) {
+      while (mq.next()) {
+        have.insert(mq.value(0).toString());
+      }
+    }
+
+    // nor may a shard repeat a scenario the target already holds
+    if (err.empty() && (0 < have.count("ScenarioDesc"))) {
+      for (unsigned int n = 0; err.empty() && (n < shardFiles.size()); n++) {
+        const QString sName = alias(n);
+        if (mExec("SELECT ScenarioId FROM " + sName + ".ScenarioDesc WHERE ScenarioId IN "
+          "(SELECT ScenarioId FROM main.ScenarioDesc)") && mq.next()) {
+          err = "scenario " + mq.value(0).toString().toStdString() + " of "
+            + shardFiles[n].toStdString() + " is already in " + target.toStdString();
+        }
+      }
+    }
+
+    if (mExec("BEGIN TRANSACTION")) {
+      for (unsigned int n = 0; err.empty() && (n < shardFiles.size()); n++) {
+        LOG(INFO) << "Merging" << shardFiles[n].toStdString() << "into" << target.toStdString();
+        const QString sName = alias(n);
+        // the shard's tables, with the statements which created them
+        vector<std::pair<QString, QString>> tabs = {};
+        if (mExec("SELECT name, sql FROM " + sName + ".sqlite_master WHERE type = 'table'")) {
+          while (mq.next()) {
+            tabs.push_back({ mq.value(0).toString(), mq.value(1).toString() });
+          }
+        }
+        for (const auto & tab : tabs) {
+          if (have.insert(tab.first).second) {
+            mExec(tab.second); // an unqualified CREATE TABLE makes it in main
+          }
+          mExec("INSERT INTO main.\"" + tab.first + "\" SELECT * FROM " + sName + ".\"" + tab.first + "\"");
+        }
+      }
+      if (err.empty()) {
+        mExec("COMMIT");
+      }
+      else {
+        mq.exec("ROLLBACK");
+      }
+    }
+
+    for (unsigned int n = 0; n < numAttached; n++) {
+      mq.exec("DETACH DATABASE " + alias(n));
+    }
+    mq.finish();
+    mdb.close();
+  }
+  QSqlDatabase::removeDatabase(cName);
+
+  if (!err.empty()) {
+    LOG(INFO) << err;
+    throw KException("Model::mergeShards: " + err);
+  }
+  return;
+}
+
+void Model::mergeShards(unsigned int numShards) {
+  if (0 != dbDriver.compare("QSQLITE")) {
+    throw KException("Model::mergeShards: shards are SQLite files, but the driver is " + dbDriver.toStdString());
+  }
+  if (0 <= shard) {
+    throw KException("Model::mergeShards: the target database can not itself be a shard");
+  }
+  QString base = databaseName;
+  base.chop(3); // drop the ".db" which loginCredentials added
+  vector<QString> shardFiles = {};
+  for (unsigned int k = 0; k < numShards; k++) {
+    shardFiles.push_back(shardDBName(base, k));
+  }
+  mergeShards(databaseName, shardFiles);
+  return;
+}
+
 } // end of namespace
 
 // --------------------------------------------
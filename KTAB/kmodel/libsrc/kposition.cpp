@@ -80,6 +80,16 @@ void MtchPstn::print(ostream& os) const {
   return;
 }
 
+VUI MtchPstn::eqvKey() const {
+  // operator== looks only at the first numItm entries of match
+  if (numItm > match.size()) {
+    throw KException("MtchPstn::eqvKey: Size of match is not correct");
+  }
+  VUI k = {numItm, numCat};
+  k.insert(k.end(), match.begin(), match.begin() + numItm);
+  return k;
+}
+
 vector< MtchPstn > MtchPstn::neighbors(unsigned int nVar) const {
   if (0 >= nVar) {
     throw KException("MtchPstn::neighbors: nVar must be positive");
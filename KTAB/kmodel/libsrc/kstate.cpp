@@ -143,11 +143,6 @@ void State::setUENdx() {
     throw KException("State::setUENdx: eIndices must be empty");
   }
 
-  // Note that we have to lambda-bind 'this'. Otherwise, we'd need a 'static' function
-  // to give to uIndices.
-  auto efn = [this](unsigned int i, unsigned int j) {
-    return equivNdx(i, j);
-  };
   const unsigned int na = model->numAct;
   if (Model::minNumActor > na) {
     throw KException(string("State::setUENdx: Number of actors can not be less than ")
@@ -159,8 +154,7 @@ void State::setUENdx() {
       + std::to_string(Model::maxNumActor));
   }
 
-  auto ns = KBase::uiSeq(0, na - 1);
-  auto uePair = KBase::ueIndices<unsigned int>(ns, efn);
+  auto uePair = ueNdx();
 
   uIndices = get<0>(uePair);
   auto nu = ((const unsigned int)(uIndices.size()));
@@ -180,6 +174,17 @@ void State::setUENdx() {
 }
 
 
+tuple<VUI, VUI> State::ueNdx() const {
+  // Note that we have to lambda-bind 'this'. Otherwise, we'd need a 'static' function
+  // to give to uIndices.
+  auto efn = [this](unsigned int i, unsigned int j) {
+    return equivNdx(i, j);
+  };
+  auto ns = KBase::uiSeq(0, model->numAct - 1);
+  return KBase::ueIndices<unsigned int>(ns, efn);
+}
+
+
 void State::setAUtil(int perspH, ReportingLevel rl) {
   // we want to make sure that data is calculated at most once.
   // This is necessary because some utilities are very expensive to calculate,
@@ -231,6 +231,20 @@ bool LeonState::equivNdx(unsigned int i, unsigned int j) const {
   return rslt;
 }
 
+tuple<VUI, VUI> LeonState::ueNdx() const {
+  // Same equivalence as equivNdx, but grid-hashed rather than compared pairwise
+  vector<KMatrix> ps = {};
+  for (auto p : pstns) {
+    auto vp = ((const VctrPstn *)p);
+    if (vp == nullptr) {
+      throw KException("LeonState::ueNdx: vp is null pointer");
+    }
+    ps.push_back(*vp);
+  }
+  auto lm = ((const LeonModel *)model);
+  return KBase::ueIndicesTol(ps, lm->posTol);
+}
+
 
 LeonState* LeonState::stepSUSN() {
   setAUtil(-1, ReportingLevel::Medium);
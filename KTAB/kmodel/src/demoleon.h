@@ -166,6 +166,7 @@ public:
 protected:
   LeonState * doSUSN(ReportingLevel rl) const;
   virtual bool equivNdx(unsigned int i, unsigned int j) const;
+  virtual tuple<VUI, VUI> ueNdx() const;
 
   void setAllAUtil(ReportingLevel rl);
 
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <unordered_map>
 #include <vector>
 
 #include "prng.h"
@@ -246,6 +247,21 @@ void KMatrix::mPrintf(string fs, string msg) const {
 }
 
 
+string KMatrix::mFormat(string fs, string msg) const {
+    const char * fc = fs.c_str();
+    string txt = msg;
+    for (unsigned int i = 0; i < rows; i++) {
+        if (0 < i) {
+            txt += "\n";
+        }
+        for (unsigned int j = 0; j < clms; j++) {
+            txt += KBase::getFormattedString(fc, (*this)(i, j));
+        }
+    }
+    return txt;
+}
+
+
 void KMatrix::vFillVec(unsigned int nr, unsigned int nc, double iv) {
     rows = nr;
     clms = nc;
@@ -770,6 +786,107 @@ KMatrix firstEigenvector( const KMatrix& A, double tol) {
     return x;
 }
 
+tuple<VUI, VUI> ueIndicesTol(const vector<KMatrix> & pts, double tol) {
+    if (!(0.0 < tol)) {
+      throw KException("ueIndicesTol: tolerance must be positive");
+    }
+    VUI uns = {}; // unique indices
+    VUI ens = {}; // equivalent indices
+    const unsigned int n = pts.size();
+    if (0 == n) {
+      return tuple<VUI, VUI>(uns, ens);
+    }
+    const unsigned int dim = pts[0].numR() * pts[0].numC();
+
+    // Two points closer than tol differ by less than tol in every coordinate,
+    // so they lie in the same or adjacent cells. There are 3^dim such cells;
+    // when that is more than the number of points, just scan the uniques.
+    const bool gridP = (pow(3.0, dim) <= n);
+
+    typedef vector<long long> Cell;
+    struct CellHash {
+        size_t operator()(const Cell & c) const {
+            size_t h = 14695981039346656037ULL;
+            for (auto x : c) {
+                h = (h ^ ((size_t)x)) * 1099511628211ULL;
+            }
+            return h;
+        }
+    };
+    // ordinals (into uns) of the unique points in each cell
+    std::unordered_map<Cell, VUI, CellHash> grid = {};
+
+    auto cellOf = [tol, dim](const KMatrix & x) {
+        Cell c = {};
+        c.reserve(dim);
+        for (auto xd : x) {
+            c.push_back((long long)(floor(xd / tol)));
+        }
+        return c;
+    };
+
+    auto eqv = [&pts, tol](unsigned int i, unsigned int k) {
+        return (norm(pts[i] - pts[k]) < tol);
+    };
+
+    for (unsigned int i = 0; i < n; i++) {
+        if (dim != pts[i].numR() * pts[i].numC()) {
+          throw KException("ueIndicesTol: all points must have the same dimension");
+        }
+        // as in ueIndices, match the earliest unique which is equivalent
+        unsigned int found = uns.size();
+        Cell ci = {};
+        if (gridP) {
+            ci = cellOf(pts[i]);
+            Cell cn = ci;
+            vector<int> off(dim, -1); // odometer over {-1, 0, +1}^dim
+            bool more = true;
+            while (more) {
+                for (unsigned int d = 0; d < dim; d++) {
+                    cn[d] = ci[d] + off[d];
+                }
+                auto git = grid.find(cn);
+                if (git != grid.end()) {
+                    for (auto j : git->second) {
+                        if ((j < found) && eqv(i, uns[j])) {
+                            found = j;
+                        }
+                    }
+                }
+                more = false;
+                for (unsigned int d = 0; (!more) && (d < dim); d++) {
+                    if (off[d] < 1) {
+                        off[d]++;
+                        more = true;
+                    }
+                    else {
+                        off[d] = -1;
+                    }
+                }
+            }
+        }
+        else {
+            for (unsigned int j = 0; (found == uns.size()) && (j < uns.size()); j++) {
+                if (eqv(i, uns[j])) {
+                    found = j;
+                }
+            }
+        }
+
+        if (found < uns.size()) {
+            ens.push_back(found);
+        }
+        else {
+            if (gridP) {
+                grid[ci].push_back(uns.size());
+            }
+            uns.push_back(i);
+            ens.push_back(uns.size() - 1);
+        }
+    }
+    return tuple<VUI, VUI>(uns, ens);
+}
+
 } // end of namespace
 
 // --------------------------------------------
@@ -90,6 +90,11 @@ KMatrix rescaleRows(const KMatrix& m1, const double vMin, const double vMax);
 // So mathmatically analyze the situation before using this function.
 KMatrix firstEigenvector( const KMatrix& A, double tol);
 
+// Same result as ueIndices with the equivalence norm(a - b) < tol, as used to
+// compare vector positions. Points are hashed into a grid of cells tol wide,
+// so only points in adjacent cells are ever compared.
+tuple<VUI, VUI> ueIndicesTol(const vector<KMatrix> & pts, double tol);
+
 // -------------------------------------------------
 
 class KMatrix {
@@ -103,6 +108,8 @@ public:
     double operator() (unsigned int i, unsigned int j) const;  // readable rvalue
     double& operator() (unsigned int i, unsigned int j);       // assignable lvalue
     void mPrintf(string, string msg=string()) const;
+    // the rows as mPrintf would log them, joined by newlines, without logging
+    string mFormat(string fs, string msg=string()) const;
     unsigned int numR() const;
     unsigned int numC() const;
     static KMatrix uniform(PRNG* rng, unsigned int nr, unsigned int nc, double a, double b);
@@ -0,0 +1,83 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+
+#include <algorithm>
+#include <cctype>
+
+#include "ktrace.h"
+
+
+namespace KBase {
+
+std::atomic<uint8_t> Tracer::lvl(static_cast<uint8_t>(ReportingLevel::Debugging));
+
+void Tracer::setLevel(ReportingLevel rl) {
+  lvl.store(static_cast<uint8_t>(rl), std::memory_order_relaxed);
+  return;
+}
+
+ReportingLevel Tracer::parseLevel(const string & s) {
+  string t = s;
+  std::transform(t.begin(), t.end(), t.begin(), [](unsigned char c) {
+    return std::tolower(c);
+  });
+  if ((t == "silent") || (t == "0")) {
+    return ReportingLevel::Silent;
+  }
+  if ((t == "low") || (t == "1")) {
+    return ReportingLevel::Low;
+  }
+  if ((t == "medium") || (t == "2")) {
+    return ReportingLevel::Medium;
+  }
+  if ((t == "high") || (t == "3")) {
+    return ReportingLevel::High;
+  }
+  if ((t == "debugging") || (t == "4")) {
+    return ReportingLevel::Debugging;
+  }
+  throw KException("Tracer::parseLevel: unrecognized trace level " + s);
+}
+
+TraceBuf::~TraceBuf() {
+  flush();
+}
+
+void TraceBuf::flush() {
+  string s = os.str();
+  if (s.empty()) {
+    return;
+  }
+  if (s.back() == '\n') {
+    s.pop_back();
+  }
+  LOG(INFO) << s;
+  os.str("");
+  return;
+}
+
+};
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
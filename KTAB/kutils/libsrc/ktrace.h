@@ -0,0 +1,114 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+// Level-gated tracing for log messages on hot paths.
+//
+// The active level is a ReportingLevel, set at run time with
+// Tracer::setLevel; a KTRACE(lvl) statement is skipped, message
+// construction and all, unless lvl is at or below it. The default is
+// Debugging, so everything is logged. Building with KTAB_TRACE_MAX set
+// to a lower level (e.g. -DKTAB_TRACE_MAX=Medium) removes the more
+// detailed statements from the binary altogether.
+//
+// Multi-line reports from concurrent threads go into a TraceBuf local
+// to the thread and are logged as one record, so they need no lock to
+// stay together.
+//
+// Typical use:
+//   KTRACE(Medium) << "Using" << bMod << "to form proposed bargains";
+//   if (KTRACE_ON(High)) {
+//     TraceBuf tb;
+//     tb << "Bargain" << b.getID() << "\n";
+//     tb << m.mFormat(" %.3f ") << "\n";
+//   } // logged here
+// -------------------------------------------------
+#ifndef KTAB_TRACE_H
+#define KTAB_TRACE_H
+
+#include <atomic>
+#include <sstream>
+#include <string>
+
+#include <easylogging++.h>
+
+#include "kutils.h"
+
+#ifndef KTAB_TRACE_MAX
+#define KTAB_TRACE_MAX Debugging
+#endif
+
+#define KTRACE_ON(lvl) \
+  ((KBase::ReportingLevel::lvl <= KBase::ReportingLevel::KTAB_TRACE_MAX) \
+   && KBase::Tracer::on(KBase::ReportingLevel::lvl))
+
+#define KTRACE(lvl) if (!KTRACE_ON(lvl)) {} else LOG(INFO)
+
+namespace KBase {
+
+using std::string;
+
+class Tracer {
+public:
+  static void setLevel(ReportingLevel rl);
+  static ReportingLevel level() {
+    return static_cast<ReportingLevel>(lvl.load(std::memory_order_relaxed));
+  }
+
+  // true if messages at level rl are to be logged
+  static bool on(ReportingLevel rl) {
+    return static_cast<uint8_t>(rl) <= lvl.load(std::memory_order_relaxed);
+  }
+
+  // "silent", "low", "medium", "high" or "debugging" (or 0 to 4)
+  static ReportingLevel parseLevel(const string & s);
+
+private:
+  static std::atomic<uint8_t> lvl;
+};
+
+class TraceBuf {
+public:
+  TraceBuf() = default;
+  ~TraceBuf();
+  TraceBuf(const TraceBuf &) = delete;
+  TraceBuf & operator=(const TraceBuf &) = delete;
+
+  template <class T>
+  TraceBuf & operator<<(const T & x) {
+    os << x;
+    return *this;
+  }
+
+  // log everything so far as one record; a single trailing newline is dropped
+  void flush();
+
+private:
+  std::ostringstream os;
+};
+
+};
+
+// -------------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -40,13 +40,16 @@
 #include <iomanip>
 #include <functional>
 #include <future>
+#include <map>
 #include <math.h>
 #include <memory>
+#include <set>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
 #include <thread>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 
 namespace KBase {
@@ -158,6 +161,7 @@ ueIndices(const vector<T> &xs, function<bool(const T &a, const T &b)> eqv) {
   return tuple<VUI, VUI>(uns, ens);
 }
 
+
 // the unsigned ints in order from n1 to n2, inclusive.
 VUI uiSeq(const unsigned int n1, const unsigned int n2, const unsigned int ns = 1);
 
@@ -168,6 +172,99 @@ public:
   string msg = "";
 };
 
+
+// Hash for VUI keys, e.g. the categories of a matching.
+struct VUIHash {
+  size_t operator()(const VUI & v) const {
+    // FNV-1a style mixing of the entries
+    size_t h = 14695981039346656037ULL;
+    for (auto x : v) {
+      h = (h ^ x) * 1099511628211ULL;
+    }
+    return h;
+  }
+};
+
+
+// Same result as ueIndices, for items which are equivalent exactly when
+// their keys are equal (e.g. indices into an enumerated set of options).
+// Hashing the keys makes it O(n) rather than O(n*u) equivalence tests.
+template <typename K, typename H = std::hash<K>>
+tuple<VUI, VUI> ueIndicesByKey(const vector<K> &keys) {
+  VUI uns = {};
+  VUI ens = {};
+  std::unordered_map<K, unsigned int, H> seen = {};
+  auto n = ((const unsigned int)(keys.size()));
+  seen.reserve(n);
+  for (unsigned int i = 0; i < n; i++) {
+    auto ins = seen.insert(std::make_pair(keys[i], ((unsigned int)(uns.size()))));
+    if (ins.second) {
+      uns.push_back(i);
+    }
+    ens.push_back(ins.first->second);
+  }
+  return tuple<VUI, VUI>(uns, ens);
+}
+
+
+// Tracks the unique/equivalent indices of a set of keyed items, so that
+// when one item changes only its own entry is touched, not the whole set.
+// This is the common case in hypothetical evaluations, where actor h tries
+// many positions while everyone else stands still.
+template <typename K, typename H = std::hash<K>>
+class KeyedUENdx {
+public:
+  explicit KeyedUENdx(const vector<K> &ks) : keys(ks) {
+    for (unsigned int i = 0; i < keys.size(); i++) {
+      holders[keys[i]].insert(i);
+    }
+  }
+
+  // move item i to key k
+  void setKey(unsigned int i, const K &k) {
+    if (keys.size() <= i) {
+      throw KException("KeyedUENdx::setKey: index out of range");
+    }
+    auto old = holders.find(keys[i]);
+    old->second.erase(i);
+    if (old->second.empty()) {
+      holders.erase(old);
+    }
+    keys[i] = k;
+    holders[k].insert(i);
+    return;
+  }
+
+  // the indices of unique items, in order of first appearance (as ueIndices)
+  VUI uniques() const {
+    VUI uns = {};
+    uns.reserve(holders.size());
+    for (const auto &kh : holders) {
+      uns.push_back(*(kh.second.begin()));
+    }
+    std::sort(uns.begin(), uns.end());
+    return uns;
+  }
+
+  // both unique and equivalent indices, exactly as ueIndices would give them
+  tuple<VUI, VUI> indices() const {
+    const VUI uns = uniques();
+    VUI ens = {};
+    ens.resize(keys.size());
+    for (unsigned int j = 0; j < uns.size(); j++) {
+      for (auto i : holders.find(keys[uns[j]])->second) {
+        ens[i] = j;
+      }
+    }
+    return tuple<VUI, VUI>(uns, ens);
+  }
+
+protected:
+  vector<K> keys = {};
+  std::unordered_map<K, std::set<unsigned int>, H> holders = {};
+};
+
+
 template <typename... Args>
 string getFormattedString(const char* formatSpec, const Args&... args) {
   // Find the size of the buffer required to hold the formatted string
@@ -24,6 +24,8 @@
 
 //#include <assert.h>
 
+#include <sstream>
+
 #include "prng.h"
 
 
@@ -146,6 +148,23 @@ uint64_t PRNG::setSeed(uint64_t s) {
 }
 
 
+string PRNG::getState() const {
+  std::ostringstream os;
+  os << mt;
+  return os.str();
+}
+
+
+void PRNG::setState(const string & st) {
+  std::istringstream is(st);
+  is >> mt;
+  if (is.fail()) {
+    throw KException("PRNG::setState: not a valid generator state");
+  }
+  return;
+}
+
+
 double PRNG::uniform(double a, double b) {
   uint64_t n = uniform();
   double x = ((double)n) / ((double)0xFFFFFFFFFFFFFFFF);
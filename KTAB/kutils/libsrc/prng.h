@@ -73,6 +73,11 @@ public:
   unsigned int probSel(const KMatrix & cv);
   VBool bits(unsigned int nb);
   uint64_t setSeed(uint64_t sd);
+
+  // The full state of the generator, as text, so that a run can be
+  // saved part way through and resumed with exactly the same draws.
+  string getState() const;
+  void setState(const string & st);
 protected:
   mt19937_64 mt = mt19937_64();
 };
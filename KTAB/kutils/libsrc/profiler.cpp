@@ -0,0 +1,206 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+// Per-thread accumulation for the profiler.
+// Each thread writes only to its own counters, with relaxed atomic
+// stores, so a concurrent snapshot never sees a torn value and the
+// writer never waits. Blocks of finished threads are folded into a
+// single 'retired' block, so short-lived worker threads (as created by
+// groupThreads) do not accumulate.
+// -------------------------------------------------
+
+#include <mutex>
+
+#include "profiler.h"
+
+
+namespace KBase {
+
+using std::mutex;
+using std::lock_guard;
+
+std::atomic<bool> Profiler::on(false);
+string Profiler::csvFile = "";
+
+namespace {
+
+class ProfBlock {
+public:
+  ProfBlock() {
+    for (unsigned int i = 0; i < Profiler::maxSites; i++) {
+      calls[i].store(0, std::memory_order_relaxed);
+      nanos[i].store(0, std::memory_order_relaxed);
+    }
+  }
+  std::atomic<uint64_t> calls[Profiler::maxSites];
+  std::atomic<uint64_t> nanos[Profiler::maxSites];
+};
+
+// everything here is guarded by regMutex
+mutex regMutex;
+vector<string> siteNames = {};
+vector<ProfBlock*> liveBlocks = {};
+ProfBlock retired;
+
+class ProfHolder {
+public:
+  ProfHolder() {
+    lock_guard<mutex> lk(regMutex);
+    liveBlocks.push_back(&blk);
+  }
+  ~ProfHolder() {
+    lock_guard<mutex> lk(regMutex);
+    for (unsigned int i = 0; i < Profiler::maxSites; i++) {
+      auto c = retired.calls[i].load(std::memory_order_relaxed) + blk.calls[i].load(std::memory_order_relaxed);
+      auto n = retired.nanos[i].load(std::memory_order_relaxed) + blk.nanos[i].load(std::memory_order_relaxed);
+      retired.calls[i].store(c, std::memory_order_relaxed);
+      retired.nanos[i].store(n, std::memory_order_relaxed);
+    }
+    for (unsigned int k = 0; k < liveBlocks.size(); k++) {
+      if (liveBlocks[k] == &blk) {
+        liveBlocks.erase(liveBlocks.begin() + k);
+        break;
+      }
+    }
+  }
+  ProfBlock blk;
+};
+
+thread_local ProfHolder holder;
+
+}; // end of anonymous namespace
+
+
+unsigned int Profiler::site(const string & name) {
+  lock_guard<mutex> lk(regMutex);
+  for (unsigned int i = 0; i < siteNames.size(); i++) {
+    if (siteNames[i] == name) {
+      return i;
+    }
+  }
+  if (maxSites <= siteNames.size()) {
+    throw KException("Profiler::site: too many profiling sites");
+  }
+  siteNames.push_back(name);
+  return ((unsigned int)(siteNames.size() - 1));
+}
+
+
+void Profiler::enable(bool b) {
+  on.store(b, std::memory_order_relaxed);
+  return;
+}
+
+
+void Profiler::record(unsigned int s, uint64_t nanos) {
+  // single writer per block, so load-and-store is enough
+  ProfBlock & b = holder.blk;
+  b.calls[s].store(b.calls[s].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  b.nanos[s].store(b.nanos[s].load(std::memory_order_relaxed) + nanos, std::memory_order_relaxed);
+  return;
+}
+
+
+vector<ProfRecord> Profiler::snapshot() {
+  lock_guard<mutex> lk(regMutex);
+  const unsigned int n = siteNames.size();
+  auto rs = vector<ProfRecord>(n);
+  for (unsigned int i = 0; i < n; i++) {
+    uint64_t c = retired.calls[i].load(std::memory_order_relaxed);
+    uint64_t ns = retired.nanos[i].load(std::memory_order_relaxed);
+    for (auto b : liveBlocks) {
+      c = c + b->calls[i].load(std::memory_order_relaxed);
+      ns = ns + b->nanos[i].load(std::memory_order_relaxed);
+    }
+    rs[i].name = siteNames[i];
+    rs[i].calls = c;
+    rs[i].seconds = ((double) ns) / 1E9;
+  }
+  return rs;
+}
+
+
+vector<ProfRecord> Profiler::delta(const vector<ProfRecord> & cur, const vector<ProfRecord> & prev) {
+  // sites are only ever appended, so prev is a prefix of cur
+  auto rs = cur;
+  for (unsigned int i = 0; (i < prev.size()) && (i < rs.size()); i++) {
+    rs[i].calls = rs[i].calls - prev[i].calls;
+    rs[i].seconds = rs[i].seconds - prev[i].seconds;
+  }
+  return rs;
+}
+
+
+string Profiler::toJSON(unsigned int turn, const vector<ProfRecord> & rs) {
+  string js = getFormattedString("{\"turn\": %u, \"phases\": [", turn);
+  bool first = true;
+  for (auto r : rs) {
+    if (0 == r.calls) {
+      continue;
+    }
+    js = js + (first ? "" : ", ");
+    js = js + getFormattedString("{\"name\": \"%s\", \"calls\": %llu, \"seconds\": %.6f}",
+                                 r.name.c_str(), (unsigned long long) r.calls, r.seconds);
+    first = false;
+  }
+  js = js + "]}";
+  return js;
+}
+
+
+string Profiler::toCSV(unsigned int turn, const vector<ProfRecord> & rs, bool header) {
+  string csv = header ? "Turn,Phase,Calls,Seconds\n" : "";
+  for (auto r : rs) {
+    if (0 == r.calls) {
+      continue;
+    }
+    csv = csv + getFormattedString("%u,%s,%llu,%.6f\n",
+                                   turn, r.name.c_str(), (unsigned long long) r.calls, r.seconds);
+  }
+  return csv;
+}
+
+// -------------------------------------------------
+
+ProfTimer::ProfTimer(unsigned int s) {
+  if (Profiler::enabled()) {
+    site = s;
+    live = true;
+    t0 = std::chrono::steady_clock::now();
+  }
+}
+
+
+ProfTimer::~ProfTimer() {
+  if (live) {
+    auto dt = std::chrono::steady_clock::now() - t0;
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(dt).count();
+    Profiler::record(site, (uint64_t) ns);
+  }
+}
+
+};
+
+// -------------------------------------------------
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
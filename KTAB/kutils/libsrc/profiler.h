@@ -0,0 +1,111 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+// A small profiler for finding where the time goes in a model run.
+//
+// Each instrumented site is registered once, by name, and then timed with a
+// scoped ProfTimer. Each thread accumulates into its own block of counters,
+// so the timed path takes no locks; a lock is taken only the first time a
+// thread records anything, when it exits, and when a snapshot is taken.
+// When the profiler is disabled (the default), a ProfTimer costs one
+// relaxed atomic load.
+//
+// Typical use:
+//   static const unsigned int ps = Profiler::site("pDist");
+//   ProfTimer pt(ps);
+// -------------------------------------------------
+#ifndef KTAB_PROFILER_H
+#define KTAB_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "kutils.h"
+
+namespace KBase {
+
+using std::string;
+using std::vector;
+
+class ProfRecord {
+public:
+  string name = "";
+  uint64_t calls = 0;
+  double seconds = 0.0; // total wall time in this site, summed over all threads
+};
+
+class Profiler {
+public:
+  static const unsigned int maxSites = 64;
+
+  // index of the named site, registering it if new.
+  // Call it once per site (e.g. into a static local), not on every pass.
+  static unsigned int site(const string & name);
+
+  static void enable(bool on);
+  static bool enabled() {
+    return on.load(std::memory_order_relaxed);
+  }
+
+  // add one call of the given duration to the site, for this thread
+  static void record(unsigned int s, uint64_t nanos);
+
+  // cumulative totals over all threads, past and present, one record per registered site
+  static vector<ProfRecord> snapshot();
+
+  // the per-site change from prev to cur (both from snapshot)
+  static vector<ProfRecord> delta(const vector<ProfRecord> & cur, const vector<ProfRecord> & prev);
+
+  // sites with no calls are omitted
+  static string toJSON(unsigned int turn, const vector<ProfRecord> & rs);
+  static string toCSV(unsigned int turn, const vector<ProfRecord> & rs, bool header);
+
+  // if not empty, each turn's report is appended to this file as CSV
+  static string csvFile;
+
+private:
+  static std::atomic<bool> on;
+};
+
+class ProfTimer {
+public:
+  explicit ProfTimer(unsigned int s);
+  ~ProfTimer();
+  ProfTimer(const ProfTimer &) = delete;
+  ProfTimer & operator=(const ProfTimer &) = delete;
+
+private:
+  unsigned int site = 0;
+  bool live = false;
+  std::chrono::steady_clock::time_point t0;
+};
+
+};
+
+// -------------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
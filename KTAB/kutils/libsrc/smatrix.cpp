@@ -0,0 +1,279 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+// Compressed-sparse-row matrix.
+// The transpose of a CSR matrix is the same arrays read as CSC, so trans
+// is just a counting sort of the entries by column.
+// -------------------------------------------------
+
+#include <algorithm>
+#include <math.h>
+
+#include "smatrix.h"
+
+
+namespace KBase {
+
+SMatrix::SMatrix() {
+    rStart = {0};
+}
+
+SMatrix::SMatrix(unsigned int nr, unsigned int nc) {
+    rows = nr;
+    clms = nc;
+    rStart = vector<unsigned int>(nr + 1, 0);
+}
+
+SMatrix::~SMatrix() {}
+
+unsigned int SMatrix::numR() const {
+    return rows;
+}
+
+unsigned int SMatrix::numC() const {
+    return clms;
+}
+
+unsigned int SMatrix::numNZ() const {
+    return vals.size();
+}
+
+SMatrix SMatrix::fromDense(const KMatrix & m, double tol) {
+    auto sm = SMatrix(m.numR(), m.numC());
+    for (unsigned int i = 0; i < m.numR(); i++) {
+        for (unsigned int j = 0; j < m.numC(); j++) {
+            const double mij = m(i, j);
+            if (fabs(mij) > tol) {
+                sm.cNdx.push_back(j);
+                sm.vals.push_back(mij);
+            }
+        }
+        sm.rStart[i + 1] = sm.vals.size();
+    }
+    return sm;
+}
+
+SMatrix SMatrix::fromEntries(unsigned int nr, unsigned int nc, const vector<SEntry> & es) {
+    vector<SEntry> srtd = es;
+    for (auto e : srtd) {
+        if ((std::get<0>(e) >= nr) || (std::get<1>(e) >= nc)) {
+            throw KException("SMatrix::fromEntries: entry index out of range");
+        }
+    }
+    std::stable_sort(srtd.begin(), srtd.end(), [](const SEntry & a, const SEntry & b) {
+        return (std::get<0>(a) < std::get<0>(b)) ||
+               ((std::get<0>(a) == std::get<0>(b)) && (std::get<1>(a) < std::get<1>(b)));
+    });
+    auto sm = SMatrix(nr, nc);
+    unsigned int k = 0;
+    for (unsigned int i = 0; i < nr; i++) {
+        while ((k < srtd.size()) && (std::get<0>(srtd[k]) == i)) {
+            const unsigned int j = std::get<1>(srtd[k]);
+            double v = 0.0;
+            while ((k < srtd.size()) && (std::get<0>(srtd[k]) == i) && (std::get<1>(srtd[k]) == j)) {
+                v = v + std::get<2>(srtd[k]);
+                k++;
+            }
+            sm.cNdx.push_back(j);
+            sm.vals.push_back(v);
+        }
+        sm.rStart[i + 1] = sm.vals.size();
+    }
+    return sm;
+}
+
+KMatrix SMatrix::toDense() const {
+    auto m = KMatrix(rows, clms);
+    for (unsigned int i = 0; i < rows; i++) {
+        for (unsigned int k = rStart[i]; k < rStart[i + 1]; k++) {
+            m(i, cNdx[k]) = vals[k];
+        }
+    }
+    return m;
+}
+
+double SMatrix::operator() (unsigned int i, unsigned int j) const {
+    if ((rows <= i) || (clms <= j)) {
+        throw KException("SMatrix::operator(): index out of range");
+    }
+    auto b = cNdx.begin() + rStart[i];
+    auto e = cNdx.begin() + rStart[i + 1];
+    auto p = std::lower_bound(b, e, j);
+    if ((p != e) && (*p == j)) {
+        return vals[p - cNdx.begin()];
+    }
+    return 0.0;
+}
+
+void SMatrix::mulVec(const KMatrix & x, KMatrix & y) const {
+    if ((clms != x.numR()) || (1 != x.numC())) {
+        throw KException("SMatrix::mulVec: x must be a column with numC rows");
+    }
+    if ((rows != y.numR()) || (1 != y.numC())) {
+        throw KException("SMatrix::mulVec: y must be a column with numR rows");
+    }
+    for (unsigned int i = 0; i < rows; i++) {
+        double s = 0.0;
+        for (unsigned int k = rStart[i]; k < rStart[i + 1]; k++) {
+            s = s + vals[k] * x(cNdx[k], 0);
+        }
+        y(i, 0) = s;
+    }
+    return;
+}
+
+void SMatrix::mulTVec(const KMatrix & x, KMatrix & y) const {
+    if ((rows != x.numR()) || (1 != x.numC())) {
+        throw KException("SMatrix::mulTVec: x must be a column with numR rows");
+    }
+    if ((clms != y.numR()) || (1 != y.numC())) {
+        throw KException("SMatrix::mulTVec: y must be a column with numC rows");
+    }
+    for (unsigned int j = 0; j < clms; j++) {
+        y(j, 0) = 0.0;
+    }
+    for (unsigned int i = 0; i < rows; i++) {
+        const double xi = x(i, 0);
+        for (unsigned int k = rStart[i]; k < rStart[i + 1]; k++) {
+            y(cNdx[k], 0) = y(cNdx[k], 0) + vals[k] * xi;
+        }
+    }
+    return;
+}
+
+// -------------------------------------------------
+
+SMatrix trans(const SMatrix & m) {
+    auto t = SMatrix(m.clms, m.rows);
+    const unsigned int nnz = m.vals.size();
+    t.cNdx.resize(nnz);
+    t.vals.resize(nnz);
+    // count entries per column, then place them, which leaves each row of t sorted
+    for (auto j : m.cNdx) {
+        t.rStart[j + 1]++;
+    }
+    for (unsigned int j = 0; j < m.clms; j++) {
+        t.rStart[j + 1] = t.rStart[j + 1] + t.rStart[j];
+    }
+    vector<unsigned int> next = t.rStart;
+    for (unsigned int i = 0; i < m.rows; i++) {
+        for (unsigned int k = m.rStart[i]; k < m.rStart[i + 1]; k++) {
+            const unsigned int dst = next[m.cNdx[k]]++;
+            t.cNdx[dst] = i;
+            t.vals[dst] = m.vals[k];
+        }
+    }
+    return t;
+}
+
+SMatrix joinH(const SMatrix & mL, const SMatrix & mR) {
+    if (mL.rows != mR.rows) {
+        throw KException("joinH: mL and mR can not be joined");
+    }
+    auto m3 = SMatrix(mL.rows, mL.clms + mR.clms);
+    m3.cNdx.reserve(mL.vals.size() + mR.vals.size());
+    m3.vals.reserve(mL.vals.size() + mR.vals.size());
+    for (unsigned int i = 0; i < mL.rows; i++) {
+        for (unsigned int k = mL.rStart[i]; k < mL.rStart[i + 1]; k++) {
+            m3.cNdx.push_back(mL.cNdx[k]);
+            m3.vals.push_back(mL.vals[k]);
+        }
+        for (unsigned int k = mR.rStart[i]; k < mR.rStart[i + 1]; k++) {
+            m3.cNdx.push_back(mL.clms + mR.cNdx[k]);
+            m3.vals.push_back(mR.vals[k]);
+        }
+        m3.rStart[i + 1] = m3.vals.size();
+    }
+    return m3;
+}
+
+SMatrix joinV(const SMatrix & mT, const SMatrix & mB) {
+    if (mT.clms != mB.clms) {
+        throw KException("joinV: mT and mB can not be joined");
+    }
+    auto m3 = SMatrix(mT.rows + mB.rows, mT.clms);
+    m3.cNdx = mT.cNdx;
+    m3.cNdx.insert(m3.cNdx.end(), mB.cNdx.begin(), mB.cNdx.end());
+    m3.vals = mT.vals;
+    m3.vals.insert(m3.vals.end(), mB.vals.begin(), mB.vals.end());
+    const unsigned int nT = mT.vals.size();
+    for (unsigned int i = 0; i <= mT.rows; i++) {
+        m3.rStart[i] = mT.rStart[i];
+    }
+    for (unsigned int i = 1; i <= mB.rows; i++) {
+        m3.rStart[mT.rows + i] = nT + mB.rStart[i];
+    }
+    return m3;
+}
+
+SMatrix sIMat(unsigned int n) {
+    vector<SEntry> es = {};
+    es.reserve(n);
+    for (unsigned int i = 0; i < n; i++) {
+        es.push_back(SEntry(i, i, 1.0));
+    }
+    return SMatrix::fromEntries(n, n, es);
+}
+
+SMatrix operator* (double x, const SMatrix & m) {
+    SMatrix m2 = m;
+    for (auto & v : m2.vals) {
+        v = x * v;
+    }
+    return m2;
+}
+
+SMatrix operator* (const SMatrix & m, double x) {
+    return (x * m);
+}
+
+KMatrix operator* (const SMatrix & m1, const KMatrix & m2) {
+    if (m1.numC() != m2.numR()) {
+        throw KException("operator*: m1 and m2 can not be multiplied");
+    }
+    const unsigned int nc = m2.numC();
+    auto m3 = KMatrix(m1.numR(), nc);
+    auto x = KMatrix(m2.numR(), 1);
+    auto y = KMatrix(m1.numR(), 1);
+    for (unsigned int j = 0; j < nc; j++) {
+        for (unsigned int k = 0; k < m2.numR(); k++) {
+            x(k, 0) = m2(k, j);
+        }
+        m1.mulVec(x, y);
+        for (unsigned int i = 0; i < m1.numR(); i++) {
+            m3(i, j) = y(i, 0);
+        }
+    }
+    return m3;
+}
+
+KMatrix operator* (const KMatrix & m1, const SMatrix & m2) {
+    // (m1*m2)' = m2'*m1'
+    return trans(trans(m2) * trans(m1));
+}
+
+};
+
+// -------------------------------------------------
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,105 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+// A compressed-sparse-row matrix for large, structured problems whose
+// matrices are mostly structural zeros (e.g. 0/1 weight matrices).
+// It is deliberately minimal: build it, join it, transpose it, and
+// multiply it by dense KMatrix columns. Anything else, convert with toDense.
+// -------------------------------------------------
+#ifndef SMATRIX_H
+#define SMATRIX_H
+
+#include <tuple>
+#include <vector>
+
+#include "kutils.h"
+#include "kmatrix.h"
+
+namespace KBase {
+
+using std::tuple;
+using std::vector;
+
+class SMatrix;
+
+// (row, column, value)
+typedef tuple<unsigned int, unsigned int, double> SEntry;
+
+SMatrix trans(const SMatrix & m);
+SMatrix joinH(const SMatrix & mL, const SMatrix & mR);
+SMatrix joinV(const SMatrix & mT, const SMatrix & mB);
+SMatrix sIMat(unsigned int n);
+SMatrix operator* (double x, const SMatrix & m);
+SMatrix operator* (const SMatrix & m, double x);
+KMatrix operator* (const SMatrix & m1, const KMatrix & m2);
+KMatrix operator* (const KMatrix & m1, const SMatrix & m2);
+
+// -------------------------------------------------
+
+class SMatrix {
+    friend SMatrix trans(const SMatrix & m);
+    friend SMatrix joinH(const SMatrix & mL, const SMatrix & mR);
+    friend SMatrix joinV(const SMatrix & mT, const SMatrix & mB);
+    friend SMatrix operator* (double x, const SMatrix & m);
+public:
+    SMatrix();
+    SMatrix(unsigned int nr, unsigned int nc); // all zero
+
+    // entries with |mij| <= tol are dropped
+    static SMatrix fromDense(const KMatrix & m, double tol = 0.0);
+
+    // entries may come in any order; duplicates are summed
+    static SMatrix fromEntries(unsigned int nr, unsigned int nc, const vector<SEntry> & es);
+
+    KMatrix toDense() const;
+
+    double operator() (unsigned int i, unsigned int j) const;  // readable rvalue only
+    unsigned int numR() const;
+    unsigned int numC() const;
+    unsigned int numNZ() const;
+
+    // y = this*x and y = trans(this)*x, where x and y are columns of the right size.
+    // They write into y rather than returning a new matrix, so they do not allocate.
+    void mulVec(const KMatrix & x, KMatrix & y) const;
+    void mulTVec(const KMatrix & x, KMatrix & y) const;
+
+    virtual ~SMatrix();
+
+protected:
+    unsigned int rows = 0;
+    unsigned int clms = 0;
+    // row i holds entries rStart[i] to rStart[i+1]-1 of cNdx and vals,
+    // with column indices in increasing order
+    vector<unsigned int> rStart = vector<unsigned int>();
+    vector<unsigned int> cNdx = vector<unsigned int>();
+    vector<double> vals = vector<double>();
+
+private:
+};
+
+};
+
+// -------------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -25,6 +25,8 @@
 // "Finite-Dimensional Variational Inequalities and Complementarity Problems" by Facchinei and Pang
 // -------------------------------------------------
 
+#include <chrono>
+
 #include "vimcp.h"
 #include <easylogging++.h>
 
@@ -115,16 +117,13 @@ tuple<KMatrix, unsigned int, KMatrix> viABG(const KMatrix & xInit,
 // "A Modified Projection and Contraction Method for a Class of Linear Complementarity Problems",
 // B. S. He, Nanjing University, in Journal of Computational Mathematics, 1996
 
-tuple<KMatrix, unsigned int, KMatrix> viBSHe96(const KMatrix & M, const KMatrix & q,
-                                               function<KMatrix(const KMatrix &)> pK,
-                                               KMatrix u0, const double eps, const unsigned int iMax) {
-  if (false) {
-    LOG(INFO) << "Received M:";
-    M.mPrintf("%+.4f  ");
-    LOG(INFO) << "Received q:";
-    trans(q).mPrintf("%+.4f  ");
-  }
-
+// M may be dense (KMatrix) or sparse (SMatrix): both overloads of viBSHe96 share
+// this validation and the call into viLinBSHe96, which picks the matching product.
+template <class MT>
+static tuple<KMatrix, unsigned int, KMatrix> viBSHe96Core(const MT & M, const KMatrix & q,
+                                                          function<KMatrix(const KMatrix &)> pK,
+                                                          const KMatrix & u0, const double eps,
+                                                          const unsigned int iMax) {
   unsigned int n = q.numR();
   if (1 != q.numC()) {
     throw KException("viBSHe96: q matrix doesn't have one column");
@@ -145,47 +144,423 @@ tuple<KMatrix, unsigned int, KMatrix> viBSHe96(const KMatrix & M, const KMatrix
     throw KException("viBSHe96: eps must be positive");
   }
 
-  double gamma = 1.8; // any 0<gamma<2 will do. Note that 1.618034 = (1+sqrt(5))/2
-  KMatrix Mt = trans(M);
-  double qMax = maxAbs(q);
-  if (qMax <= 0.0) {
-    throw KException("viBSHe96: qMax must be positive");
+  // same algorithm as viLinBSHe96, which does it in place
+  auto prm = VIParams();
+  prm.thresh = eps;
+  prm.iMax = (0 < iMax) ? (iMax - 1) : 0; // this one always threw on reaching iMax
+  prm.keepTrace = false;
+  auto ws = VIWorkspace();
+  KMatrix u1 = u0;
+  auto trc = viLinBSHe96(u1, M, q, projInPlace(pK), prm, ws);
+  if (!trc.converged) {
+    throw KException("viBSHe96: iteration number crossed the upper limit");
+  }
+  auto trpl = tuple<KMatrix, unsigned int, KMatrix>(u1, trc.iter, ws.e);
+  return trpl;
+}
+
+tuple<KMatrix, unsigned int, KMatrix> viBSHe96(const KMatrix & M, const KMatrix & q,
+                                               function<KMatrix(const KMatrix &)> pK,
+                                               KMatrix u0, const double eps, const unsigned int iMax) {
+  if (false) {
+    LOG(INFO) << "Received M:";
+    M.mPrintf("%+.4f  ");
+    LOG(INFO) << "Received q:";
+    trans(q).mPrintf("%+.4f  ");
   }
-  KMatrix I = iMat(n);
+  return viBSHe96Core(M, q, pK, u0, eps, iMax);
+}
+
 
-  // for general VI, e(u) = u - pK(u - F(u))
-  // will have e(u)=0 iff u solves the VI.
-  auto err = [&M, &q, pK](const KMatrix & u) {
-    KMatrix proj = pK(u - (M*u + q));
-    return (u - proj);
+// the same, for a sparse M
+tuple<KMatrix, unsigned int, KMatrix> viBSHe96(const SMatrix & M, const KMatrix & q,
+                                               function<KMatrix(const KMatrix &)> pK,
+                                               KMatrix u0, const double eps, const unsigned int iMax) {
+  return viBSHe96Core(M, q, pK, u0, eps, iMax);
+}
+
+// -------------------------------------------------
+// Small in-place helpers for column vectors of equal length.
+// None of them allocate.
+
+static void copyIn(KMatrix & dst, const KMatrix & src) {
+  const unsigned int n = src.numR();
+  for (unsigned int i = 0; i < n; i++) {
+    dst(i, 0) = src(i, 0);
+  }
+  return;
+}
+
+// dst = a - t*b
+static void stepIn(KMatrix & dst, const KMatrix & a, double t, const KMatrix & b) {
+  const unsigned int n = a.numR();
+  for (unsigned int i = 0; i < n; i++) {
+    dst(i, 0) = a(i, 0) - t * b(i, 0);
+  }
+  return;
+}
+
+static double dotIn(const KMatrix & a, const KMatrix & b) {
+  const unsigned int n = a.numR();
+  double s = 0.0;
+  for (unsigned int i = 0; i < n; i++) {
+    s = s + a(i, 0) * b(i, 0);
+  }
+  return s;
+}
+
+// |a - b|, Euclidean
+static double normDiff(const KMatrix & a, const KMatrix & b) {
+  const unsigned int n = a.numR();
+  double s = 0.0;
+  for (unsigned int i = 0; i < n; i++) {
+    const double d = a(i, 0) - b(i, 0);
+    s = s + d * d;
+  }
+  return sqrt(s);
+}
+
+static double maxAbsDiff(const KMatrix & a, const KMatrix & b) {
+  const unsigned int n = a.numR();
+  double m = 0.0;
+  for (unsigned int i = 0; i < n; i++) {
+    const double d = fabs(a(i, 0) - b(i, 0));
+    m = (d > m) ? d : m;
+  }
+  return m;
+}
+
+static double secondsSince(std::chrono::time_point<std::chrono::steady_clock> st) {
+  std::chrono::duration<double> dt = std::chrono::steady_clock::now() - st;
+  return dt.count();
+}
+
+
+void projPosIn(KMatrix & x) {
+  for (auto & xi : x) {
+    xi = (0 < xi) ? xi : 0;
+  }
+  return;
+}
+
+
+VIProj projBoxIn(const KMatrix & lb, const KMatrix & ub) {
+  if ((lb.numR() != ub.numR()) || (lb.numC() != ub.numC())) {
+    throw KException("projBoxIn: lb and ub must be the same size");
+  }
+  for (unsigned int i = 0; i < lb.numR(); i++) {
+    for (unsigned int j = 0; j < lb.numC(); j++) {
+      if (lb(i, j) > ub(i, j)) {
+        throw KException("projBoxIn: lij should not be more than uij");
+      }
+    }
+  }
+  auto box = [lb, ub](KMatrix & x) {
+    for (unsigned int i = 0; i < x.numR(); i++) {
+      for (unsigned int j = 0; j < x.numC(); j++) {
+        double xij = x(i, j);
+        xij = (lb(i, j) < xij) ? xij : lb(i, j);
+        xij = (xij < ub(i, j)) ? xij : ub(i, j);
+        x(i, j) = xij;
+      }
+    }
+    return;
   };
-  auto normS = [](const KMatrix & m) {
-    double n = norm(m);
-    return (n*n);
+  return box;
+}
+
+
+VIProj projInPlace(function<KMatrix(const KMatrix &)> P) {
+  auto pIn = [P](KMatrix & x) {
+    x = P(x);
+    return;
   };
+  return pIn;
+}
 
 
-  KMatrix u1 = pK(u0); // project onto K before first iteration
-  KMatrix e1 = err(u1);
-  double r = maxAbs(e1) / qMax;
-  unsigned int iter = 0;
+void VIWorkspace::resize(unsigned int n) {
+  if (size() == n) {
+    return;
+  }
+  for (KMatrix * m : {&f0, &xb, &fb, &xPrev, &y, &fy, &x1, &f1, &e, &g}) {
+    *m = KMatrix(n, 1);
+  }
+  return;
+}
 
-  while (r > eps) {
-    KMatrix g1 = Mt*e1 + (M*u1 + q);
-    double rho = normS(e1) / normS((I + Mt)*e1);
-    KMatrix u2 = pK(u1 - gamma*rho*g1);
-    KMatrix e2 = err(u2);
 
-    iter++;
-    if (iter >= iMax) {
-      throw KException("viBSHe96: iteration number crossed the upper limit");
+unsigned int VIWorkspace::size() const {
+  return f0.numR();
+}
+
+
+VITrace viSolve(KMatrix & x, VIFn F, VIProj P, const VIParams & prm, VIWorkspace & ws) {
+  if ((prm.beta <= 0) || (1 <= prm.beta) || (prm.thresh <= 0)) {
+    throw KException("viSolve: invalid input parameters");
+  }
+  if ((prm.shrink <= 0) || (1 <= prm.shrink) || (prm.grow < 1)) {
+    throw KException("viSolve: invalid step-control parameters");
+  }
+  if (1 != x.numC()) {
+    throw KException("viSolve: x can have only one column");
+  }
+  const auto st = std::chrono::steady_clock::now();
+  const unsigned int n = x.numR();
+  ws.resize(n);
+  auto trc = VITrace();
+
+  // natural residual at (z, fz), using ws.e as scratch
+  auto natRes = [&ws, &trc, P](const KMatrix & z, const KMatrix & fz) {
+    stepIn(ws.e, z, 1.0, fz);
+    P(ws.e);
+    trc.numProj++;
+    return maxAbsDiff(z, ws.e);
+  };
+
+  P(x);
+  trc.numProj++;
+  F(x, ws.f0);
+  trc.numF++;
+  copyIn(ws.xPrev, x);
+  double r = natRes(x, ws.f0);
+
+  double t = prm.step0;
+  if (t <= 0) {
+    // probe a tiny step to get a first estimate of the Lipschitz constant
+    const double fMax = maxAbsDiff(ws.f0, KMatrix(n, 1));
+    const double delta = 1E-6 * (1.0 + maxAbsDiff(x, KMatrix(n, 1))) / ((fMax > 0) ? fMax : 1.0);
+    stepIn(ws.y, x, delta, ws.f0);
+    P(ws.y);
+    F(ws.y, ws.fy);
+    trc.numProj++;
+    trc.numF++;
+    const double dy = normDiff(ws.y, x);
+    const double df = normDiff(ws.fy, ws.f0);
+    t = ((0 < dy) && (0 < df)) ? (prm.beta * dy / df) : 1.0;
+  }
+
+  unsigned int k = 0; // iterations since the last momentum restart
+  while ((r > prm.thresh) && (trc.iter < prm.iMax)) {
+    // base point: either x itself or its extrapolation along the last move
+    if (prm.nesterov && (0 < k)) {
+      const double theta = ((double)(k - 1)) / ((double)(k + 2));
+      for (unsigned int i = 0; i < n; i++) {
+        ws.xb(i, 0) = x(i, 0) + theta * (x(i, 0) - ws.xPrev(i, 0));
+      }
+      P(ws.xb);
+      F(ws.xb, ws.fb);
+      trc.numProj++;
+      trc.numF++;
+    }
+    else {
+      copyIn(ws.xb, x);
+      copyIn(ws.fb, ws.f0);
+    }
+
+    // predictor step, backtracking until the local Lipschitz test passes
+    bool cut = false;
+    while (true) {
+      stepIn(ws.y, ws.xb, t, ws.fb);
+      P(ws.y);
+      F(ws.y, ws.fy);
+      trc.numProj++;
+      trc.numF++;
+      const double dy = normDiff(ws.y, ws.xb);
+      const double df = normDiff(ws.fy, ws.fb);
+      if ((t * df <= prm.beta * dy) || (0 == dy)) {
+        break;
+      }
+      t = t * prm.shrink;
+      cut = true;
+      trc.numBacktrack++;
+    }
+
+    // corrector step
+    if (prm.extra) {
+      stepIn(ws.x1, ws.xb, t, ws.fy);
+      P(ws.x1);
+      F(ws.x1, ws.f1);
+      trc.numProj++;
+      trc.numF++;
+    }
+    else {
+      copyIn(ws.x1, ws.y);
+      copyIn(ws.f1, ws.fy);
+    }
+
+    const double r1 = natRes(ws.x1, ws.f1);
+    if (prm.nesterov && (r1 > r)) {
+      k = 0;
+      trc.numRestart++;
+    }
+    else {
+      k++;
+    }
+
+    // Barzilai-Borwein estimate for the next step, s.s/s.w, with growth limited
+    for (unsigned int i = 0; i < n; i++) {
+      ws.e(i, 0) = ws.f1(i, 0) - ws.fb(i, 0);
+      ws.g(i, 0) = ws.x1(i, 0) - ws.xb(i, 0);
+    }
+    const double sw = dotIn(ws.g, ws.e);
+    const double ss = dotIn(ws.g, ws.g);
+    if (prm.keepTrace) {
+      trc.steps.push_back(t);
+    }
+    // a step which just had to be cut back is not grown again right away
+    double tNext = cut ? t : (prm.grow * t);
+    if (0 < sw) {
+      const double tBB = ss / sw;
+      tNext = (tBB < tNext) ? tBB : tNext;
+    }
+    t = tNext;
+
+    copyIn(ws.xPrev, x);
+    copyIn(x, ws.x1);
+    copyIn(ws.f0, ws.f1);
+    r = r1;
+    trc.iter++;
+    if (prm.keepTrace) {
+      trc.resid.push_back(r);
     }
-    u1 = u2;
-    e1 = e2;
-    r = maxAbs(e1) / qMax;
   }
-  auto trpl = tuple<KMatrix, unsigned int, KMatrix>(u1, iter, e1);
-  return trpl;
+
+  // ws.e was step-size scratch; leave the residual vector x - P(x - F(x)) in it
+  stepIn(ws.g, x, 1.0, ws.f0);
+  P(ws.g);
+  trc.numProj++;
+  for (unsigned int i = 0; i < n; i++) {
+    ws.e(i, 0) = x(i, 0) - ws.g(i, 0);
+  }
+
+  trc.residual = r;
+  trc.converged = (r <= prm.thresh);
+  trc.seconds = secondsSince(st);
+  return trc;
+}
+
+
+VITrace viLinBSHe96(KMatrix & u, VIFn Mx, VIFn Mtx, const KMatrix & q,
+                    VIProj pK, const VIParams & prm, VIWorkspace & ws) {
+  const unsigned int n = q.numR();
+  if (1 != q.numC()) {
+    throw KException("viLinBSHe96: q matrix doesn't have one column");
+  }
+  if ((n != u.numR()) || (1 != u.numC())) {
+    throw KException(string("viLinBSHe96: u must be a column with ") + std::to_string(n) + " rows");
+  }
+  if (prm.thresh <= 0.0) {
+    throw KException("viLinBSHe96: thresh must be positive");
+  }
+  const double qMax = maxAbs(q);
+  if (qMax <= 0.0) {
+    throw KException("viLinBSHe96: qMax must be positive");
+  }
+  const auto st = std::chrono::steady_clock::now();
+  ws.resize(n);
+  auto trc = VITrace();
+  const double gamma = 1.8; // any 0<gamma<2 will do. Note that 1.618034 = (1+sqrt(5))/2
+
+  // ws.f0 = M*u + q and ws.e = u - pK(u - (M*u + q)), which is 0 iff u solves the VI
+  auto err = [&ws, &trc, &q, Mx, pK, n](const KMatrix & uu) {
+    Mx(uu, ws.f0);
+    for (unsigned int i = 0; i < n; i++) {
+      ws.f0(i, 0) = ws.f0(i, 0) + q(i, 0);
+    }
+    stepIn(ws.y, uu, 1.0, ws.f0);
+    pK(ws.y);
+    for (unsigned int i = 0; i < n; i++) {
+      ws.e(i, 0) = uu(i, 0) - ws.y(i, 0);
+    }
+    trc.numF++;
+    trc.numProj++;
+    return maxAbs(ws.e);
+  };
+
+  pK(u); // project onto K before first iteration
+  trc.numProj++;
+  double r = err(u) / qMax;
+
+  while ((r > prm.thresh) && (trc.iter < prm.iMax)) {
+    Mtx(ws.e, ws.g); // M'*e
+    trc.numF++;
+    double ee = 0.0;
+    double ie = 0.0; // |(I + M')*e|^2
+    for (unsigned int i = 0; i < n; i++) {
+      const double ei = ws.e(i, 0);
+      const double di = ei + ws.g(i, 0);
+      ee = ee + ei * ei;
+      ie = ie + di * di;
+      ws.g(i, 0) = ws.g(i, 0) + ws.f0(i, 0); // M'*e + (M*u + q)
+    }
+    const double rho = ee / ie;
+    stepIn(u, u, gamma * rho, ws.g);
+    pK(u);
+    trc.numProj++;
+    r = err(u) / qMax;
+    trc.iter++;
+    if (prm.keepTrace) {
+      trc.resid.push_back(r);
+      trc.steps.push_back(gamma * rho);
+    }
+  }
+
+  trc.residual = r;
+  trc.converged = (r <= prm.thresh);
+  trc.seconds = secondsSince(st);
+  return trc;
+}
+
+
+VITrace viLinBSHe96(KMatrix & u, const KMatrix & M, const KMatrix & q,
+                    VIProj pK, const VIParams & prm, VIWorkspace & ws) {
+  const unsigned int n = q.numR();
+  if ((n != M.numR()) || (n != M.numC())) {
+    throw KException(string("viLinBSHe96: M must be ") + std::to_string(n) + " square");
+  }
+  auto mx = [&M, n](const KMatrix & x, KMatrix & y) {
+    for (unsigned int i = 0; i < n; i++) {
+      double s = 0.0;
+      for (unsigned int k = 0; k < n; k++) {
+        s = s + M(i, k) * x(k, 0);
+      }
+      y(i, 0) = s;
+    }
+    return;
+  };
+  auto mtx = [&M, n](const KMatrix & x, KMatrix & y) {
+    for (unsigned int i = 0; i < n; i++) {
+      y(i, 0) = 0.0;
+    }
+    for (unsigned int k = 0; k < n; k++) {
+      const double xk = x(k, 0);
+      for (unsigned int i = 0; i < n; i++) {
+        y(i, 0) = y(i, 0) + M(k, i) * xk;
+      }
+    }
+    return;
+  };
+  return viLinBSHe96(u, mx, mtx, q, pK, prm, ws);
+}
+
+
+
+VITrace viLinBSHe96(KMatrix & u, const SMatrix & M, const KMatrix & q,
+                    VIProj pK, const VIParams & prm, VIWorkspace & ws) {
+  const unsigned int n = q.numR();
+  if ((n != M.numR()) || (n != M.numC())) {
+    throw KException(string("viLinBSHe96: M must be ") + std::to_string(n) + " square");
+  }
+  auto mx = [&M](const KMatrix & x, KMatrix & y) {
+    M.mulVec(x, y);
+    return;
+  };
+  auto mtx = [&M](const KMatrix & x, KMatrix & y) {
+    M.mulTVec(x, y);
+    return;
+  };
+  return viLinBSHe96(u, mx, mtx, q, pK, prm, ws);
 }
 
 }; // namespace
@@ -34,6 +34,7 @@
 
 #include "kutils.h"
 #include "kmatrix.h"
+#include "smatrix.h"
 #include "prng.h"
 
 namespace KBase {
@@ -55,6 +56,91 @@ tuple<KMatrix, unsigned int, KMatrix> viABG(const KMatrix & xInit,
 tuple<KMatrix, unsigned int, KMatrix> viBSHe96(const KMatrix & M, const KMatrix & q,
                                                function<KMatrix(const KMatrix &)> pK,
                                                KMatrix u0, const double eps, const unsigned int iMax);
+tuple<KMatrix, unsigned int, KMatrix> viBSHe96(const SMatrix & M, const KMatrix & q,
+                                               function<KMatrix(const KMatrix &)> pK,
+                                               KMatrix u0, const double eps, const unsigned int iMax);
+
+
+// -------------------------------------------------
+// The solvers below work in place on a reusable workspace, adapt their step size,
+// and return a convergence trace instead of throwing when the iteration limit is hit.
+// The point passed in is both the warm start and the result, so a solve which
+// ran out of iterations can simply be resumed.
+
+// F(x), written into fx, which is already the right size
+typedef function<void(const KMatrix & x, KMatrix & fx)> VIFn;
+
+// projection onto the feasible set K, done in place
+typedef function<void(KMatrix & x)> VIProj;
+
+void projPosIn(KMatrix & x);
+VIProj projBoxIn(const KMatrix & lb, const KMatrix & ub);
+
+// adapt a projection which returns a new matrix, like projPos
+VIProj projInPlace(function<KMatrix(const KMatrix &)> P);
+
+class VIParams {
+public:
+  double thresh = 1E-6;     // stop when the residual is below this
+  unsigned int iMax = 1000; // iteration limit
+  double beta = 0.5;        // 0<beta<1: a step t is accepted if t*|F(y)-F(x)| <= beta*|y-x|
+  double shrink = 0.5;      // backtracking factor applied to rejected steps
+  double grow = 2.0;        // limit on the growth of the step from one iteration to the next
+  double step0 = 0.0;       // initial step; zero means estimate it from a small probe
+  bool extra = true;        // extragradient correction (two F per step, but much more robust)
+  bool nesterov = false;    // Nesterov-style extrapolation, restarted when the residual rises
+  bool keepTrace = true;    // record residual and step at every iteration
+};
+
+class VITrace {
+public:
+  bool converged = false;
+  unsigned int iter = 0;         // iterations performed
+  unsigned int numF = 0;         // evaluations of F (or products with M or M')
+  unsigned int numProj = 0;      // projections onto K
+  unsigned int numBacktrack = 0; // rejected steps
+  unsigned int numRestart = 0;   // momentum restarts
+  double residual = 0.0;         // final residual
+  double seconds = 0.0;          // wall-clock time of the solve
+  vector<double> resid = {};     // residual after each iteration
+  vector<double> steps = {};     // step size used at each iteration
+};
+
+// Scratch columns, sized once and reused by every iteration (and by later solves of
+// the same size), so the inner loop does not allocate.
+class VIWorkspace {
+public:
+  void resize(unsigned int n);
+  unsigned int size() const;
+
+  KMatrix f0 = KMatrix();
+  KMatrix xb = KMatrix();
+  KMatrix fb = KMatrix();
+  KMatrix xPrev = KMatrix();
+  KMatrix y = KMatrix();
+  KMatrix fy = KMatrix();
+  KMatrix x1 = KMatrix();
+  KMatrix f1 = KMatrix();
+  KMatrix e = KMatrix();
+  KMatrix g = KMatrix();
+};
+
+// Find x in K such that (z-x).F(x) >= 0 for all z in K, by projected (extra)gradient
+// steps with Barzilai-Borwein step estimates, backtracking, and optional extrapolation.
+// The residual is the natural residual, maxAbs(x - P(x - F(x))). On return,
+// ws.f0 holds F(x) and ws.e holds the residual vector x - P(x - F(x)).
+VITrace viSolve(KMatrix & x, VIFn F, VIProj P, const VIParams & prm, VIWorkspace & ws);
+
+// BSHe96 for the linear case, F(u) = M*u + q. Only products with M and M' are needed,
+// so M can be held in any form. The residual is maxAbs(e)/maxAbs(q), as in viBSHe96,
+// and on return ws.e holds e = u - pK(u - (M*u + q)).
+// BSHe96 has no step-size parameters, so only thresh, iMax and keepTrace are used.
+VITrace viLinBSHe96(KMatrix & u, VIFn Mx, VIFn Mtx, const KMatrix & q,
+                    VIProj pK, const VIParams & prm, VIWorkspace & ws);
+VITrace viLinBSHe96(KMatrix & u, const KMatrix & M, const KMatrix & q,
+                    VIProj pK, const VIParams & prm, VIWorkspace & ws);
+VITrace viLinBSHe96(KMatrix & u, const SMatrix & M, const KMatrix & q,
+                    VIProj pK, const VIParams & prm, VIWorkspace & ws);
 
 }; // namespace
 
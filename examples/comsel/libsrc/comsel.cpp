@@ -502,6 +502,18 @@ namespace ComSelLib {
       s2->pstns[h] = nullptr;
       auto ph = ((const MtchPstn *)(pstns[h]));
 
+      // keys of everyone's actual positions, for the uniqueness test in efn.
+      // GHCSearch calls efn sequentially, so it can update this in place.
+      vector<VUI> keys = {};
+      for (auto p : pstns) {
+        auto mp = ((const MtchPstn *)p);
+        if (mp == nullptr) {
+          throw KException("CSState::doSUSN: mp is null pointer");
+        }
+        keys.push_back(mp->eqvKey());
+      }
+      auto uek = KBase::KeyedUENdx<VUI, KBase::VUIHash>(keys);
+
       // Evaluate h's estimate of the expected utility, to h, of
       // advocating position mp. To do this, build a hypothetical utility matrix representing
       // h's estimates of the direct utilities to all other actors of h adopting this
@@ -510,7 +522,7 @@ namespace ComSelLib {
       // and everyone else's actual position. Finally, compute the expected utility to
       // each actor, given that distribution, and pick out the value for h's expected utility.
       // That is the expected value to h of adopting the position.
-      auto efn = [this, euMat, rl, u, h](const MtchPstn & mph) {
+      auto efn = [this, euMat, rl, u, h, &uek](const MtchPstn & mph) {
         // This correctly handles duplicated/unique options
         // We modify the given euMat so that the h-column
         // corresponds to the given mph, but we need to prune duplicates as well.
@@ -539,36 +551,10 @@ namespace ComSelLib {
         // This entails juggling back and forth between the all current positions
         // and the one hypothetical position (mph at h).
         // Thus, the next call to euMat will consider only unique options.
-        auto equivHNdx = [this, h, mph](const unsigned int i, const unsigned int j) {
-          // this little function takes care of the different types needed to compare
-          // dynamic pointers to positions (all but h) with a constant position (h itself).
-          // In other words, the comparisons for index 'h' use the hypothetical mph, not pstns[h]
-          bool rslt = false;
-          auto mpi = ((const MtchPstn *)(pstns[i]));
-          auto mpj = ((const MtchPstn *)(pstns[j]));
-          if (mpi == nullptr) {
-            throw KException("CSState::doSUSN: mpi is null pointer");
-          }
-          if (mpj == nullptr) {
-            throw KException("CSState::doSUSN: mpj is null pointer");
-          }
-          if (i == j) {
-            rslt = true; // Pi == Pj, always
-          }
-          else if (h == i) {
-            rslt = (mph == (*mpj));
-          }
-          else if (h == j) {
-            rslt = ((*mpi) == mph);
-          }
-          else {
-            rslt = ((*mpi) == (*mpj));
-          }
-          return rslt;
-        };
-
-        auto ns = KBase::uiSeq(0, model->numAct - 1);
-        const VUI uNdx = get<0>(KBase::ueIndices<unsigned int>(ns, equivHNdx));
+        // Only h's key differs from the actual state, so update just that entry
+        // and read off the unique positions, in the same order ueIndices would give.
+        uek.setKey(h, mph.eqvKey());
+        const VUI uNdx = uek.uniques();
         auto numU = ((const unsigned int)(uNdx.size()));
         auto hypUtil = KMatrix(model->numAct, numU);
         // we need now to go through 'uh', copying column J the first time
@@ -742,6 +728,19 @@ namespace ComSelLib {
     return rslt;
   }
 
+  tuple<VUI, VUI> CSState::ueNdx() const {
+    // Same equivalence as equivNdx, but hashed rather than compared pairwise
+    vector<VUI> keys = {};
+    for (auto p : pstns) {
+      auto mp = ((const MtchPstn *)p);
+      if (mp == nullptr) {
+        throw KException("CSState::ueNdx: mp is null pointer");
+      }
+      keys.push_back(mp->eqvKey());
+    }
+    return KBase::ueIndicesByKey<VUI, KBase::VUIHash>(keys);
+  }
+
   void CSState::setAllAUtil(ReportingLevel rl) {
     auto csm = ((CSModel*)model);
     const unsigned int na = csm->numAct;
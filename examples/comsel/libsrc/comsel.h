@@ -177,6 +177,7 @@ namespace ComSelLib {
                         const KMatrix & uMat) const; 
      
     virtual bool equivNdx(unsigned int i, unsigned int j) const;
+    virtual tuple<VUI, VUI> ueNdx() const;
 
   private:
   };
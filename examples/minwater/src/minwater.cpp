@@ -535,6 +535,18 @@ void demoRMLP(PRNG* rng) {
     auto matM = joinV(topMat, botMat);
     auto matQ = joinV(rmlp->rCosts, -1.0 * matB);
 
+    // the same M, kept sparse: it is mostly structural zeros
+    using KBase::SMatrix;
+    auto sprsA = joinV(joinV(SMatrix::fromDense(rmlp->portWghts), SMatrix::fromDense(sdMat)),
+                       joinV(KBase::sIMat(N), -1.0 * KBase::sIMat(N)));
+    auto sprsM = joinV(joinH(SMatrix(N, N), -1.0 * trans(sprsA)),
+                       joinH(sprsA, SMatrix(M, M)));
+    if (0 != KBase::maxAbs(sprsM.toDense() - matM)) {
+      throw KException("demoRMLP: sparse and dense M differ");
+    }
+    LOG(INFO) << KBase::getFormattedString("M is %u by %u, with %u non-zeros",
+                                           sprsM.numR(), sprsM.numC(), sprsM.numNZ());
+
     // reaffirm that everything is structured as expected
     if (3 * N + (K1 + K2) != matM.numR()) {
       throw KException("demoRMLP: inaccurate number of rows in matM");
@@ -626,6 +638,48 @@ void demoRMLP(PRNG* rng) {
             LOG(INFO) << KBase::getFormattedString("Percentage change %+.3f", (100.0*(rsrc2 - rsrc0) / rsrc0));
     }
 
+    if (true) { // both share one workspace, so the second solve does not allocate
+            auto showTrace = [](string name, const KBase::VITrace & trc) {
+                LOG(INFO) << KBase::getFormattedString(
+                    "%s: converged %s after %u iterations, residual %.3E",
+                    name.c_str(), (trc.converged ? "yes" : "no"), trc.iter, trc.residual);
+                LOG(INFO) << KBase::getFormattedString(
+                    "%s: %u F-evals, %u projections, %u backtracks, %u restarts, %.4f sec",
+                    name.c_str(), trc.numF, trc.numProj, trc.numBacktrack, trc.numRestart, trc.seconds);
+            };
+            auto prm = KBase::VIParams();
+            prm.thresh = eps;
+            prm.iMax = iterLim;
+            prm.keepTrace = false;
+            auto ws = KBase::VIWorkspace();
+
+            LOG(INFO) << "Solve via in-place BSHe96, with sparse M";
+            KMatrix u3 = start;
+            auto t3 = viLinBSHe96(u3, sprsM, matQ, KBase::projPosIn, prm, ws);
+            showTrace("BSHe96", t3);
+            auto x3 = processRslt(tuple<KMatrix, unsigned int, KMatrix>(u3, t3.iter, ws.e));
+            const double rsrc3 = dot(x3, rmlp->rCosts);
+            LOG(INFO) << KBase::getFormattedString("Minimized resource usage: %10.2f", rsrc3);
+
+            LOG(INFO) << "Solve via adaptive extragradient";
+            // written straight into the workspace column, so no KMatrix is made per call
+            auto fIn = [&sprsM, &matQ](const KMatrix & x, KMatrix & fx) {
+                sprsM.mulVec(x, fx);
+                for (unsigned int i = 0; i < fx.numR(); i++) {
+                    fx(i, 0) = fx(i, 0) + matQ(i, 0);
+                }
+                return;
+            };
+            KMatrix u4 = start;
+            auto t4 = viSolve(u4, fIn, KBase::projPosIn, prm, ws);
+            showTrace("AdaptEG", t4);
+            if (t4.converged) {
+              auto x4 = processRslt(tuple<KMatrix, unsigned int, KMatrix>(u4, t4.iter, ws.e));
+              const double rsrc4 = dot(x4, rmlp->rCosts);
+              LOG(INFO) << KBase::getFormattedString("Minimized resource usage: %10.2f", rsrc4);
+            }
+    }
+
     delete rmlp;
     rmlp = nullptr;
     return;
@@ -196,6 +196,7 @@ protected:
 
   // determine if the i-th position in this state is equivalent to the j-th position
   virtual bool equivNdx(unsigned int i, unsigned int j) const;
+  virtual tuple<VUI, VUI> ueNdx() const;
 
 private:
 };
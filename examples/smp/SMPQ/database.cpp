@@ -67,6 +67,10 @@ void Database::addDatabase(const QString &driver)
 
 void Database::openDB(QString dbPath, QString dbType, QString connectionString, bool run)
 {
+    // a new database may reuse scenario ids, so drop any cached positions
+    posCube.clear();
+    cubeScenario.clear();
+
     if(dbType == "QSQLITE")
     {
         addDatabase(dbType);
@@ -383,17 +387,29 @@ void Database::getActorsInRangeFromDB(double lowerRng, double higherRng, int dim
     actorCapabilityList.clear();
     barData=0;
 
-    QString query= QString(" select Act_i from VectorPosition where"
-                           " Pos_Coord >= '%1'  AND Pos_Coord < '%2' AND "
-                           " Dim_k='%3' AND ScenarioId='%4' "
-                           "AND Turn_t='%5'")
-            .arg(lwr).arg(upr).arg(dim).arg(scenarioM).arg(turn);
+    if(loadPositionCube(scenarioM) && turn < cubeTurns && dim < cubeDims)
+    {
+        for(int act = 0; act < cubeActors; ++act)
+        {
+            const double pos = cubePosition(turn,act,dim);
+            if(pos >= lwr && pos < upr)
+                actorIdsList.append(act);
+        }
+    }
+    else
+    {
+        QString query= QString(" select Act_i from VectorPosition where"
+                               " Pos_Coord >= '%1'  AND Pos_Coord < '%2' AND "
+                               " Dim_k='%3' AND ScenarioId='%4' "
+                               "AND Turn_t='%5'")
+                .arg(lwr).arg(upr).arg(dim).arg(scenarioM).arg(turn);
 
-    qry->exec(query);
+        qry->exec(query);
 
-    while(qry->next())
-    {
-        actorIdsList.append(qry->value(0).toInt());
+        while(qry->next())
+        {
+            actorIdsList.append(qry->value(0).toInt());
+        }
     }
 
     for(int actInd =0; actInd < actorIdsList.length() ; actInd++)
@@ -497,6 +513,8 @@ void Database::releaseDB()
         db = nullptr;
         QSqlDatabase::removeDatabase("guiDb");
     }
+    posCube.clear();
+    cubeScenario.clear();
 }
 
 void Database::getActorMovedDataDB(QString scenario)
@@ -506,37 +524,57 @@ void Database::getActorMovedDataDB(QString scenario)
     int colIndex =0;
     int rowIndex =0;
 
+    auto readMoves = [&]()
+    {
+        while(qry->next())
+        {
+            actorMovedModel->setItem(rowIndex,colIndex,new QStandardItem(qry->value(0).toString().trimmed()));
+            actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(1).toString().trimmed()));
+            actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(2).toString().trimmed()));
+            actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(3).toString().trimmed()));
+            actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(4).toString().trimmed()));
+            actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(5).toString().trimmed()));
+            actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(6).toString().trimmed()));
+            actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(7).toString().trimmed()));
+            actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(8).toString().trimmed()));
+            actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(9).toString().trimmed()));
+            actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(10).toString().trimmed()));
+
+            ++rowIndex;
+            colIndex=0;
+        }
+    };
+
     QString query;
 
+    // runs which logged PositionMoves already have the moves, one row each
     query= QString("select M.Movd_Turn, M.Act_i as Movd_ActorID, M.Dim_k, M.PrevPos, M.CurrPos, M.Diff, "
-                   "M.Mover_BargnID, MI.Name as Initiator, MR.Name as Receiver, B.Init_Act_i, B.Recd_Act_j "
-                   "from (select L0.Act_i, L0.Dim_k, L0.Turn_t as Movd_Turn, L0.Mover_BargnId, L0.Pos_Coord "
-                   "as CurrPos, L1.Pos_Coord as PrevPos, L0.Pos_Coord - L1.Pos_Coord as Diff "
-                   "from (select * from VectorPosition where Turn_t <> 0 and ScenarioID = '%1') "
-                   "as L0 inner join (select * from VectorPosition where ScenarioID = '%1') "
-                   "as L1 on L0.Turn_t = (L1.Turn_t+1) and L0.Act_i = L1.Act_i and L0.Dim_k = L1.Dim_k "
-                   "where L0.Pos_Coord <> L1.Pos_Coord ) as M inner join (select * from Bargn where "
-                   "ScenarioID = '%1') as B on M.Mover_BargnId = B.BargnId inner join "
-                   "ActorDescription as MI on B.Init_Act_i = MI.Act_i and B.ScenarioID = MI.ScenarioID inner join "
-                   "ActorDescription as MR on B.Recd_Act_j = MR.Act_i and B.ScenarioID = MR.ScenarioID  ").arg(scenario);
+                   "M.Mover_BargnId, MI.Name as Initiator, MR.Name as Receiver, M.Init_Act_i, M.Recd_Act_j "
+                   "from PositionMoves as M inner join "
+                   "ActorDescription as MI on M.Init_Act_i = MI.Act_i and M.ScenarioId = MI.ScenarioId inner join "
+                   "ActorDescription as MR on M.Recd_Act_j = MR.Act_i and M.ScenarioId = MR.ScenarioId "
+                   "where M.ScenarioId = '%1' order by M.Movd_Turn, M.Act_i, M.Dim_k").arg(scenario);
 
     qry->exec(query);
-    while(qry->next())
-    {
-        actorMovedModel->setItem(rowIndex,colIndex,new QStandardItem(qry->value(0).toString().trimmed()));
-        actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(1).toString().trimmed()));
-        actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(2).toString().trimmed()));
-        actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(3).toString().trimmed()));
-        actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(4).toString().trimmed()));
-        actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(5).toString().trimmed()));
-        actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(6).toString().trimmed()));
-        actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(7).toString().trimmed()));
-        actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(8).toString().trimmed()));
-        actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(9).toString().trimmed()));
-        actorMovedModel->setItem(rowIndex,++colIndex,new QStandardItem(qry->value(10).toString().trimmed()));
-
-        ++rowIndex;
-        colIndex=0;
+    readMoves();
+
+    if(0==rowIndex)
+    {
+        // older databases: derive the moves from successive VectorPosition rows
+        query= QString("select M.Movd_Turn, M.Act_i as Movd_ActorID, M.Dim_k, M.PrevPos, M.CurrPos, M.Diff, "
+                       "M.Mover_BargnID, MI.Name as Initiator, MR.Name as Receiver, B.Init_Act_i, B.Recd_Act_j "
+                       "from (select L0.Act_i, L0.Dim_k, L0.Turn_t as Movd_Turn, L0.Mover_BargnId, L0.Pos_Coord "
+                       "as CurrPos, L1.Pos_Coord as PrevPos, L0.Pos_Coord - L1.Pos_Coord as Diff "
+                       "from (select * from VectorPosition where Turn_t <> 0 and ScenarioID = '%1') "
+                       "as L0 inner join (select * from VectorPosition where ScenarioID = '%1') "
+                       "as L1 on L0.Turn_t = (L1.Turn_t+1) and L0.Act_i = L1.Act_i and L0.Dim_k = L1.Dim_k "
+                       "where L0.Pos_Coord <> L1.Pos_Coord ) as M inner join (select * from Bargn where "
+                       "ScenarioID = '%1') as B on M.Mover_BargnId = B.BargnId inner join "
+                       "ActorDescription as MI on B.Init_Act_i = MI.Act_i and B.ScenarioID = MI.ScenarioID inner join "
+                       "ActorDescription as MR on B.Recd_Act_j = MR.Act_i and B.ScenarioID = MR.ScenarioID  ").arg(scenario);
+
+        qry->exec(query);
+        readMoves();
     }
     emit actorMovedInfo(actorMovedModel);
 }
@@ -546,6 +584,52 @@ QString Database::getConnectionName()
     return db->connectionName();
 }
 
+bool Database::loadPositionCube(QString scenario)
+{
+    if(0==cubeScenario.compare(scenario))
+        return !posCube.isEmpty();
+
+    cubeScenario = scenario;
+    posCube.clear();
+    cubeActorNames.clear();
+    cubeTurns = cubeActors = cubeDims = 0;
+
+    QSqlQuery cubeQry(*db);
+    cubeQry.prepare("select NumTurns, NumActors, NumDims, Pos_Cube from PositionCube where ScenarioId = :scen");
+    cubeQry.bindValue(":scen", scenario);
+    if(!cubeQry.exec() || !cubeQry.next())
+        return false; // older databases: fall back to VectorPosition
+
+    const int nt = cubeQry.value(0).toInt();
+    const int na = cubeQry.value(1).toInt();
+    const int nd = cubeQry.value(2).toInt();
+    const QByteArray bytes = cubeQry.value(3).toByteArray();
+    if(nt*na*nd <= 0 || bytes.size() != int(nt*na*nd*sizeof(double)))
+        return false;
+
+    posCube.resize(nt*na*nd);
+    memcpy(posCube.data(), bytes.constData(), bytes.size());
+    cubeTurns = nt;
+    cubeActors = na;
+    cubeDims = nd;
+
+    cubeQry.prepare("select Name from ActorDescription where ScenarioId = :scen order by Act_i");
+    cubeQry.bindValue(":scen", scenario);
+    if(cubeQry.exec())
+    {
+        while(cubeQry.next())
+        {
+            cubeActorNames.append(cubeQry.value(0).toString());
+        }
+    }
+    return true;
+}
+
+double Database::cubePosition(int turn, int actor, int dim) const
+{
+    return posCube.at((turn*cubeActors + actor)*cubeDims + dim);
+}
+
 void Database::getVectorPosition(int actor, int dim, int turn, QString scenario)
 {
     QString query;
@@ -553,6 +637,18 @@ void Database::getVectorPosition(int actor, int dim, int turn, QString scenario)
     int i =0;
     QVector<double> x(numStates+1), y(numStates+1);
 
+    if(loadPositionCube(scenario) && actor < cubeActors && dim < cubeDims
+            && actor < cubeActorNames.length())
+    {
+        for(int t = 0; t <= turn && t < cubeTurns && t <= numStates; ++t)
+        {
+            x[t]=t;
+            y[t]=cubePosition(t,actor,dim);// y scales from 0 to 100
+        }
+        emit vectorPosition(x,y,cubeActorNames.at(actor),turn);
+        return;
+    }
+
     query= QString("select * from VectorPosition where Act_i='%1' and Dim_k='%2' and Turn_t<='%3' and  ScenarioId = '%4' ")
             .arg(actor).arg(dim).arg(turn).arg(scenario);
 
@@ -590,26 +686,39 @@ void Database::readVectorPositionTable(int turn, QString scenario, int dim)
     getAffinityDB();
 
     sqlmodel = new QStandardItemModel(this);
-    QString query;
 
-    query= QString("select * from VectorPosition where Turn_t='%1' and Dim_k='%2' and ScenarioId='%3'")
-            .arg(turn).arg(dim).arg(scenario);
+    if(loadPositionCube(scenario) && turn < cubeTurns && dim < cubeDims)
+    {
+        // one row per actor, as the VectorPosition rows of this turn and dimension would give
+        for(int rowindex = 0; rowindex < cubeActors; ++rowindex)
+        {
+            sqlmodel->setItem(rowindex,0,new QStandardItem(scenario.trimmed()));
+            sqlmodel->setItem(rowindex,1,new QStandardItem(QString::number(turn)));
+        }
+    }
+    else
+    {
+        QString query;
+
+        query= QString("select * from VectorPosition where Turn_t='%1' and Dim_k='%2' and ScenarioId='%3'")
+                .arg(turn).arg(dim).arg(scenario);
 
-    qry->exec(query);
+        qry->exec(query);
 
-    int rowindex =0;
-    while(qry->next())
-    {
-        QString value = qry->value(0).toString();
-        QString value1 = qry->value(1).toString();
+        int rowindex =0;
+        while(qry->next())
+        {
+            QString value = qry->value(0).toString();
+            QString value1 = qry->value(1).toString();
 
-        QStandardItem *item = new QStandardItem(value.trimmed());
-        QStandardItem *item1 = new QStandardItem(value1.trimmed());
+            QStandardItem *item = new QStandardItem(value.trimmed());
+            QStandardItem *item1 = new QStandardItem(value1.trimmed());
 
-        sqlmodel->setItem(rowindex,0,item);
-        sqlmodel->setItem(rowindex,1,item1);
+            sqlmodel->setItem(rowindex,0,item);
+            sqlmodel->setItem(rowindex,1,item1);
 
-        ++rowindex;
+            ++rowindex;
+        }
     }
     // load parsed data to model accordingly
     emit dbModel(sqlmodel);
@@ -154,6 +154,18 @@ private:
 
     void getVectorPosition(int actor, int dim, int turn, QString scenario);
 
+    // turn x actor x dimension positions of one scenario, read from the PositionCube
+    // table in a single query; empty when the scenario was logged without it
+    QVector<double> posCube;
+    QStringList cubeActorNames;
+    QString cubeScenario;
+    int cubeTurns = 0;
+    int cubeActors = 0;
+    int cubeDims = 0;
+
+    bool loadPositionCube(QString scenario);
+    double cubePosition(int turn, int actor, int dim) const;
+
     //Default read Turn_t=0
     void readVectorPositionTable(int state, QString scenario, int dim);
 
@@ -23,6 +23,7 @@
 
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "smp.h"
 
 MainWindow::MainWindow()
 {
@@ -287,6 +288,7 @@ void MainWindow::dbGetFilePAth(bool bl, QString smpDBPath, bool run)
 
             yAxisMaxFixedVal=0;
             modeltoDB->clear();
+            SMPLib::SMPModel::clearQuadMapCache();
             emit dbFilePath(dbPath,conType,connectionString,run);
             turnSlider->setEnabled(true);
 
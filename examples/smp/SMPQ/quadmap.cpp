@@ -345,6 +345,9 @@ void MainWindow::getUtilChlgHorizontalVerticalAxisData(int turn)
         initiatorTip=initI;
     }
 
+    std::vector<SMPLib::QuadMapPt> vhPoints;
+    QVector<int> vhReceivers;
+
     for(int recdJ =0; recdJ < actorsName.length(); ++recdJ)
     {
         if(true==quadMapReceiversCheckBoxList.at(recdJ)->isChecked()
@@ -426,72 +429,58 @@ void MainWindow::getUtilChlgHorizontalVerticalAxisData(int turn)
                 VHAxisValues.append(recdJ);
             }
             //            emit getUtilChlgAndUtilSQfromDB(VHAxisValues);
-            double x,y;
-            QString exceptionMsg;
-            if(useHistory)
-            {
-                try {
-                    y =SMPLib::SMPModel::getQuadMapPoint(VHAxisValues.at(0),VHAxisValues.at(1),VHAxisValues.at(2),
-                                                         VHAxisValues.at(3),VHAxisValues.at(4));
-                    x =SMPLib::SMPModel::getQuadMapPoint(VHAxisValues.at(5),VHAxisValues.at(6),VHAxisValues.at(7),
-                                                         VHAxisValues.at(8),VHAxisValues.at(9));
-                }
-                catch (KException &ke)
-                {
-                    exceptionMsg = QString::fromStdString(ke.msg);
-                    displayMessage("Exception",exceptionMsg);
-                    LOG(INFO) << exceptionMsg.toStdString();
-                }
-                catch (std::exception &std_ex)
-                {
-                    exceptionMsg = std_ex.what();
-                    displayMessage("Exception",exceptionMsg);
-                    LOG(INFO) << exceptionMsg.toStdString();
-                }
-                catch (...)
-                {
-                    exceptionMsg = "SMPLib::SMPModel::getQuadMapPoint: Unknown Exception Caught while getting QuadMap values";
-                    displayMessage("Exception",exceptionMsg);
-                    LOG(INFO) << exceptionMsg.toStdString();
-                }
-            }
-            else
-            {
-                QString connectionName = dbObj->getConnectionName();
-                try {
-                    y =SMPLib::SMPModel::getQuadMapPoint(connectionName,scenarioBox.toStdString(),VHAxisValues.at(0),
-                                                         VHAxisValues.at(1),VHAxisValues.at(2),VHAxisValues.at(3),
-                                                         VHAxisValues.at(4));
-                    x =SMPLib::SMPModel::getQuadMapPoint(connectionName,scenarioBox.toStdString(),VHAxisValues.at(5),
-                                                         VHAxisValues.at(6),VHAxisValues.at(7),VHAxisValues.at(8),
-                                                         VHAxisValues.at(9));      }
-                catch (KException &ke)
-                {
-                    exceptionMsg = QString::fromStdString(ke.msg);
-                    displayMessage("Exception",exceptionMsg);
-                    LOG(INFO) << exceptionMsg.toStdString();
-                }
-                catch (std::exception &std_ex)
-                {
-                    exceptionMsg = std_ex.what();
-                    displayMessage("Exception",exceptionMsg);
-                    LOG(INFO) << exceptionMsg.toStdString();
-                }
-                catch (...)
-                {
-                    exceptionMsg = "SMPLib::SMPModel::getQuadMapPoint: Unknown Exception Caught while getting QuadMap values";
-                    displayMessage("Exception",exceptionMsg);
-                    LOG(INFO) << exceptionMsg.toStdString();
-                }
-            }
+            // vertical (y) then horizontal (x) point for this receiver; all are computed together below
+            vhPoints.push_back(SMPLib::QuadMapPt(VHAxisValues.at(1),VHAxisValues.at(2),
+                                                 VHAxisValues.at(3),VHAxisValues.at(4)));
+            vhPoints.push_back(SMPLib::QuadMapPt(VHAxisValues.at(6),VHAxisValues.at(7),
+                                                 VHAxisValues.at(8),VHAxisValues.at(9)));
+            vhReceivers.append(recdJ);
+        }
+    }
 
-            if(true==exceptionMsg.isEmpty())
-            {
-                quadMapUtilChlgandSQValues(VHAxisValues.at(0),x,y,VHAxisValues.at(4));
-                exceptionMsg.clear();
-            }
+    if(vhReceivers.isEmpty())
+        return;
+
+    std::vector<double> vhValues;
+    QString exceptionMsg;
+    try {
+        if(useHistory)
+        {
+            vhValues = SMPLib::SMPModel::getQuadMapPoints(turn,vhPoints);
+        }
+        else
+        {
+            QString connectionName = dbObj->getConnectionName();
+            vhValues = SMPLib::SMPModel::getQuadMapPoints(connectionName,scenarioBox.toStdString(),
+                                                          turn,vhPoints);
         }
     }
+    catch (KException &ke)
+    {
+        exceptionMsg = QString::fromStdString(ke.msg);
+    }
+    catch (std::exception &std_ex)
+    {
+        exceptionMsg = std_ex.what();
+    }
+    catch (...)
+    {
+        exceptionMsg = "SMPLib::SMPModel::getQuadMapPoints: Unknown Exception Caught while getting QuadMap values";
+    }
+
+    if(false==exceptionMsg.isEmpty())
+    {
+        displayMessage("Exception",exceptionMsg);
+        LOG(INFO) << exceptionMsg.toStdString();
+        return;
+    }
+
+    for(int r = 0; r < vhReceivers.length(); ++r)
+    {
+        double y = vhValues.at(2*r);
+        double x = vhValues.at(2*r+1);
+        quadMapUtilChlgandSQValues(turn,x,y,vhReceivers.at(r));
+    }
 }
 
 void MainWindow::plotScatterPointsOnGraph(QVector <double> x,QVector <double> y, int actIndex)
@@ -26,6 +26,11 @@
 // --------------------------------------------
 
 #include "smp.h"
+#include <cmath>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <unordered_map>
 #include <QSqlQuery>
 #include <QVariant>
 #include <QSqlError>
@@ -164,10 +169,36 @@ const unsigned int sqlBuffSize = 250;
 
 // this binds the given parameters and returns the λ-fn necessary to stop the SMP appropriately
 function<bool(unsigned int, const State *)>
-smpStopFn(unsigned int minIter, unsigned int maxIter, double minDeltaRatio, double minSigDelta) {
-    auto  sfn = [minIter, maxIter, minDeltaRatio, minSigDelta](unsigned int iter, const State * s) {
-        bool tooLong = (maxIter <= iter);
-        bool longEnough = (minIter <= iter);
+smpStopFn(const SMPStopParams & sp, tuple<unsigned int, unsigned int> * cycle) {
+    // For cycle detection: each state's positions, rounded to the grid, and
+    // the turns of the states whose rounded positions hash to each value.
+    // The λ-fn is called once per turn, so these only ever grow by one state.
+    auto qHist = std::make_shared<vector<vector<long long>>>();
+    auto qTurns = std::make_shared<std::unordered_map<uint64_t, vector<unsigned int>>>();
+    // length of the cycle the latest states are in, and how many turns in a row have matched it
+    auto cycRun = std::make_shared<tuple<unsigned int, unsigned int>>(0, 0);
+
+    auto qFn = [sp](const State * st) {
+        auto q = vector<long long>();
+        for (auto p : st->pstns) {
+            auto vp = ((const VctrPstn*)p);
+            for (unsigned int d = 0; d < vp->numR(); d++) {
+                q.push_back(std::llround((*vp)(d, 0) / sp.cycleGrid));
+            }
+        }
+        return q;
+    };
+    auto hFn = [](const vector<long long> & q) {
+        uint64_t h = 14695981039346656037ULL; // FNV-1a
+        for (auto x : q) {
+            h = (h ^ ((uint64_t)x)) * 1099511628211ULL;
+        }
+        return h;
+    };
+
+    auto  sfn = [sp, cycle, qHist, qTurns, cycRun, qFn, hFn](unsigned int iter, const State * s) {
+        bool tooLong = (sp.maxIter <= iter);
+        bool longEnough = (sp.minIter <= iter);
         bool quiet = false;
         auto sf = [](unsigned int i1, unsigned int i2, double d12) {
             LOG(INFO) << KBase::getFormattedString(
@@ -176,18 +207,69 @@ smpStopFn(unsigned int minIter, unsigned int maxIter, double minDeltaRatio, doub
         };
         auto s0 = ((const SMPState*)(s->model->history[0]));
         auto s1 = ((const SMPState*)(s->model->history[1]));
-        auto d01 = SMPModel::stateDist(s0, s1) + minSigDelta;
+        auto d01 = SMPModel::stateDist(s0, s1) + sp.minSigDelta;
         sf(0, 1, d01);
         auto sx = ((const SMPState*)(s->model->history[iter - 0]));
         auto sy = ((const SMPState*)(s->model->history[iter - 1]));
         auto dxy = SMPModel::stateDist(sx, sy);
         sf(iter - 1, iter - 0, dxy);
         const double aRatio = dxy / d01;
-        quiet = (aRatio < minDeltaRatio);
+        quiet = (aRatio < sp.minDeltaRatio);
         LOG(INFO) << KBase::getFormattedString(
           "Fractional change compared to first step: %.4f  (target=%.4f)",
-          aRatio, minDeltaRatio);
-        return tooLong || (longEnough && quiet);
+          aRatio, sp.minDeltaRatio);
+
+        bool cycled = false;
+        if (0.0 < sp.cycleGrid) {
+            auto smod = ((SMPModel*)(s->model));
+            while (qHist->size() <= iter) { // the initial state, then one per turn
+                const unsigned int t = qHist->size();
+                auto qt = qFn(s->model->history[t]);
+                auto & turns = (*qTurns)[hFn(qt)];
+                // the most recent earlier state with the same rounded positions, if any
+                int match = -1;
+                for (auto it = turns.rbegin(); it != turns.rend(); ++it) {
+                    if ((*qHist)[*it] == qt) {
+                        match = *it;
+                        break;
+                    }
+                }
+                turns.push_back(t);
+                qHist->push_back(qt);
+
+                unsigned int & cLen = get<0>(*cycRun);
+                unsigned int & cCount = get<1>(*cycRun);
+                if (0 > match) {
+                    cLen = 0;
+                    cCount = 0;
+                }
+                else if (t - match == cLen) {
+                    cCount++;
+                }
+                else {
+                    cLen = t - match;
+                    cCount = 1;
+                    if (nullptr == cycle) {
+                        smod->cycleStart = match;
+                        smod->cycleLen = cLen;
+                    }
+                    else {
+                        *cycle = tuple<unsigned int, unsigned int>(match, cLen);
+                    }
+                    LOG(INFO) << KBase::getFormattedString(
+                      "State %u repeats state %u: a cycle of length %u", t, match, cLen);
+                }
+            }
+            const unsigned int cLen = get<0>(*cycRun);
+            const unsigned int cCount = get<1>(*cycRun);
+            if ((0 < sp.cycleRepeats) && (0 < cLen) && (sp.cycleRepeats * cLen <= cCount)) {
+                cycled = true;
+                LOG(INFO) << KBase::getFormattedString(
+                  "Cycle of length %u from state %u has repeated %u times",
+                  cLen, (nullptr == cycle) ? smod->cycleStart : get<0>(*cycle), cCount / cLen);
+            }
+        }
+        return tooLong || (longEnough && (quiet || cycled));
     };
     return sfn;
 };
@@ -202,8 +284,13 @@ SMPActor::~SMPActor() {
 }
 
 double SMPActor::vote(unsigned int est, unsigned int i, unsigned int j, const State*st) const {
-    unsigned int k = st->model->actrNdx(this);
-    auto uk = st->aUtil[est];
+    // the ID is this actor's row of the utilities, as long as it is really the model's actor there
+    int ai = getID();
+    if ((0 > ai) || (((unsigned int)ai) >= st->model->numAct) || (st->model->actrs[ai] != this)) {
+      throw KException("SMPActor::vote: Actor not found in the actor list");
+    }
+    const unsigned int k = ((unsigned int)ai);
+    const KMatrix & uk = st->aUtil[est];
     double uhki = uk(k, i);
     double uhkj = uk(k, j);
     const double vij = Model::vote(vr, sCap, uhki, uhkj);
@@ -223,8 +310,8 @@ double SMPActor::posUtil(const Position * ap1, const SMPState* as) const {
     if (nullptr == as) {
       throw KException("SMPActor::posUtil: A null pointer passed for SMPState object");
     }
-    int ai = as->model->actrNdx(this);
-    if (0 > ai) {
+    int ai = getID();
+    if ((0 > ai) || (((unsigned int)ai) >= as->model->numAct) || (as->model->actrs[ai] != this)) {
       throw KException("SMPActor::posUtil: Actor not found in the actor list");
     }
     double ri = as->aNRA(ai); //as->nra(ai, 0);
@@ -323,9 +410,11 @@ void SMPActor::interpBrgnS2PMax(double tik, double sik, double prbI,
 }
 
 
-BargainSMP* SMPActor::interpolateBrgn(const SMPActor* ai, const SMPActor* aj,
-                                      const VctrPstn* posI, const VctrPstn * posJ,
-                                      double prbI, double prbJ, InterVecBrgn ivb) {
+BargainSMP SMPActor::interpolateBrgn(const SMPActor* ai, const SMPActor* aj,
+                                     const VctrPstn* posI, const VctrPstn * posJ,
+                                     double prbI, double prbJ, InterVecBrgn ivb, uint64_t id) {
+    static const unsigned int profSite = KBase::Profiler::site("interpolateBrgn");
+    KBase::ProfTimer profTimer(profSite);
     if ((1 != posI->numC()) || (1 != posJ->numC())) {
       throw KException("SMPActor::interpolateBrgn: position vectors posI and posJ must be column vectors");
     }
@@ -364,8 +453,7 @@ BargainSMP* SMPActor::interpolateBrgn(const SMPActor* ai, const SMPActor* aj,
         brgnJ(k, 0) = bjk;
     }
 
-    auto brgn = new BargainSMP(ai, aj, brgnI, brgnJ);
-    return brgn;
+    return BargainSMP(ai, aj, brgnI, brgnJ, id);
 }
 
 
@@ -380,7 +468,82 @@ SMPState::~SMPState() {
     accomodate = KMatrix();
 }
 
+void SMPState::setActorStore() {
+    const unsigned int na = model->numAct;
+    const unsigned int nd = ((const SMPModel*)model)->numDim;
+    if (na != pstns.size()) {
+      throw KException("SMPState::setActorStore: Positions for one or more actors missing");
+    }
+    if (na != ideals.size()) {
+      throw KException("SMPState::setActorStore: Ideals for one or more actors missing");
+    }
+    aStore.numAct = na;
+    aStore.numDim = nd;
+    aStore.caps = vector<double>(na, 0.0);
+    aStore.salSum = vector<double>(na, 0.0);
+    aStore.salSq = vector<double>(na, 0.0);
+    aStore.wts = vector<double>(na, 0.0);
+    aStore.sal = vector<double>(na * nd, 0.0);
+    aStore.pos = vector<double>(na * nd, 0.0);
+    aStore.ideal = vector<double>(na * nd, 0.0);
+    for (unsigned int i = 0; i < na; i++) {
+        auto ai = ((const SMPActor*)(model->actrs[i]));
+        auto pi = ((const VctrPstn*)(pstns[i]));
+        if ((nd != ai->vSal.numR()) || (nd != pi->numR()) || (nd != ideals[i].numR())) {
+          throw KException("SMPState::setActorStore: actor data does not match the number of dimensions");
+        }
+        // accumulate in the same order as KBase::sum and SMPModel::bvDiff,
+        // so results from the store match those from the KMatrix versions exactly
+        double sSum = 0.0;
+        double sSqr = 0.0;
+        for (unsigned int d = 0; d < nd; d++) {
+            const double sid = ai->vSal(d, 0);
+            if (0 > sid) {
+              throw KException("SMPState::setActorStore: saliences must be non-negative");
+            }
+            aStore.sal[i * nd + d] = sid;
+            aStore.pos[i * nd + d] = (*pi)(d, 0);
+            aStore.ideal[i * nd + d] = ideals[i](d, 0);
+            sSum = sSum + sid;
+            sSqr = sSqr + (sid * sid);
+        }
+        if (0 >= sSqr) {
+          throw KException("SMPState::setActorStore: sum of squared saliences must be positive");
+        }
+        aStore.caps[i] = ai->sCap;
+        aStore.salSum[i] = sSum;
+        aStore.salSq[i] = sSqr;
+        aStore.wts[i] = ai->sCap * sSum;
+    }
+    return;
+}
+
 void SMPState::setVDiff(const vector<VctrPstn> & vPos) {
+    const unsigned int na = model->numAct;
+    if ((0 == vPos.size()) && (na == aStore.numAct)) {
+        // weighted distances from ideals to positions, straight from the store
+        const unsigned int nd = aStore.numDim;
+        auto dfn = [this, nd](unsigned int i, unsigned int j) {
+            const double * idl = &(aStore.ideal[i * nd]);
+            const double * sal = &(aStore.sal[i * nd]);
+            const double * pj = &(aStore.pos[j * nd]);
+            double dsSqr = 0.0;
+            for (unsigned int d = 0; d < nd; d++) {
+                const double ds = (idl[d] - pj[d]) * sal[d];
+                dsSqr = dsSqr + (ds * ds);
+            }
+            return sqrt(dsSqr / aStore.salSq[i]);
+        };
+        if (na != accomodate.numR()) {
+          throw KException("SMPState::setVDiff: Accomodate matrix rows count should be equal to number of actors");
+        }
+        if (na != accomodate.numC()) {
+          throw KException("SMPState::setVDiff: Accomodate matrix column count should be equal to number of actors");
+        }
+        vDiff = KMatrix::map(dfn, na, na);
+        return;
+    }
+
     auto dfn = [vPos, this](unsigned int i, unsigned int j) {
         auto ai = ((const SMPActor*)(model->actrs[i]));
         KMatrix si = ai->vSal;
@@ -399,7 +562,6 @@ void SMPState::setVDiff(const vector<VctrPstn> & vPos) {
         return dij;
     };
 
-    const unsigned int na = model->numAct;
     if (na != ideals.size()) {
       throw KException("SMPState::setVDiff: Ideals for one or more actors missing");
     }
@@ -422,6 +584,12 @@ double SMPState::estNRA(unsigned int h, unsigned int i, BigRAdjust ra) const {
 }
 
 KMatrix SMPState::actrCaps() const {
+    if (model->numAct == aStore.numAct) {
+        auto sFn = [this](unsigned int i, unsigned int j) {
+            return aStore.caps[j];
+        };
+        return KMatrix::map(sFn, 1, aStore.numAct);
+    }
     auto wFn = [this](unsigned int i, unsigned int j) {
         auto aj = ((SMPActor*)(model->actrs[j]));
         return aj->sCap;
@@ -433,6 +601,8 @@ KMatrix SMPState::actrCaps() const {
 
 
 void SMPState::setAllAUtil(ReportingLevel rl) {
+    static const unsigned int profSite = KBase::Profiler::site("setAllAUtil");
+    KBase::ProfTimer profTimer(profSite);
     const auto vpmCoalition = model->vpm;
     const unsigned int na = model->numAct;
     auto smod = (const SMPModel*)model;
@@ -451,6 +621,7 @@ void SMPState::setAllAUtil(ReportingLevel rl) {
       throw KException("SMPState::setAllAUtil: size of uIndices can't exceed the count of actors");
     }
 
+    setActorStore();
     auto w_j = actrCaps();
     setVDiff();
     nra = KMatrix(na, 1); // zero-filled, i.e. risk neutral
@@ -553,24 +724,20 @@ void SMPState::setOneAUtil(unsigned int perspH, ReportingLevel rl) {
     return;
 }
 
-void SMPState::showBargains(const vector < vector < BargainSMP* > > & brgns) const {
+void SMPState::showBargains() const {
     string msg = "Bargains involving actor %2u: ";
     string brgnFormat = "[%llu, %u:%u]"; // [bargainID, initAct:recvAct]
     string actorBargains;
 
-    auto printOneBargain = [this, &brgns, &actorBargains, &brgnFormat](unsigned int i, unsigned int j) {
-      BargainSMP* bij = brgns[i][j];
-      if (nullptr == bij) {
-        throw KException("SMPState::showBargains: bargain object is null");
-      }
-
+    auto printOneBargain = [this, &actorBargains, &brgnFormat](unsigned int i, unsigned int j) {
+      const BargainSMP & bij = brgnAt(i, j);
       actorBargains += 
         KBase::getFormattedString
         (
           brgnFormat.c_str(),
-          bij->getID(),
-          model->actrNdx(bij->actInit),
-          model->actrNdx(bij->actRcvr)
+          bij.getID(),
+          bij.initNdx,
+          bij.rcvrNdx
         );
     };
 
@@ -589,8 +756,8 @@ string SMPState::showOneBargain(const BargainSMP* b) const {
     if (nullptr == b) {
       throw KException("SMPState::showOneBargain: bargain object is null");
     }
-    unsigned int ai = model->actrNdx(b->actInit);
-    unsigned int aj = model->actrNdx(b->actRcvr);
+    unsigned int ai = b->initNdx;
+    unsigned int aj = b->rcvrNdx;
     uint64_t bid = b->getID();
     string bargain = KBase::getFormattedString("[%llu, %u:%u]", bid, ai, aj);
     return bargain;
@@ -629,8 +796,30 @@ void  SMPState::setAccomodate(const KMatrix & aMat) {
     if (na != aMat.numC()) {
       throw KException("SMPState::setAccomodate: Actor matrix's columns don't match to actual count of actors");
     }
+    const double tol = 1E-10;
+    auto lag = vector<double>(na, 0.0);
+    for (unsigned int i = 0; i < na; i++) {
+        double si = 0.0;
+        for (unsigned int j = 0; j < na; j++) {
+            const double aij = aMat(i, j); // save typing
+            if (0 > aij) {
+              throw KException("SMPState::setAccomodate: Value of aij must be non-negative");
+            }
+            if (aij > 1.0) {
+              throw KException("SMPState::setAccomodate: Value of aij must not exceed 1.0");
+            }
+            si = si + aij;
+        }
+        if (si > 1.0 + tol) { // cannot be more than slightly above
+          throw KException("SMPState::setAccomodate: row sum is not within expected limit of 1.0");
+        }
+        si = (1.0 < si) ? 1.0 : si; // clip to 1, if slightly above
+        lag[i] = 1.0 - si;
+    }
     accomodate = aMat;
     identAccMat = KBase::iMatP(accomodate);
+    accSprs = KBase::SMatrix::fromDense(accomodate);
+    accLag = lag;
     return;
 }
 
@@ -668,20 +857,25 @@ bool SMPState::equivNdx(unsigned int i, unsigned int j) const {
     return rslt;
 }
 
+tuple<VUI, VUI> SMPState::ueNdx() const {
+    // Same equivalence as equivNdx, but grid-hashed rather than compared pairwise
+    vector<KMatrix> ps = {};
+    for (auto p : pstns) {
+        auto vp = ((const VctrPstn *)p);
+        if (vp == nullptr) {
+          throw KException("SMPState::ueNdx: vp is a null pointer");
+        }
+        ps.push_back(*vp);
+    }
+    auto sm = ((const SMPModel*)model);
+    return KBase::ueIndicesTol(ps, sm->posTol);
+}
+
 
 // set the diff matrix, do probCE for risk neutral,
 // estimate Ri, and set all the aUtil[h] matrices
 SMPState* SMPState::stepBCN() {
-    auto gSetup = [](SMPState* s) {
-        if ((0 == s->uIndices.size()) || (0 == s->eIndices.size())) {
-            s->setUENdx();
-        }
-        if (0 == s->aUtil.size()) {
-            s->setAUtil(-1, ReportingLevel::Low);
-        }
-        return;
-    };
-    gSetup(this);
+    setupStep();
 
     // JAH 20160802 toggle population of PosUtil, PosEquiv, PosVote, and PosBrob
     // en masse based on value at index 1 of the sqlFlags vector
@@ -695,16 +889,25 @@ SMPState* SMPState::stepBCN() {
     // That gets recorded upon the next state - but it
     // therefore misses the very last state.
     auto s2 = doBCN();
-    gSetup(s2);
+    s2->setupStep();
     s2->step = [s2]() {
         return s2->stepBCN();
     };
     return s2;
 }
 
+void SMPState::setupStep() {
+    if ((0 == uIndices.size()) || (0 == eIndices.size())) {
+        setUENdx();
+    }
+    if (0 == aUtil.size()) {
+        setAUtil(-1, ReportingLevel::Low);
+    }
+    return;
+}
+
 void SMPState::newIdeals() {
     const unsigned int na = model->numAct;
-    const double tol = 1E-10;
 
     if (Model::minNumActor > na) {
       throw KException("SMPState::newIdeals: Model needs to have a minimum number of actors");
@@ -712,90 +915,48 @@ void SMPState::newIdeals() {
     if (na > Model::maxNumActor) {
       throw KException("SMPState::newIdeals: Model has got an upper limit to count of actors");
     }
-    if (na != accomodate.numC()) {
-      throw KException("SMPState::newIdeals: accomodate matrix's columns don't match to actual count of actors");
-    }
-    if (na != accomodate.numR()) {
-      throw KException("SMPState::newIdeals: accomodate matrix's rows don't match to actual count of actors");
+    if ((na != accSprs.numR()) || (na != accSprs.numC()) || (na != accLag.size())) {
+      throw KException("SMPState::newIdeals: accomodate matrix doesn't match the actual count of actors");
     }
     if (na != ((unsigned int)(ideals.size()))) {
       throw KException("SMPState::newIdeals: ideals size don't match to actual count of actors");
     }
-
-    const bool identP = (KBase::norm(accomodate - KBase::iMat(na)) < tol);
-
-    const unsigned int nDim = ((SMPModel*)model)->numDim;
+    if (na != pstns.size()) {
+      throw KException("SMPState::newIdeals: positions size don't match to actual count of actors");
+    }
 
     vector<VctrPstn> nIdeals = {};
 
-    auto posK = [this](unsigned int k) {
-        auto ppK = ((const VctrPstn*)(pstns[k]));
-        const KMatrix pK = KMatrix(*ppK);
-        return pK;
-    };
+    if (identAccMat) {
+        // the original "cynical" model: ideals simply track positions
+        for (unsigned int i = 0; i < na; i++) {
+            nIdeals.push_back(VctrPstn(*((const VctrPstn*)(pstns[i]))));
+        }
+        ideals = nIdeals;
+        return;
+    }
 
+    // new ideals are A*Pos + diag(lag)*Ideal, with one row per actor
+    const unsigned int nDim = ((SMPModel*)model)->numDim;
+    auto posM = KMatrix(na, nDim);
     for (unsigned int i = 0; i < na; i++) {
-        double si = 0.0;
-        auto pI = posK(i);
-        auto newIP = KMatrix(nDim, 1); // new ideal point
-        for (unsigned int j = 0; j < na; j++) {
-            const double aij = accomodate(i, j); // save typing
-            if (0 > aij) {
-              throw KException("SMPState::newIdeals: Value of aij must be non-negative");
-            }
-            if (aij > 1.0) {
-              throw KException("SMPState::newIdeals: Value of aij must not exceed 1.0");
-            }
-            si = si + aij;
-            if (si > 1.0 + tol) { // cannot be more than slightly above at any point
-              throw KException("SMPState::newIdeals: si is not within expected limit of 1.0");
-            }
-            auto pJ = posK(j);
-            newIP = newIP + (aij * pJ);
-
-            // very temporary!!
-            if (identP && (i == j)) {
-                if (fabs(aij - 1.0) >= tol) {
-                  LOG(INFO) << "value of aij: " << aij;
-                  throw KException("SMPState::newIdeals: aij is not within expected limit");
-                }
-            }
-        }
-        si = (1.0 < si) ? 1.0 : si; // clip to 1, if slightly above
-        double lagI = 1.0 - si;
-        if (0.0 > lagI) {
-          throw KException("SMPState::newIdeals: Value of lagI must be non-negative");
-        }
-        if (lagI > 1.0) {
-          throw KException("SMPState::newIdeals: Value of lagI must not exceed 1.0");
-        }
-        if (identP) {
-            if (fabs(lagI) >= tol) {
-              LOG(INFO) << "value of lagI: " << lagI;
-              throw KException("SMPState::newIdeals: lagI is not within acceptable limit");
-            }
-        }
-        newIP = newIP + (lagI * ideals[i]);
-        if (identP) {
-            auto normP = KBase::norm(newIP - pI);
-            if (normP >= tol) {
-              LOG(INFO) << "Change in old and new positions= " << normP;
-              throw KException("SMPState::newIdeals: Difference in old and new positions not within acceptable limit");
-            }
+        auto ppI = ((const VctrPstn*)(pstns[i]));
+        for (unsigned int d = 0; d < nDim; d++) {
+            posM(i, d) = (*ppI)(d, 0);
         }
-        nIdeals.push_back(VctrPstn(newIP));
     }
+    const KMatrix aPos = accSprs * posM;
 
-    ideals = nIdeals;
-
-    if (identP) {
-        auto posIdDist = posIdealDist();
-        if (posIdDist >= tol) {
-          LOG(INFO) << "position dist of ideals=" << posIdDist;
-          throw KException("SMPState::newIdeals: position distribution of ideals not within acceptable limit");
+    for (unsigned int i = 0; i < na; i++) {
+        const double lagI = accLag[i];
+        auto newIP = VctrPstn(nDim, 1); // new ideal point
+        for (unsigned int d = 0; d < nDim; d++) {
+            newIP(d, 0) = aPos(i, d) + (lagI * ideals[i](d, 0));
         }
+        nIdeals.push_back(newIP);
     }
 
+    ideals = nIdeals;
     return;
 }
 
@@ -891,6 +1052,8 @@ void SMPState::setAccomodate(double adjRate) {
 }
 
 tuple< KMatrix, VUI> SMPState::pDist(int persp) const {
+    static const unsigned int profSite = KBase::Profiler::site("pDist");
+    KBase::ProfTimer profTimer(profSite);
     /// Calculate the probability distribution over states from this perspective
 
     // TODO: convert this to a single, commonly used setup function
@@ -950,12 +1113,15 @@ KMatrix SMPState::getAccomodate() {
 
 // -------------------------------------------------
 
+string SMPModel::eventFile = "";
+
 // JAH 20160711 added rng seed
 SMPModel::SMPModel(string desc, uint64_t s, vector<bool> f, string sceName) : Model(desc, s, f, sceName) {
     // note that numDim, posTol, and dimName are initialized in class declaration
 }
 
 SMPModel::~SMPModel() {
+    waitSnapshot();
 }
 
 void SMPModel::releaseDB() {
@@ -1031,261 +1197,6 @@ double SMPModel::bvUtil(const  KMatrix & vd, const  KMatrix & vs, double R) {
     return u;
 };
 
-void SMPModel::sankeyOutput(string outputFile) const {
-    if (numAct != actrs.size()) {
-      throw KException("SMPModel::sankeyOutput: actor count is in error");
-    }
-    if (numDim == dimName.size()) {
-      throw KException("SMPModel::sankeyOutput: dimension count is in error");
-    }
-
-    // first prepare the header line
-    char* headLine = newChars(300);
-    sprintf(headLine,"PRNG Seed:%20llu;VictoryProbModel:%s;VotingRule:%s;PCEModel:%s;StateTransitions:%s;BigRRange:%s;BigRAdjust:%s;ThirdPartyCommit:%s;InterVecBrgn:%s;BargnModel:%s",
-            getSeed(),KBase::nameFromEnum<VPModel>(vpm,KBase::VPModelNames).c_str(),
-            KBase::nameFromEnum<VotingRule>(vrCltn,KBase::VotingRuleNames).c_str(),
-            KBase::nameFromEnum<PCEModel>(pcem,KBase::PCEModelNames).c_str(),
-            KBase::nameFromEnum<StateTransMode>(stm,KBase::StateTransModeNames).c_str(),
-            KBase::nameFromEnum<BigRRange>(bigRRng,KBase::BigRRangeNames).c_str(),
-            KBase::nameFromEnum<BigRAdjust>(bigRAdj,KBase::BigRAdjustNames).c_str(),
-            KBase::nameFromEnum<ThirdPartyCommit>(tpCommit,KBase::ThirdPartyCommitNames).c_str(),
-            KBase::nameFromEnum<InterVecBrgn>(ivBrgn,InterVecBrgnNames).c_str(),
-            KBase::nameFromEnum<SMPBargnModel>(brgnMod,SMPBargnModelNames).c_str());
-
-    unsigned int nameLen = outputFile.length();
-    const char* appendEffPwr = "_effPow.csv";
-    char* epName = newChars(nameLen + strlen(appendEffPwr) + 1);
-    sprintf(epName, "%s%s", outputFile.c_str(), appendEffPwr);
-    LOG(INFO) << "Record effective power in" << epName << "...";
-    FILE* f1 = fopen(epName, "w");
-    fprintf(f1,"%s\n",headLine);
-    for (unsigned int i = 0; i < numAct; i++) {
-        auto ai = ((const SMPActor*)actrs[i]);
-        double ci = ai->sCap;
-        if (0.0 >= ci) {
-          throw KException("SMPModel::sankeyOutput: ci must be non-negative");
-        }
-        fprintf(f1, "%s", ai->name.c_str());
-        // loop through dimensions now
-        for (unsigned int k = 0; k < numDim; k++) {
-            double si = (ai->vSal)(k, 0);
-            if (0.0 >= si) {
-              throw KException("SMPModel::sankeyOutput: si must be non-negative");
-            }
-            if (si > 1.0) {
-              throw KException("SMPModel::sankeyOutput: si must not be more than 1.0");
-            }
-            double epi = ci * si;
-            // increased precision since we divided by 100 when the saliences were import
-            fprintf(f1, ",%5.2f", epi);
-        }
-        fprintf(f1, "\n");
-    }
-    fclose(f1);
-    f1 = nullptr;
-    LOG(INFO) << "done";
-    delete epName;
-    epName = nullptr;
-
-    const char* appendPosLog = "_posLog.csv";
-    char* plName = newChars(nameLen + strlen(appendPosLog) + 1);
-    sprintf(plName, "%s%s", outputFile.c_str(), appendPosLog);
-    LOG(INFO) << "Record 1D positions over time, without dimension-name in" << plName << "...";
-    FILE* f2 = fopen(plName, "w");
-    fprintf(f2,"%s\n",headLine);
-    for (unsigned int i = 0; i < numAct; i++) {
-        fprintf(f2, "%s", actrs[i]->name.c_str());
-        for (unsigned int k = 0; k<numDim; k++) {
-            for (unsigned int t = 0; t < history.size(); t++) {
-                auto st = history[t];
-                auto pit = st->pstns[i];
-                auto vpit = (const VctrPstn*)pit;
-                if (numDim != vpit->numR()) {
-                  throw KException("SMPModel::sankeyOutput: number of rows in vpit should be equal to the count of dimensions");
-                }
-                fprintf(f2, ",%5.2f", 100 * (*vpit)(k, 0)); // have to print "100.0" sometimes
-            }
-        }
-        fprintf(f2, "\n");
-    }
-    fclose(f2);
-    f2 = nullptr;
-    LOG(INFO) << "done";
-    delete plName;
-    plName = nullptr;
-    delete headLine;
-    headLine = nullptr;
-
-    return;
-}
-
-void SMPModel::sankeyOutput(string outputFile, string dbName, string scenarioId)
-{
-    QSqlDatabase qdb = QSqlDatabase::addDatabase(dbDriver, QString("sankey"));
-    qdb.setDatabaseName(QString::fromStdString(dbName));
-    if (0 == dbDriver.compare("QPSQL")) {
-      qdb.setHostName(server);
-      qdb.setPort(port);
-
-      if(!qdb.open(userName, password)) {
-        LOG(INFO) << "Could not connect with postgres DB.";
-        LOG(INFO) << qdb.lastError().text().toStdString();
-        throw KException("SMPModel::sankeyOutput: Postgres DB connection failed");
-      }
-    }
-    else if (0 == dbDriver.compare("QSQLITE")) {
-      if (!qdb.open()) {
-        LOG(INFO) << "Could not connect with sqlite DB.";
-        LOG(INFO) << qdb.lastError().text().toStdString();
-        throw KException("SMPModel::sankeyOutput: SQLite DB connection failed");
-      }
-    }
-    else {
-      LOG(INFO) << "Invalid DB driver name";
-      throw KException("SMPModel::sankeyOutput: Invalid DB driver name");
-    }
-
-    QSqlQuery qtQry = QSqlQuery(qdb);
-
-    auto getScenarioData = [](string scenarioID) {
-        string query = string("SELECT * from ScenarioDesc WHERE ") +
-                " ScenarioId = \'" + scenarioID + "\'";
-        return query;
-    };
-
-    auto getSpatialCapabilityData = [](string scenarioID) {
-        string query = string("SELECT Cap from SpatialCapability WHERE ") +
-                " ScenarioId = \'" + scenarioID + "\'";
-        return query;
-    };
-
-    map <size_t, string> actorList;
-    auto getActor = [](string scenarioID) {
-      string query = "SELECT Act_i, Name FROM ActorDescription WHERE ScenarioId = \'" + scenarioID + "\'";
-      return query;
-    };
-
-    if (qtQry.exec(getActor(scenarioId).c_str())) {
-      while (qtQry.next()) {
-        actorList[qtQry.value(0).toUInt()] = qtQry.value(1).toString().toStdString();
-      }
-    }
-
-    string getDimCount = "SELECT COUNT(0) from DimensionDescription WHERE ScenarioId = '" + scenarioId + "'";
-    int numDims;
-    if (qtQry.exec(getDimCount.c_str())) {
-      if (qtQry.first()) {
-        numDims = qtQry.value(0).toInt();
-      }
-    }
-
-    auto getSalience = string("SELECT SpatialSalience.Sal from SpatialSalience, ActorDescription WHERE ") +
-        " ActorDescription.Act_i = SpatialSalience.Act_i " +
-        " and SpatialSalience.ScenarioId = \'" + scenarioId + "\'" +
-        " and ActorDescription.ScenarioId = \'" + scenarioId + "\'" +
-        " and SpatialSalience.Turn_t = 0" +
-        " and SpatialSalience.dim_k = :dim_k";
-
-    vector<vector<double>> salienceData;
-    qtQry.prepare(getSalience.c_str());
-    for (int dims = 0; dims < numDims; ++dims)
-    {
-      vector<double> salienceDataPerDim;
-      qtQry.bindValue(":dim_k", dims);
-      if (qtQry.exec()) {
-        while (qtQry.next()) {
-          salienceDataPerDim.push_back(qtQry.value(0).toDouble());
-        }
-        salienceData.push_back(salienceDataPerDim);
-      }
-    }
-
-    vector<string > scenarioData; // 3D
-    if (qtQry.exec(getScenarioData(scenarioId).c_str())) {
-      QSqlRecord rec = qtQry.record();
-      int colCount = rec.count();
-      while (qtQry.next()) {
-        int colIndex = 0;
-        while (colIndex < colCount) {
-          scenarioData.push_back(qtQry.value(colIndex).toString().toStdString());
-          ++colIndex;
-        }
-      }
-    }
-
-    vector<double> capabilityData; // 3D
-    if (qtQry.exec(getSpatialCapabilityData(scenarioId).c_str())) {
-      while (qtQry.next()) {
-        capabilityData.push_back(qtQry.value(0).toDouble());
-      }
-    }
-
-    // first prepare the header line
-    char* headLine = newChars(300);
-    sprintf(headLine,
-            "PRNG Seed:%s;VictoryProbModel:%s;VotingRule:%s;PCEModel:%s;StateTransitions:%s;BigRRange:%s;BigRAdjust:%s;ThirdPartyCommit:%s;InterVecBrgn:%s;BargnModel:%s",
-            scenarioData.at(3).c_str(),
-            KBase::VPModelNames[std::stoi(scenarioData.at(4))].c_str(),
-            KBase::VotingRuleNames[std::stoi(scenarioData.at(7))].c_str(),
-            KBase::PCEModelNames[std::stoi(scenarioData.at(5))].c_str(),
-            KBase::StateTransModeNames[std::stoi(scenarioData.at(6))].c_str(),
-            KBase::BigRRangeNames[std::stoi(scenarioData.at(9))].c_str(),
-            KBase::BigRAdjustNames[std::stoi(scenarioData.at(8))].c_str(),
-            KBase::ThirdPartyCommitNames[std::stoi(scenarioData.at(10))].c_str(),
-            InterVecBrgnNames[std::stoi(scenarioData.at(11))].c_str(),
-            SMPBargnModelNames[std::stoi(scenarioData.at(12))].c_str());
-
-
-    string effPowDump = outputFile + "_effPow.csv";
-    FILE* f1 = fopen(effPowDump.c_str(), "w");
-    fprintf(f1, "%s\n", headLine);
-
-    LOG(INFO) << "Record effective power in " << effPowDump << "  ...  ";
-    for (auto actor : actorList) {
-      fprintf(f1, "%s", actor.second.c_str());
-      for (size_t dim = 0; dim < numDims; ++dim) {
-        // increased precision since we divided by 100 when the saliences were imported
-        fprintf(f1, ",%5.2f", salienceData[dim].at(actor.first) * capabilityData.at(actor.first));
-      }
-      fprintf(f1, "\n");
-    }
-
-    fclose(f1);
-    f1 = nullptr;
-
-    string posVectDump = outputFile + "_posLog.csv";
-    FILE* f2 = fopen(posVectDump.c_str(), "w");
-    fprintf(f2, "%s\n", headLine);
-
-    string getPosCoord = string("SELECT Pos_Coord from VectorPosition WHERE ") +
-      " Act_i = :act_i and  ScenarioId = '" + scenarioId + "'";
-
-    qtQry.prepare(getPosCoord.c_str());
-
-    LOG(INFO) << "Record 1D positions over time, without dimension-name in " << posVectDump << "  ...  ";
-    for (auto actor : actorList) {
-      fprintf(f2, "%s", actor.second.c_str());
-
-      qtQry.bindValue(":act_i", (uint)actor.first);
-      if (qtQry.exec()) {
-        while (qtQry.next()) {
-          fprintf(f2, ",%5.2f", qtQry.value(0).toDouble());
-        }
-      }
-      fprintf(f2, "\n");
-    }
-
-    fclose(f2);
-    f2 = nullptr;
-
-    qtQry.finish();
-    qtQry.clear();
-    qdb.close();
-    qdb = QSqlDatabase();
-    QSqlDatabase::removeDatabase(QString("sankey"));
-    return;
-}
-
 // JAH 20160801 changed to refer to model sqlFlags vector to decide
 // whether or not to populate the table
 void SMPModel::showVPHistory() const {
@@ -1335,6 +1246,14 @@ void SMPModel::showVPHistory() const {
         LOG(INFO) << "History of actor positions over time:";
         string actorPosHistory;
 
+        // the same coordinates, packed turn-major for the PositionCube table
+        const unsigned int numT = history.size();
+        auto cubeNdx = [this](unsigned int t, unsigned int i, unsigned int k) {
+            return (t * numAct + i) * numDim + k;
+        };
+        vector<double> posCube(numT * numAct * numDim, 0.0);
+        vector<double> idlCube(numT * numAct * numDim, 0.0);
+
         // show positions over time
         for (unsigned int i = 0; i < numAct; i++) {
             for (unsigned int k = 0; k < numDim; k++) {
@@ -1360,6 +1279,8 @@ void SMPModel::showVPHistory() const {
                     query.bindValue(":pos_coord", pCoord);
                     const double iCoord = vidl(k, 0) * 100.0; // Log at the scale of [0,100];
                     query.bindValue(":idl_coord", iCoord);
+                    posCube[cubeNdx(t, i, k)] = pCoord;
+                    idlCube[cubeNdx(t, i, k)] = iCoord;
 
                     // This try block is necessary to make sure there is a bargin which caused the move
                     try {
@@ -1379,6 +1300,24 @@ void SMPModel::showVPHistory() const {
             }
         }
 
+        auto cubeBytes = [](const vector<double> & cube) {
+            return QByteArray(reinterpret_cast<const char*>(cube.data()),
+                              static_cast<int>(cube.size() * sizeof(double)));
+        };
+        string sqlCube = "INSERT INTO PositionCube "
+          "(ScenarioId, NumTurns, NumActors, NumDims, Pos_Cube, Idl_Cube)"
+          "VALUES ('" + scenId + "', :num_t, :num_a, :num_d, :pos_cube, :idl_cube)";
+        query.prepare(QString::fromStdString(sqlCube));
+        query.bindValue(":num_t", numT);
+        query.bindValue(":num_a", numAct);
+        query.bindValue(":num_d", numDim);
+        query.bindValue(":pos_cube", cubeBytes(posCube));
+        query.bindValue(":idl_cube", cubeBytes(idlCube));
+        if (!query.exec()) {
+          LOG(INFO) << query.lastError().text().toStdString();
+          throw KException("SMPModel::showVPHistory: Could not write into PositionCube table");
+        }
+
         qtDB->commit();
     }
 
@@ -1428,13 +1367,16 @@ SMPModel * SMPModel::initModel(vector<string> aName, vector<string> aDesc, vecto
                                const KMatrix & pos, // one row per actor, one column per dimension
                                const KMatrix & sal, // one row per actor, one column per dimension
                                const KMatrix & accM,
-                               uint64_t s, vector<bool> f, string scenDesc, string scenName)
+                               uint64_t s, vector<bool> f, string scenDesc, string scenName,
+                               bool sqlP)
 {    
     if (f.size() != Model::NumSQLLogGrps + NumSQLLogGrps) {
       throw KException("SMPModel::initModel Right number of logging flags not provided.");
     }
     SMPModel * sm0 = new SMPModel(scenDesc, s, f, scenName); // JAH 20160711 added rng seed 20160730 JAH added sql flags
-    sm0->sqlTest();
+    if (sqlP) {
+        sm0->sqlTest();
+    }
     SMPState * st0 = new SMPState(sm0);
 
     sm0->addState(st0);
@@ -1485,13 +1427,14 @@ void SMPModel::displayModelParams(SMPModel *md0)
 }
 
 string SMPModel::runModel(vector<bool> sqlFlags,
-                          string inputDataFile, uint64_t seed, bool saveHist, vector<int> modelParams) {
+                          string inputDataFile, uint64_t seed, bool saveHist, vector<int> modelParams,
+                          SMPStopParams stopPrms, unsigned int ensembleSize, unsigned int snapEvery) {
     if (md0 != nullptr) {
         delete md0;
         md0 = nullptr;
     }
 
-    // Supported files for input data: xml, csv
+    // Supported files for input data: xml, csv, and snapshots of earlier runs
     size_t dotPos = inputDataFile.find_last_of(".");
     if (string::npos == dotPos) { // A file name without extension
       lastExceptionMsg = "Error: Input file name without extension is invalid.";
@@ -1505,9 +1448,9 @@ string SMPModel::runModel(vector<bool> sqlFlags,
     // convert to all lower case for easy comparison
     std::transform(fileExt.begin(), fileExt.end(), fileExt.begin(), ::tolower);
 
-    // Make sure the file extension is either csv or xml only
-    if((0 != fileExt.compare("csv")) && (0 != fileExt.compare("xml"))) {
-      lastExceptionMsg = "Error: Only xml or csv files supported.";
+    // Make sure the file extension is csv, xml or snap only
+    if((0 != fileExt.compare("csv")) && (0 != fileExt.compare("xml")) && (0 != fileExt.compare("snap"))) {
+      lastExceptionMsg = "Error: Only xml, csv or snap files supported.";
       LOG(INFO) << lastExceptionMsg;
       return "";
     }
@@ -1575,10 +1518,34 @@ string SMPModel::runModel(vector<bool> sqlFlags,
       }
         //md0 = csvRead(inputDataFile, seed, sqlFlags);
     }
+    else if (fileExt == "snap") {
+      try {
+        md0 = readSnapshot(inputDataFile, sqlFlags);
+      }
+      catch (KException &ke) {
+        lastExceptionMsg = ke.msg;
+        return "";
+      }
+      catch (std::exception &std_ex) {
+        lastExceptionMsg = std_ex.what();
+        return "";
+      }
+      catch (...) {
+        lastExceptionMsg = "SMPModel::runModel: Unknown Exception Caught from readSnapshot";
+        return "";
+      }
+      LOG(INFO) << KBase::getFormattedString(
+        "Resuming from turn %u, using PRNG state from the snapshot", md0->history.size() - 1);
+    }
 
     if (!modelParams.empty()) {
         SMPModel::updateModelParameters(md0, modelParams);
     }
+    md0->stopParams = stopPrms;
+    md0->ensembleSize = ensembleSize;
+    md0->snapEvery = snapEvery;
+    // a resumed run must not overwrite the snapshot it started from
+    md0->snapFile = fileName + ((fileExt == "snap") ? "_resumed.snap" : ".snap");
 
     displayModelParams(md0);
 
@@ -1589,6 +1556,23 @@ string SMPModel::runModel(vector<bool> sqlFlags,
       md0 = nullptr;
     };
 
+    if (SMPPreflightMode::Off != preflightMode) {
+        const SMPPreflight pf = md0->preflight();
+        showPreflight(pf);
+        if (0 < pf.errors.size()) {
+            lastExceptionMsg = KBase::getFormattedString(
+              "SMPModel::runModel: pre-flight check found %u problems, the first being ",
+              (unsigned int)(pf.errors.size())) + pf.errors[0];
+            cleanup();
+            return "";
+        }
+        if (SMPPreflightMode::DryRun == preflightMode) {
+            md0->releaseDB();
+            return md0->getScenarioID();
+        }
+        md0->prevalidated = true;
+    }
+
     try {
       configExec(md0);
 
@@ -1653,28 +1637,43 @@ string SMPModel::xmlReadExec(string inputXML, vector<bool> f) {
 
 void SMPModel::configExec(SMPModel * md0)
 {
-    // setup the stopping criteria and lambda function
-    const unsigned int minIter = 2;
-    const unsigned int maxIter = 100;
-    const double minDeltaRatio = 0.02;
-    // suppose that, on a [0,100] scale, the first move was the most extreme possible,
-    // i.e. 100 points. One fiftieth of that is just 2, which seems to about the limit
-    // of what people consider significant.
-    const double minSigDelta = 1E-4;
-    // typical first shifts are on the order of numAct/10, so this is low
+    // setup the stopping criteria and lambda function.
+    // The defaults in SMPStopParams are minIter = 2, maxIter = 100, and
+    // minDeltaRatio = 0.02: suppose that, on a [0,100] scale, the first move was
+    // the most extreme possible, i.e. 100 points. One fiftieth of that is just 2,
+    // which seems to about the limit of what people consider significant.
+    // minSigDelta = 1E-4: typical first shifts are on the order of numAct/10, so this is low
     // enough not to affect anything while guarding against the theoretical
     // possiblity of 0/0 errors
     //md0->stop = [maxIter](unsigned int iter, const State * s) {
     //    return (maxIter <= iter);
     //};
-    md0->stop = smpStopFn(minIter, maxIter, minDeltaRatio, minSigDelta);
+    md0->cycleStart = 0;
+    md0->cycleLen = 0;
+    md0->stop = smpStopFn(md0->stopParams);
+    if ((0 < md0->snapEvery) && (0 == md0->ensembleSize)) {
+        auto sfn = md0->stop;
+        md0->stop = [md0, sfn](unsigned int iter, const State * s) {
+            const bool done = sfn(iter, s);
+            if (done || (0 == iter % md0->snapEvery)) {
+                md0->saveSnapshot(md0->snapFile);
+            }
+            return done;
+        };
+    }
 
     // Drop the indices of the tables before the model run
     md0->dropTableIndices();
 
     // execute
     LOG(INFO) << "Starting model run";
-    md0->run();
+    if (0 < md0->ensembleSize) {
+        runEnsemble(md0);
+    }
+    else {
+        md0->run();
+    }
+    md0->waitSnapshot();
     const unsigned int nState = md0->history.size();
 
     // log data, or not
@@ -1745,217 +1744,228 @@ vector<int> SMPModel::getDefaultModelParameters()
 }
 
 double SMPModel::getQuadMapPoint(size_t t, size_t est_h, size_t aff_k, size_t init_i, size_t rcvr_j) {
-    auto smpState = md0->history[t];
-    auto autil = smpState->aUtil;
-    double uii = autil[est_h](init_i, init_i);
-    double uij = autil[est_h](init_i, rcvr_j);
-    double uji = autil[est_h](rcvr_j, init_i);
-    double ujj = autil[est_h](rcvr_j, rcvr_j);
-
-    // h's estimate of utility to k of status-quo positions of i and j
-    const double euSQ = autil[est_h](aff_k, init_i) + autil[est_h](aff_k, rcvr_j);
-    if ((0.0 > euSQ) || (euSQ > 2.0)) {
-      throw KException("SMPModel::getQuadMapPoint: euSQ should be between 0.0 and 2.0");
-    }
-
-    // h's estimate of utility to k of i defeating j, so j adopts i's position
-    const double uhkij = autil[est_h](aff_k, init_i) + autil[est_h](aff_k, init_i);
-    if ((0.0 > uhkij) || (uhkij > 2.0)) {
-      throw KException("SMPModel::getQuadMapPoint: uhkij should be between 0.0 and 2.0");
-    }
-
-    // h's estimate of utility to k of j defeating i, so i adopts j's position
-    const double uhkji = autil[est_h](aff_k, rcvr_j) + autil[est_h](aff_k, rcvr_j);
-    if ((0.0 > uhkji) || (uhkji > 2.0)) {
-      throw KException("SMPModel::getQuadMapPoint: uhkji should be between 0.0 and 2.0");
-    }
-
-    auto ai = ((const SMPActor*)(md0->actrs[init_i]));
-    double si = KBase::sum(ai->vSal);
-    if ((0 >= si) || (si > 1)) {
-      throw KException("SMPModel::getQuadMapPoint: si should be between 0 and 1");
-    }
-    double ci = ai->sCap;
-    auto aj = ((const SMPActor*)(md0->actrs[rcvr_j]));
-    double sj = KBase::sum(aj->vSal);
-    if ((0 >= sj) || (sj > 1)) {
-      throw KException("SMPModel::getQuadMapPoint: sj should be between 0 and 1");
-    }
-    double cj = aj->sCap;
-    const double minCltn = 1E-10;
-
-    auto contribs = calcContribs(md0->vrCltn, si*ci, sj*cj, tuple<double, double, double, double>(uii, uij, uji, ujj));
-
-    double chij = get<0>(contribs); // strength of complete coalition supporting i over j (initially empty)
-    double chji = get<1>(contribs); // strength of complete coalition supporting j over i (initially empty)
-
-    // cache those sums
-    double contrib_i_ij = chij;
-    double contrib_j_ij = chji;
+    auto qt = quadMapTurn(t);
+    return quadMapPoint(*qt, est_h, aff_k, init_i, rcvr_j);
+}
 
-    // we assess the overall coalition strengths by adding up the contribution of
-    // individual actors (including i and j, above). We assess the contribution of third
-    // parties (n) by looking at little coalitions in the hypothetical (in:j) or (i:nj) contests.
-    for (unsigned int n = 0; n < md0->numAct; n++) {
-        if ((n != init_i) && (n != rcvr_j)) { // already got their influence-contributions
-            auto an = ((const SMPActor*)(md0->actrs[n]));
+double SMPModel::getQuadMapPoint(const QString &connectionName, const string &scenarioID,
+  size_t turn, size_t est_h, size_t aff_k, size_t init_i, size_t rcvr_j) {
+    auto qt = quadMapTurn(connectionName, scenarioID, turn);
+    return quadMapPoint(*qt, est_h, aff_k, init_i, rcvr_j);
+}
 
-            double cn = an->sCap;
-            double sn = KBase::sum(an->vSal);
-            double uni = autil[est_h](n, init_i);
-            double unj = autil[est_h](n, rcvr_j);
-            double unn = autil[est_h](n, n);
+vector<double> SMPModel::getQuadMapPoints(size_t t, const vector<QuadMapPt> & pts) {
+    auto qt = quadMapTurn(t);
+    return quadMapPoints(*qt, pts);
+}
 
-            // notice that each third party starts afresh,
-            // considering only contributions of principals and itself
-            double pin = Actor::vProbLittle(md0->vrCltn, sn*cn, uni, unj, contrib_i_ij, contrib_j_ij);
+vector<double> SMPModel::getQuadMapPoints(const QString &connectionName, const string &scenarioID,
+  size_t turn, const vector<QuadMapPt> & pts) {
+    auto qt = quadMapTurn(connectionName, scenarioID, turn);
+    return quadMapPoints(*qt, pts);
+}
 
-            if (0.0 > pin) {
-              throw KException("SMPModel::getQuadMapPoint: pin must be non-negative");
-            }
-            if (pin > 1.0) {
-              throw KException("SMPModel::getQuadMapPoint: pin must not be more than 1.0");
-            }
-            double pjn = 1.0 - pin;
-            auto vt_uv_ul = Actor::thirdPartyVoteSU(sn*cn, md0->vrCltn, md0->tpCommit, pin, pjn, uni, unj, unn);
-            const double vnij = get<0>(vt_uv_ul);
-            chij = (vnij > 0) ? (chij + vnij) : chij;
-            if (0 >= chij) {
-              throw KException("SMPModel::getQuadMapPoint: chij must be positive");
+vector<double> SMPModel::quadMapPoints(const SMPQuadMapTurn & qt, const vector<QuadMapPt> & pts) {
+    // Each point is only O(numAct), so hand them to the threads in blocks
+    const unsigned int blockSize = 64;
+    const unsigned int np = pts.size();
+    auto vals = vector<double>(np, 0.0);
+    if (0 == np) {
+        return vals;
+    }
+    // quadMapPoint throws on bad data, but an exception must not escape a thread,
+    // so the first one is kept and rethrown to the caller after the join
+    std::mutex errLock;
+    std::exception_ptr firstErr = nullptr;
+    auto blockFn = [&qt, &pts, &vals, np, &errLock, &firstErr](unsigned int b) {
+        try {
+            const unsigned int n1 = std::min(np, (b + 1) * blockSize);
+            for (unsigned int n = b * blockSize; n < n1; n++) {
+                const QuadMapPt & pt = pts[n];
+                vals[n] = quadMapPoint(qt, get<0>(pt), get<1>(pt), get<2>(pt), get<3>(pt));
             }
-            chji = (vnij < 0) ? (chji - vnij) : chji;
-            if (0 >= chji) {
-              throw KException("SMPModel::getQuadMapPoint: chij must be positive");
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lk(errLock);
+            if (nullptr == firstErr) {
+                firstErr = std::current_exception();
             }
         }
+    };
+    KBase::groupThreads(blockFn, 0, (np - 1) / blockSize);
+    if (nullptr != firstErr) {
+        std::rethrow_exception(firstErr);
     }
-
-    const double phij = chij / (chij + chji); // ProbVict, for i
-    const double phji = chji / (chij + chji);
-
-    const double euVict = uhkij;  // UtilVict
-    const double euCntst = phij*uhkij + phji*uhkji; // UtilContest,
-    const double euChlg = (1 - sj)*euVict + sj*euCntst; // UtilChlg
-
-    return (euChlg - euSQ);
+    return vals;
 }
 
-double SMPModel::getQuadMapPoint(const QString &connectionName, const string &scenarioID,
-  size_t turn, size_t est_h, size_t aff_k, size_t init_i, size_t rcvr_j) {
-
-  QSqlDatabase qdb = QSqlDatabase::database(connectionName);
-  QSqlQuery qtQry = QSqlQuery(qdb);;
-
-    auto getUtilQuery = [scenarioID, turn, est_h](size_t initiator, size_t receiver) {
-        string query = "SELECT Util FROM PosUtil WHERE ScenarioId = \'" + scenarioID
-                + "\' AND Turn_t = " + std::to_string(turn) + " AND Est_h = " + std::to_string(est_h)
-                + " AND Act_i = " + std::to_string(initiator) + " AND Pos_j =  " + std::to_string(receiver);
-        return query;
-    };
-
-    auto getVSalQuery = [scenarioID, turn](size_t actor) {
-        string query = "SELECT SUM(Sal) FROM SpatialSalience WHERE ScenarioId=\'" + scenarioID
-                + "\' AND Turn_t = " + std::to_string(turn) + " AND Act_i = " + std::to_string(actor);
-
-        return query;
-    };
+shared_ptr<const SMPQuadMapTurn> SMPModel::quadMapTurn(size_t t) {
+    if ((nullptr == md0) || (md0->history.size() <= t)) {
+      throw KException("SMPModel::quadMapTurn: no such turn in the model history");
+    }
+    auto smpState = ((const SMPState*)(md0->history[t]));
+    const unsigned int na = md0->numAct;
+    if (na != smpState->aUtil.size()) {
+      throw KException("SMPModel::quadMapTurn: utilities are not set for this turn");
+    }
+    auto qt = std::make_shared<SMPQuadMapTurn>();
+    qt->numAct = na;
+    qt->vrCltn = md0->vrCltn;
+    qt->tpCommit = md0->tpCommit;
+    qt->aUtil = &(smpState->aUtil);
+    qt->salSum = vector<double>(na, 0.0);
+    qt->caps = vector<double>(na, 0.0);
+    for (unsigned int n = 0; n < na; n++) {
+        auto an = ((const SMPActor*)(md0->actrs[n]));
+        qt->salSum[n] = KBase::sum(an->vSal);
+        qt->caps[n] = an->sCap;
+    }
+    return qt;
+}
 
-    auto getSCapQuery = [scenarioID, turn](size_t actor) {
-        string query = "SELECT Cap FROM SpatialCapability WHERE ScenarioId=\'" + scenarioID
-                + "\' AND Turn_t = " + std::to_string(turn) + " AND Act_i = " + std::to_string(actor);
+// Redraws keep asking for the same few turns, so quadMapTurn keeps the most recent
+// ones read from a db, until clearQuadMapCache is called when a db is (re)loaded
+static std::mutex quadMapCacheLock;
+static std::deque<tuple<string, shared_ptr<const SMPQuadMapTurn>>> quadMapCache;
 
-        return query;
-    };
+void SMPModel::clearQuadMapCache() {
+    std::lock_guard<std::mutex> lk(quadMapCacheLock);
+    quadMapCache.clear();
+    return;
+}
 
-    // Get voting rule and third party commit for this scenario
-    string query = "SELECT VotingRule, ThirdPartyCommit FROM ScenarioDesc WHERE ScenarioId=\'" + scenarioID + "\'";
-
-    //voting rule
-    int vr;
-    //third party commit
-    int tpc;
-    if (qtQry.exec(query.c_str())) {
-      if (qtQry.first()) {
-        vr = qtQry.value(0).toInt();
-        tpc = qtQry.value(1).toInt();
-      }
+shared_ptr<const SMPQuadMapTurn> SMPModel::quadMapTurn(const QString &connectionName,
+  const string &scenarioID, size_t turn) {
+    auto & cacheLock = quadMapCacheLock;
+    auto & cache = quadMapCache;
+    const unsigned int maxCached = 8;
+    const string key = connectionName.toStdString() + "|" + scenarioID + "|" + std::to_string(turn);
+    {
+        std::lock_guard<std::mutex> lk(cacheLock);
+        for (auto & ce : cache) {
+            if (get<0>(ce) == key) {
+                return get<1>(ce);
+            }
+        }
     }
 
-    VotingRule vrCltn = static_cast<VotingRule>(vr);
-    ThirdPartyCommit tpCommit = static_cast<ThirdPartyCommit>(tpc);
-
-    auto getData = [&qtQry]() {
-      if (qtQry.exec()) {
-        if (qtQry.first()) {
-          return qtQry.value(0);
+    QSqlDatabase qdb = QSqlDatabase::database(connectionName);
+    QSqlQuery qtQry = QSqlQuery(qdb);
+    auto runQuery = [&qtQry, &scenarioID, turn](const string & sql) {
+        qtQry.prepare(sql.c_str());
+        qtQry.bindValue(":scen", QString::fromStdString(scenarioID));
+        qtQry.bindValue(":turn_t", (uint)turn);
+        if (!qtQry.exec()) {
+            throw KException("SMPModel::quadMapTurn: query failed: " + sql);
         }
-      }
-    };
-
-    auto utilValue = [&qtQry, &getData](size_t initiator, size_t receiver) {
-      qtQry.bindValue(":act_i", (uint)initiator);
-      qtQry.bindValue(":pos_j", (uint)receiver);
-      return getData().toDouble();
-    };
-
-    auto spatialValue = [&qtQry, &getData](size_t initiator) {
-      qtQry.bindValue(":act_i", (uint)initiator);
-      return getData().toDouble();
+        return;
     };
 
-    string utilQry = "SELECT Util FROM PosUtil WHERE ScenarioId = \'" + scenarioID
-      + "\' AND Turn_t = " + std::to_string(turn) + " AND Est_h = " + std::to_string(est_h)
-      + " AND Act_i = :act_i AND Pos_j = :pos_j";
-
-    qtQry.prepare(utilQry.c_str());
-
-    double uii = utilValue(init_i, init_i);
-
-    double uij = utilValue(init_i, rcvr_j);
+    auto qt = std::make_shared<SMPQuadMapTurn>();
+
+    // voting rule and third party commit for this scenario
+    runQuery("SELECT VotingRule, ThirdPartyCommit FROM ScenarioDesc WHERE ScenarioId = :scen");
+    if (!qtQry.first()) {
+        throw KException("SMPModel::quadMapTurn: scenario not found");
+    }
+    qt->vrCltn = static_cast<VotingRule>(qtQry.value(0).toInt());
+    qt->tpCommit = static_cast<ThirdPartyCommit>(qtQry.value(1).toInt());
+
+    runQuery("SELECT MAX(Act_i) FROM ActorDescription WHERE ScenarioId = :scen");
+    if (!qtQry.first()) {
+        throw KException("SMPModel::quadMapTurn: scenario has no actors");
+    }
+    const unsigned int na = qtQry.value(0).toUInt() + 1;
+    qt->numAct = na;
+    qt->dbUtil = vector<KMatrix>(na, KMatrix(na, na));
+    qt->aUtil = &(qt->dbUtil);
+    qt->salSum = vector<double>(na, 0.0);
+    qt->caps = vector<double>(na, 0.0);
+
+    // the whole turn's slice of each table, in one query apiece
+    unsigned int nUtil = 0;
+    runQuery("SELECT Est_h, Act_i, Pos_j, Util FROM PosUtil WHERE ScenarioId = :scen AND Turn_t = :turn_t");
+    while (qtQry.next()) {
+        const unsigned int h = qtQry.value(0).toUInt();
+        const unsigned int i = qtQry.value(1).toUInt();
+        const unsigned int j = qtQry.value(2).toUInt();
+        if ((h < na) && (i < na) && (j < na)) {
+            qt->dbUtil[h](i, j) = qtQry.value(3).toDouble();
+            nUtil++;
+        }
+    }
+    if (na * na * na != nUtil) {
+        throw KException("SMPModel::quadMapTurn: PosUtil does not have every utility for this turn");
+    }
 
-    double uji = utilValue(rcvr_j, init_i);
+    runQuery("SELECT Act_i, SUM(Sal) FROM SpatialSalience WHERE ScenarioId = :scen AND Turn_t = :turn_t"
+             " GROUP BY Act_i");
+    while (qtQry.next()) {
+        const unsigned int i = qtQry.value(0).toUInt();
+        if (i < na) {
+            qt->salSum[i] = qtQry.value(1).toDouble();
+        }
+    }
 
-    double ujj = utilValue(rcvr_j, rcvr_j);
+    runQuery("SELECT Act_i, Cap FROM SpatialCapability WHERE ScenarioId = :scen AND Turn_t = :turn_t");
+    while (qtQry.next()) {
+        const unsigned int i = qtQry.value(0).toUInt();
+        if (i < na) {
+            qt->caps[i] = qtQry.value(1).toDouble();
+        }
+    }
+    qtQry.finish();
+    qtQry.clear();
 
-    double uki = utilValue(aff_k, init_i);
+    std::lock_guard<std::mutex> lk(cacheLock);
+    cache.push_front(tuple<string, shared_ptr<const SMPQuadMapTurn>>(key, qt));
+    if (maxCached < cache.size()) {
+        cache.pop_back();
+    }
+    return qt;
+}
 
-    double ukj = utilValue(aff_k, rcvr_j);
+double SMPModel::quadMapPoint(const SMPQuadMapTurn & qt, size_t est_h, size_t aff_k, size_t init_i, size_t rcvr_j) {
+    const unsigned int na = qt.numAct;
+    if ((na <= est_h) || (na <= aff_k) || (na <= init_i) || (na <= rcvr_j)) {
+      throw KException("SMPModel::quadMapPoint: actor index out of range");
+    }
+    const KMatrix & uh = (*qt.aUtil)[est_h];
+    double uii = uh(init_i, init_i);
+    double uij = uh(init_i, rcvr_j);
+    double uji = uh(rcvr_j, init_i);
+    double ujj = uh(rcvr_j, rcvr_j);
 
-    double euSQ = uki + ukj;
+    // h's estimate of utility to k of status-quo positions of i and j
+    const double euSQ = uh(aff_k, init_i) + uh(aff_k, rcvr_j);
+    if ((0.0 > euSQ) || (euSQ > 2.0)) {
+      throw KException("SMPModel::quadMapPoint: euSQ should be between 0.0 and 2.0");
+    }
 
-    double uhkij = 2 * uki;
+    // h's estimate of utility to k of i defeating j, so j adopts i's position
+    const double uhkij = uh(aff_k, init_i) + uh(aff_k, init_i);
     if ((0.0 > uhkij) || (uhkij > 2.0)) {
-      throw KException("SMPModel::getQuadMapPoint: uhkij should be between 0.0 and 2.0");
+      throw KException("SMPModel::quadMapPoint: uhkij should be between 0.0 and 2.0");
     }
 
-    double uhkji = 2 * ukj;
+    // h's estimate of utility to k of j defeating i, so i adopts j's position
+    const double uhkji = uh(aff_k, rcvr_j) + uh(aff_k, rcvr_j);
     if ((0.0 > uhkji) || (uhkji > 2.0)) {
-      throw KException("SMPModel::getQuadMapPoint: uhkji should be between 0.0 and 2.0");
+      throw KException("SMPModel::quadMapPoint: uhkji should be between 0.0 and 2.0");
     }
 
-    string vsalQry = "SELECT SUM(Sal) FROM SpatialSalience WHERE ScenarioId=\'" + scenarioID
-      + "\' AND Turn_t = " + std::to_string(turn) + " AND Act_i = :act_i";
-    qtQry.prepare(vsalQry.c_str());
-
-    double si = spatialValue(init_i);
+    double si = qt.salSum[init_i];
     if ((0 >= si) || (si > 1)) {
-      throw KException("SMPModel::getQuadMapPoint: si should be between 0 and 1");
+      throw KException("SMPModel::quadMapPoint: si should be between 0 and 1");
     }
-
-    double sj = spatialValue(rcvr_j);
+    double ci = qt.caps[init_i];
+    double sj = qt.salSum[rcvr_j];
     if ((0 >= sj) || (sj > 1)) {
-      throw KException("SMPModel::getQuadMapPoint: sj should be between 0 and 1");
+      throw KException("SMPModel::quadMapPoint: sj should be between 0 and 1");
     }
+    double cj = qt.caps[rcvr_j];
 
-    string scapQry = "SELECT Cap FROM SpatialCapability WHERE ScenarioId=\'" + scenarioID
-      + "\' AND Turn_t = " + std::to_string(turn) + " AND Act_i = :act_i";
-    qtQry.prepare(scapQry.c_str());
-
-    double ci = spatialValue(init_i);
-
-    double cj = spatialValue(rcvr_j);
-
-    auto contribs = calcContribs(vrCltn, si*ci, sj*cj, tuple<double, double, double, double>(uii, uij, uji, ujj));
+    auto contribs = calcContribs(qt.vrCltn, si*ci, sj*cj, tuple<double, double, double, double>(uii, uij, uji, ujj));
 
     double chij = get<0>(contribs); // strength of complete coalition supporting i over j (initially empty)
     double chji = get<1>(contribs); // strength of complete coalition supporting j over i (initially empty)
@@ -1964,55 +1974,41 @@ double SMPModel::getQuadMapPoint(const QString &connectionName, const string &sc
     double contrib_i_ij = chij;
     double contrib_j_ij = chji;
 
-    // Get count of actors for this scenario
-    query = "SELECT MAX(Act_i) FROM ActorDescription WHERE ScenarioId=\'" + scenarioID + "\'";
-    qtQry.prepare(query.c_str());
-    size_t numAct = getData().toUInt() + 1;
-
     // we assess the overall coalition strengths by adding up the contribution of
     // individual actors (including i and j, above). We assess the contribution of third
     // parties (n) by looking at little coalitions in the hypothetical (in:j) or (i:nj) contests.
-    //for (size_t n = 0; n < numAct; n++) {
-    for (size_t n = 0; n < numAct; n++) {
-      if ((n != init_i) && (n != rcvr_j)) { // already got their influence-contributions
-
-            qtQry.prepare(vsalQry.c_str());
-            double sn = spatialValue(n);
-
-            qtQry.prepare(scapQry.c_str());
-            double cn = spatialValue(n);
-
-            qtQry.prepare(utilQry.c_str());
-            double uni = utilValue(n, init_i);
-
-            double unj = utilValue(n, rcvr_j);
-
-            double unn = utilValue(n, n);
+    for (unsigned int n = 0; n < na; n++) {
+        if ((n != init_i) && (n != rcvr_j)) { // already got their influence-contributions
+            double cn = qt.caps[n];
+            double sn = qt.salSum[n];
+            double uni = uh(n, init_i);
+            double unj = uh(n, rcvr_j);
+            double unn = uh(n, n);
 
             // notice that each third party starts afresh,
             // considering only contributions of principals and itself
-            double pin = Actor::vProbLittle(vrCltn, sn*cn, uni, unj, contrib_i_ij, contrib_j_ij);
+            double pin = Actor::vProbLittle(qt.vrCltn, sn*cn, uni, unj, contrib_i_ij, contrib_j_ij);
 
-            if (0.0 > pin || pin > 1.0) {
-              throw KException("SMPModel::getQuadMapPoint: pin should be between 0 and 1");
+            if (0.0 > pin) {
+              throw KException("SMPModel::quadMapPoint: pin must be non-negative");
+            }
+            if (pin > 1.0) {
+              throw KException("SMPModel::quadMapPoint: pin must not be more than 1.0");
             }
             double pjn = 1.0 - pin;
-            auto vt_uv_ul = Actor::thirdPartyVoteSU(sn*cn, vrCltn, tpCommit, pin, pjn, uni, unj, unn);
+            auto vt_uv_ul = Actor::thirdPartyVoteSU(sn*cn, qt.vrCltn, qt.tpCommit, pin, pjn, uni, unj, unn);
             const double vnij = get<0>(vt_uv_ul);
             chij = (vnij > 0) ? (chij + vnij) : chij;
             if (0 >= chij) {
-              throw KException("SMPModel::getQuadMapPoint: chij must be positive");
+              throw KException("SMPModel::quadMapPoint: chij must be positive");
             }
             chji = (vnij < 0) ? (chji - vnij) : chji;
             if (0 >= chji) {
-              throw KException("SMPModel::getQuadMapPoint: chij must be positive");
+              throw KException("SMPModel::quadMapPoint: chji must be positive");
             }
         }
     }
 
-    qtQry.finish();
-    qtQry.clear();
-
     const double phij = chij / (chij + chji); // ProbVict, for i
     const double phji = chji / (chij + chji);
 
@@ -2085,11 +2081,16 @@ tuple<double, double> SMPModel::calcContribs(VotingRule vrCltn, double wi, doubl
 
 void SMPModel::destroyModel() {
     delete md0;
+    md0 = nullptr;
 }
 
 void SMPModel::randomSMP(unsigned int numA, unsigned int sDim, bool accP, uint64_t s, vector<bool> f) {
     // JAH 20160711 added rng seed 20160730 JAH added sql flags
-    SMPModel *md0 = new SMPModel("", s, f);
+    if (md0 != nullptr) {
+        delete md0;
+        md0 = nullptr;
+    }
+    md0 = new SMPModel("", s, f);
     md0->sqlTest();
     if (0 == numA) {
         double lnMin = log(4);
@@ -2239,9 +2240,7 @@ void SMPModel::randomSMP(unsigned int numA, unsigned int sDim, bool accP, uint64
 
     SMPModel::configExec(md0);
 
-    delete md0;
-    md0 = nullptr;
-
+    // as after runModel, the model is kept until destroyModel
     return;
 }
 
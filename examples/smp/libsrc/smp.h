@@ -26,12 +26,14 @@
 
 #include <string>
 #include <map>
+#include <thread>
 
 #include <easylogging++.h>
 #include "sqlite3.h"
 #include "kutils.h"
 #include "prng.h"
 #include "kmatrix.h"
+#include "smatrix.h"
 #include "gaopt.h"
 #include "kmodel.h"
 
@@ -91,16 +93,180 @@ const vector<string> InterVecBrgnNames = {
   "S1P1", "S2P2", "S2PMax" };
 ostream& operator<< (ostream& os, const InterVecBrgn& ivb);
 
+// One step of a turn's bargaining, as the actor concerned saw it.
+// The actors' threads record these into their own lists, which are rendered
+// in actor order once the threads are done (SMPState::flushBCNEvents), so the
+// log and the event file are the same however the threads were scheduled.
+enum class BCNEventKind : uint8_t {
+  ChallengeChosen, // init chose to challenge rcvr; value is the expected gain
+  NoTarget,        // init found no advantageous challenge
+  BargainProposed, // init put bargain brgnID to itself and rcvr
+  BargainSelected  // init adopts bargain brgnID; value is its PCE probability
+};
+const vector<string> BCNEventKindNames = {
+  "ChallengeChosen", "NoTarget", "BargainProposed", "BargainSelected" };
+
+struct BCNEvent {
+  BCNEventKind kind = BCNEventKind::NoTarget;
+  unsigned int turn = 0;
+  unsigned int init = 0;
+  unsigned int rcvr = 0;
+  uint64_t brgnID = 0;
+  double value = 0.0;
+  string text = ""; // what to log, if anything; formatted only when the trace level calls for it
+};
+
+// Layout of the position-history export (SMPModel::sankeyOutput).
+// Wide is the pair of files used to draw Sankey diagrams: _effPow.csv and _posLog.csv,
+// one row per actor, after a line of model parameters.
+// Long writes one row per value, for all scenarios together, in _effPowLong.csv,
+// _posLong.csv and _scenarios.csv, which load directly into column-oriented tools.
+enum class SankeyFormat {
+  Wide, Long
+};
+
+// -------------------------------------------------
+// When to stop an SMP run. The first four are the long-standing criteria:
+// stop after maxIter turns, or after minIter turns once the change in the
+// last turn is below minDeltaRatio of the first (minSigDelta guards 0/0).
+//
+// Runs often settle into a small cycle, or a fixed point, long before that.
+// If cycleGrid is positive, each state's positions are rounded to multiples
+// of cycleGrid (on the [0,1] scale) and hashed, so that a state repeating an
+// earlier one is noticed and logged. If cycleRepeats is also positive, the run
+// stops once the states have gone round that cycle cycleRepeats more times.
+struct SMPStopParams {
+public:
+  unsigned int minIter = 2;
+  unsigned int maxIter = 100;
+  double minDeltaRatio = 0.02;
+  double minSigDelta = 1E-4;
+  double cycleGrid = 0.0;
+  unsigned int cycleRepeats = 0;
+};
+
+// the λ-fn for Model::stop which applies these criteria to one run.
+// The cycle it finds (start, length) goes in *cycle if given, else in the model.
+function<bool(unsigned int, const State *)> smpStopFn(const SMPStopParams & sp,
+    tuple<unsigned int, unsigned int> * cycle = nullptr);
+
+// -------------------------------------------------
+// The structure of a synthetic scenario, for scaling studies (see SMPModel::genScenario).
+//
+// Positions are uniform on [0,100] or, if numClusters is positive, normal around
+// that many random centers, with standard deviation clusterSD, clipped to [0,100].
+// Actor i is in cluster (i*numClusters)/numAct, so clusters are contiguous runs.
+// Capabilities are uniform on [10,200], as in SMPActor::randomize, or, if capAlpha
+// is positive, Pareto with minimum capMin and tail exponent capAlpha, cut at capMax.
+// Each actor attends to a random salDensity fraction of the dimensions (at least one),
+// with a total salience uniform on [75,99], again as in randomize.
+// The accommodation matrix is the identity unless accSelf is below 1: then each actor
+// puts weight accSelf on its own position and accBlock, shared equally, on the
+// positions of the rest of its cluster.
+struct SMPGenParams {
+public:
+  unsigned int numAct = 100;
+  unsigned int numDim = 3;
+  uint64_t seed = KBase::dSeed;
+  string name = "Synthetic";
+  string desc = "Synthetic scenario";
+  unsigned int numClusters = 0;
+  double clusterSD = 8.0;
+  double capAlpha = 0.0;
+  double capMin = 10.0;
+  double capMax = 1E6;
+  double salDensity = 1.0;
+  double accSelf = 1.0;
+  double accBlock = 0.0;
+};
+
+// A scenario as the input files hold it: one row per actor, with
+// positions and saliences on the [0,100] scale.
+struct SMPScenario {
+public:
+  string name = "";
+  string desc = "";
+  uint64_t seed = 0;
+  vector<string> aName = {};
+  vector<string> aDesc = {};
+  vector<string> dName = {};
+  KMatrix cap = KMatrix(); // [numAct, 1]
+  KMatrix pos = KMatrix(); // [numAct, numDim]
+  KMatrix sal = KMatrix(); // [numAct, numDim]
+  KMatrix acc = KMatrix(); // [numAct, numAct]
+};
+
 // -------------------------------------------------
-// Plain-Old-Data
+// What SMPModel::preflight finds before a run: every broken invariant, one line
+// each, and a rough cost. CPU time is extrapolated from timings of generated
+// scenarios of 40 to 120 actors, and the database from the rows each SQL group
+// writes during each turn and after the run, at about 64 bytes a row (the
+// 32-character ScenarioId is in every row). As a run may stop well before
+// maxIter, take the run totals as bounds.
+struct SMPPreflight {
+public:
+  vector<string> errors = {};
+  unsigned int turns = 0; // at most, i.e. stopParams.maxIter
+  double turnCPUSec = 0.0;
+  double runCPUSec = 0.0;
+  uint64_t turnDBRows = 0; // written as each turn runs
+  uint64_t runDBRows = 0; // all the turns, and the tables written after the run
+  uint64_t runDBBytes = 0;
+  uint64_t utilBytes = 0; // the utility matrices of one state
+};
+
+// What runModel does before a run: nothing (Off), or preflight, refusing to
+// run a scenario with any error and otherwise running it prevalidated (Check),
+// or preflight alone, reporting without running (DryRun).
+enum class SMPPreflightMode {
+  Off, Check, DryRun
+};
+
+// -------------------------------------------------
+// What the quad-map needs from one turn of a scenario: each actor's estimate
+// of the utilities, aUtil[h](i, j) as in SMPState, each actor's total salience
+// and capability, and the scenario's voting rule and third-party commitment.
+// The utilities of a turn in the model's history are read where they are, so
+// aUtil points at the state's own (and is good while the history is); those
+// read from a db are held in dbUtil. Not copyable, as aUtil may point at dbUtil.
+struct SMPQuadMapTurn {
+public:
+  SMPQuadMapTurn() = default;
+  SMPQuadMapTurn(const SMPQuadMapTurn &) = delete;
+  SMPQuadMapTurn & operator=(const SMPQuadMapTurn &) = delete;
+  unsigned int numAct = 0;
+  VotingRule vrCltn = VotingRule::Proportional;
+  ThirdPartyCommit tpCommit = ThirdPartyCommit::SemiCommit;
+  const vector<KMatrix> * aUtil = nullptr;
+  vector<KMatrix> dbUtil = {};
+  vector<double> salSum = {};
+  vector<double> caps = {};
+};
+
+// a point of the quad-map: estimator h, affected actor k, initiator i, receiver j
+using QuadMapPt = tuple<size_t, size_t, size_t, size_t>;
+
+// -------------------------------------------------
+// Plain-Old-Data, held by value in the SMPState bargain arena
 struct BargainSMP {
+  friend class SMPModel; // so snapshots can carry on the numbering of bargains
+  friend class SMPState; // which hands out each turn's blocks of IDs
 public:
   BargainSMP(const SMPActor* ai, const SMPActor* ar, const VctrPstn & pi, const VctrPstn & pr);
-  ~BargainSMP();
+  BargainSMP(const SMPActor* ai, const SMPActor* ar, const VctrPstn & pi, const VctrPstn & pr, uint64_t id);
+
+  // In each turn, initiator i numbers its bargains from a block of this many IDs
+  // starting at i*idsPerInit (status quo, its own, the target's, the compromise),
+  // so the numbering does not depend on the order in which the threads run.
+  static const uint64_t idsPerInit = 4;
 
 
   const SMPActor* actInit = nullptr;
   const SMPActor* actRcvr = nullptr;
+  // model indices of the two actors, fixed when the bargain is made,
+  // so that tables keyed by actor need no search of Model::actrs
+  unsigned int initNdx = 0;
+  unsigned int rcvrNdx = 0;
   VctrPstn posInit = VctrPstn();
   VctrPstn posRcvr = VctrPstn();
   uint64_t getID() const;
@@ -109,6 +275,23 @@ protected:
   uint64_t myBargainID = 0;
 };
 
+// -------------------------------------------------
+// Structure-of-arrays copy of what the SMP kernels read about the actors,
+// so the inner loops walk flat arrays instead of chasing SMPActor and
+// VctrPstn pointers. Per-dimension data is actor-major: x[i*numDim + d].
+struct SMPActorStore {
+public:
+  unsigned int numAct = 0;
+  unsigned int numDim = 0;
+  vector<double> caps = {}; // scalar capability
+  vector<double> salSum = {}; // sum of saliences
+  vector<double> salSq = {}; // sum of squared saliences
+  vector<double> wts = {}; // caps * salSum
+  vector<double> sal = {};
+  vector<double> pos = {};
+  vector<double> ideal = {};
+};
+
 // -------------------------------------------------
 // Trivial, SMP-like actor with fixed attributes
 // the old smp.cpp file, SpatialState::developTwoPosBargain, for a discussion of
@@ -145,9 +328,9 @@ public:
 
   // the attributes used in this method are not generally part of
   // other actors, and not all positions can be represented as a list of doubles.
-  static BargainSMP* interpolateBrgn(const SMPActor* ai, const SMPActor* aj,
-                                     const VctrPstn* posI, const VctrPstn * posJ,
-                                     double prbI, double prbJ, InterVecBrgn ivb);
+  static BargainSMP interpolateBrgn(const SMPActor* ai, const SMPActor* aj,
+                                    const VctrPstn* posI, const VctrPstn * posJ,
+                                    double prbI, double prbJ, InterVecBrgn ivb, uint64_t id);
 
 
 protected:
@@ -163,7 +346,7 @@ protected:
 };
 
 class SMPState : public State {
-
+  friend class SMPModel; // for runEnsemble
 public:
   explicit SMPState(Model * m);
   virtual ~SMPState();
@@ -186,6 +369,9 @@ public:
 
   SMPState* stepBCN();
 
+  // set the indices and utilities this state needs to be stepped, unless already set
+  void setupStep();
+
   // The key steps of BCN are to identify a target (and perhaps other target-relevant info)
   // and then to develop a Bargain (possibly nullptr if no bargain is mutually preferable
   // to conflict)
@@ -199,7 +385,7 @@ public:
 
   // use the parameters of your state to compute the relative probability of each actor's position
   virtual tuple< KMatrix, VUI> pDist(int persp) const;
-  void showBargains(const vector < vector < BargainSMP* > > & brgns) const;
+  void showBargains() const;
   string showOneBargain(const BargainSMP* b) const;
 
   virtual bool equivNdx(unsigned int i, unsigned int j) const;
@@ -227,6 +413,8 @@ public:
   void setPosMoverBargain(unsigned int actor, uint64_t bargainID);
 
 protected:
+  // vector positions within posTol of each other are equivalent; found by spatial hashing
+  virtual tuple<VUI, VUI> ueNdx() const;
 
 private:
 
@@ -236,6 +424,7 @@ private:
   mutable std::multimap<string, double>phijData;
   mutable std::multimap<string, vector<double>> euData;
   void recordProbEduChlg() const;
+  void recordPositionMoves() const;
 
   // this sets the values in all the AUtil matrices
   virtual void setAllAUtil(ReportingLevel rl);
@@ -253,6 +442,31 @@ private:
 
   void doBCN(unsigned int i);
 
+  // The stages of doBCN which touch no table and draw no random numbers, so that
+  // SMPModel::runEnsemble can assess a state once and branch from it several times.
+  // makeBargains has every actor propose its bargains, assessBargains evaluates
+  // them (filling brgnChoices), and releaseBargains frees them all.
+  // releaseTurnData also frees the utilities and everything else recorded
+  // while stepping, for a state which is neither stepped again nor reported.
+  void makeBargains();
+  void assessBargains();
+  void releaseBargains();
+  void releaseTurnData();
+
+  // log the text of the queued events, one actor at a time, append them to
+  // SMPModel::eventFile if it is set, and clear them
+  void flushBCNEvents();
+
+  // the index of the bargain actor k adopts: the most likely one, or a draw from rng,
+  // according to the model's StateTransMode. Needs brgnChoices.
+  unsigned int chooseBrgn(unsigned int k, PRNG* rng) const;
+
+  // a fresh position for actor k, from k's m-th bargain, noting in sn the bargain if k moved
+  VctrPstn* brgnPstn(unsigned int k, unsigned int m, SMPState* sn) const;
+
+  // carry accommodation and ideals forward into sn, once sn has all its positions
+  void setSuccessor(SMPState* sn) const;
+
   // returns estimated probability k wins (given likely coaltiions), and expected delta-util of that challenge.
   // If desired, record in SQLite.
   tuple<double, double> probEduChlg(unsigned int h, unsigned int k, unsigned int i, unsigned int j, bool sqlP) const;
@@ -264,25 +478,35 @@ private:
   vector<VctrPstn> ideals = {};
 
   // The matrix of rates at which they adjust their ideals toward positions.
-  // Change it ONLY via setAccomodate, so as to keep identAccMat in synch
+  // Change it ONLY via setAccomodate, so as to keep identAccMat, accSprs and accLag in synch
   KMatrix accomodate = KMatrix();
   bool identAccMat = true;
 
+  // Real accommodation matrices are nearly diagonal, so newIdeals uses this sparse
+  // copy, along with the weight each actor keeps on its old ideal: 1 - (row sum).
+  KBase::SMatrix accSprs = KBase::SMatrix();
+  vector<double> accLag = {};
+
   // rest the new ideal points, based on other's positions and one's old ideal point
   void newIdeals();
 
   // return RMS distance between ideals and positions
   double posIdealDist(ReportingLevel rl = ReportingLevel::Silent) const;
 
-  void updateBargnTable(const vector<vector<BargainSMP*>> & brgns,
-                        map<unsigned int, KBase::KMatrix>  actorBargains,
+  void updateBargnTable(map<unsigned int, KBase::KMatrix>  actorBargains,
                         map<unsigned int, unsigned int>  actorMaxBrgNdx) const;
 
   /**
-   * Calculate all challenge utilities (i, i, i, j) which would be used to find the best challenge
+   * Calculate the challenge utilities (i, i, i, j) which would be used to find the best challenge.
+   * All of them when the challenge tables are being recorded; otherwise only those targets
+   * whose upper bound on expected gain could still beat the best found so far.
    */
   eduChlgsI bestChallengeUtils(unsigned int i /* initiator actor */) const;
 
+  // for SMP, positive expected gains on the first turn are typically in the 0.5 to 0.01 range
+  // I take a fraction of the minimum.
+  static constexpr double minSigEDU = 1e-5; // TODO: 1/20 of the minimum, or 0.0005
+
   // Record the bargain id that caused an actor to move in each turn
   using moverBargains = std::map<
     unsigned int, // actor id
@@ -292,7 +516,22 @@ private:
 
   unsigned int turn;
 
-  vector< vector < BargainSMP* > > brgns;
+  // All the bargains made in one turn live in brgnArena, which doBCN reserves
+  // up front (at most three per initiator) and releases in one shot once they
+  // are resolved. Because it never reallocates while the turn is running,
+  // brgns[i] can list actor i's bargains as plain indices into it.
+  vector<BargainSMP> brgnArena;
+  vector< vector <unsigned int> > brgns;
+
+  // the j-th bargain involving actor i
+  const BargainSMP & brgnAt(unsigned int i, unsigned int j) const {
+    return brgnArena[brgns[i][j]];
+  }
+
+  // Move the bargains into the arena, then queue their indices onto their
+  // initiators' lists and afterwards onto their receivers' lists.
+  // A status-quo bargain (initiator == receiver) is queued only once.
+  void addBargains(vector<BargainSMP> & bs);
 
   std::mutex brgnsLock;
 
@@ -304,10 +543,29 @@ private:
 
   std::map<unsigned int, unsigned int> actorMaxBrgNdx;
 
-  std::mutex mtxLock;
+  // Copy the actors' capabilities and saliences, and this state's positions
+  // and ideals, into aStore, along with the derived sums. Done at the start
+  // of setAllAUtil, so it is current for everything which needs utilities.
+  void setActorStore();
+  SMPActorStore aStore;
+
+  // Per-turn cache for evaluating bargains: each actor's total utility of the
+  // status-quo positions, and each actor's risk attitude.
+  void setBrgnUtilCache();
+  vector<double> aUtilSQ = {};
+  vector<double> nraCache = {};
+
+  // the utility to every actor of position p, as SMPActor::posUtil would give it
+  void posUtils(const VctrPstn & p, vector<double> & u) const;
 
+  // Evaluate the bargains of actor k: the utility to each actor of each bargain,
+  // and the PCE over them. Safe to run concurrently for different k.
   void updateBestBrgnPositions(int k);
 
+  // Then, in actor order, log the results, choose a bargain for each actor,
+  // queue the vote and utility records, and set the actors' positions in s2.
+  void applyBestBrgnPositions();
+
   vector<double> calcVotes(KMatrix w, KMatrix u, int actor) const;
 
   using BrgnValue = tuple<
@@ -347,7 +605,36 @@ private:
   >;
   using BrgnUtils = vector<BrgnUtil>;
   BrgnUtils brgnUtils;
-  std::mutex brgnPosLock;
+
+  // each coordinate an actor changes this turn, and the bargain which moved it,
+  // queued in actor order by applyBestBrgnPositions for the PositionMoves table
+  using PosMove = tuple<
+    unsigned int,  //moving actor
+    unsigned int,  //dimension
+    double,        //previous coordinate, on [0,100]
+    double,        //current coordinate, on [0,100]
+    uint64_t,      //bargain id
+    unsigned int,  //initiator actor
+    unsigned int   //receiver actor
+  >;
+  vector<PosMove> posMoves;
+
+  // the events of this turn's bargaining not yet flushed, one list per actor,
+  // so that each actor's thread appends only to its own
+  vector<vector<BCNEvent>> bcnEvents;
+
+  // first bargain ID of this turn's block (see BargainSMP::idsPerInit)
+  uint64_t brgnID0 = 0;
+
+  // one slot per actor, filled concurrently by updateBestBrgnPositions
+  using BrgnChoice = tuple<
+    KBase::KMatrix,  //u_im, utility to each actor of each of k's bargains
+    KBase::KMatrix,  //coalition strengths between bargains
+    KBase::KMatrix,  //victory probabilities between bargains
+    KBase::KMatrix,  //PCE probability of each bargain
+    BrgnVotes        //votes between bargains, if they are to be recorded
+  >;
+  vector<BrgnChoice> brgnChoices;
 };
 
 class SMPModel : public Model {
@@ -363,11 +650,74 @@ public:
   static double bvUtil(const KMatrix & vd, const  KMatrix & vs, double R);
 
   static std::string runModel(std::vector<bool> sqlFlags,
-      std::string inputDataFile, uint64_t seed, bool saveHist, std::vector<int> modelParams = std::vector<int>());
+      std::string inputDataFile, uint64_t seed, bool saveHist, std::vector<int> modelParams = std::vector<int>(),
+      SMPStopParams stopPrms = SMPStopParams(), unsigned int ensembleSize = 0,
+      unsigned int snapEvery = 0);
 
   // this sets up a standard configuration and runs it
   static void configExec(SMPModel * md0);
 
+  // the stopping criteria configExec uses
+  SMPStopParams stopParams = SMPStopParams();
+
+  // the most recent cycle found by cycle detection: the turn at which it starts,
+  // and its length (1 for a fixed point). The length is 0 if none was found.
+  unsigned int cycleStart = 0;
+  unsigned int cycleLen = 0;
+
+  // If ensembleSize is positive, configExec runs that many replicas with
+  // stochastic state transitions in place of a single run.
+  // Replica r draws from its own PRNG (replica 0 from rng, the rest seeded with
+  // getSeed() + r), so each one follows exactly the path a single stochastic run
+  // with that seed would. Replicas share every state until their draws differ:
+  // a state's bargains are made and assessed once, however many replicas reach it,
+  // and a new state is built only for each distinct set of chosen bargains.
+  // Afterwards, history holds replica 0's path, so the usual tables and reports
+  // describe it, and these hold the number of turns, final positions
+  // ([numDim, numAct], on the [0,1] scale) and last cycle found (start, length)
+  // of every replica. cycleStart and cycleLen are replica 0's.
+  unsigned int ensembleSize = 0;
+  vector<unsigned int> ensembleTurns = {};
+  vector<KMatrix> ensemblePstns = {};
+  vector<tuple<unsigned int, unsigned int>> ensembleCycles = {};
+  static void runEnsemble(SMPModel * md0);
+
+  // If snapEvery is positive, configExec saves a snapshot to snapFile
+  // every snapEvery turns, and after the last one (but not for ensembles).
+  unsigned int snapEvery = 0;
+  string snapFile = "";
+
+  // Check the scenario in the last state of the history against every invariant
+  // of the inputs which the turns otherwise enforce only deep inside them
+  // (saliences, capabilities, positions and ideals, accommodation rows), one actor
+  // per thread, and estimate the cost of running it with the SQL flags, stopping
+  // parameters and ensemble size of this model. Bad data is reported, not thrown.
+  SMPPreflight preflight() const;
+  static void showPreflight(const SMPPreflight & pf);
+  static SMPPreflightMode preflightMode;
+
+  // set once preflight has passed, so that hot paths such as probEduChlg
+  // may skip range checks which valid inputs already guarantee
+  bool prevalidated = false;
+
+  // if not empty, each turn's bargaining events (see BCNEvent) are appended
+  // to this file, one JSON object per line
+  static string eventFile;
+
+  // Save a binary snapshot, in host byte order, of the model (actors, dimensions,
+  // parameters, PRNG state) and of every state in its history (positions and ideals,
+  // plus the accommodation matrix of the last). The data is copied at once, but
+  // written to disk by a background thread, which waitSnapshot joins.
+  // The utility matrices are not saved, as they are large and quick to recompute.
+  void saveSnapshot(string fName);
+  void waitSnapshot();
+
+  // Rebuild a model from a snapshot, so that run() carries on from its last state
+  // exactly as the original run would have. If lastTurn is not negative, the history
+  // is cut back to that turn, e.g. to try other parameters from there; the PRNG
+  // is still as it was when the snapshot was taken.
+  static SMPModel * readSnapshot(string fName, vector<bool> f, int lastTurn = -1);
+
   // read, configure, and run from CSV
   static string csvReadExec(uint64_t seed, string inputCSV, vector<bool> f,
                           vector<int> par=vector<int>());
@@ -375,8 +725,20 @@ public:
   // read, configure, and run from XML
   static string xmlReadExec(string inputXML, vector<bool> f);
 
+  // build and run a random scenario; as with runModel, the model is then
+  // available from getSmpModel until destroyModel is called
   static void randomSMP(unsigned int numA, unsigned int sDim, bool accP, uint64_t s, vector<bool> f);
 
+  // Build a synthetic scenario; the same parameters, seed included, give the same one.
+  static SMPScenario genScenario(const SMPGenParams & gp);
+
+  // Write a scenario for csvRead (which has no accommodation matrix, so only
+  // the identity survives), for xmlRead (the accommodation as iaPair elements,
+  // only those off the identity), or as a snapshot for readSnapshot (smpc --resume).
+  static void writeScenarioCSV(const SMPScenario & sc, string fName);
+  static void writeScenarioXML(const SMPScenario & sc, string fName);
+  static void writeScenarioSnapshot(const SMPScenario & sc, string fName);
+
   static SMPModel * csvRead(string fName, uint64_t s, vector<bool> f);
   static SMPModel * xmlRead(string fName,vector<bool> f);
 
@@ -385,7 +747,8 @@ public:
 	  const KMatrix & pos, // one row per actor, one column per dimension
 	  const KMatrix & sal, // one row per actor, one column per dimension
 	  const KMatrix & accM,
-	  uint64_t s, vector<bool> f, string scenName, string scenDesc);
+	  uint64_t s, vector<bool> f, string scenName, string scenDesc,
+	  bool sqlP = true); // if false, no database is opened, e.g. to just save a snapshot
 
   // print history of each actor in CSV (might want to generalize to arbitrary VctrPstn)
   void showVPHistory() const;
@@ -393,11 +756,18 @@ public:
   void LogInfoTables(); // JAH 20160731
 
   // output the two files needed to draw Sankey diagrams
-  void sankeyOutput(string inputCSV) const;
+  void sankeyOutput(string inputCSV, SankeyFormat fmt = SankeyFormat::Wide) const;
 
   // output the two files needed to draw Sankey diagram for Database
   static void sankeyOutput(string outputFile, string dbName, std::string scenarioId) ;
 
+  // The same for several scenarios (all of them, if scenarioIds is empty), streaming each
+  // table through one ordered query, so the cost is linear in the size of the database.
+  // With Wide, each scenario's files are named outputFile_<scenarioId>_effPow.csv etc.,
+  // unless only one scenario was asked for.
+  static void sankeyOutput(string outputFile, string dbName, const vector<string> & scenarioIds,
+    SankeyFormat fmt = SankeyFormat::Wide);
+
   // number of spatial dimensions in this SMP
   void addDim(string dn);
   unsigned int numDim = 0;
@@ -433,6 +803,19 @@ public:
   static double getQuadMapPoint(const QString &connectionName, const string &scenarioID,
     size_t turn, size_t est_h, size_t aff_k, size_t init_i, size_t rcvr_j);
 
+  /**
+  * Bulk versions of getQuadMapPoint: the value at each (h, k, i, j) in pts, computed
+  * concurrently. The turn's utilities, saliences and capabilities are gathered once,
+  * and from a db with one query per table; the last few turns read are cached.
+  */
+  static vector<double> getQuadMapPoints(size_t t, const vector<QuadMapPt> & pts);
+  static vector<double> getQuadMapPoints(const QString &connectionName, const string &scenarioID,
+    size_t turn, const vector<QuadMapPt> & pts);
+
+  // forget the cached turns, e.g. when a db is opened, as its runs may differ
+  // from those cached under the same connection, scenario and turn
+  static void clearQuadMapCache();
+
   static uint getIterationCount();
 
   static uint getNumActors();
@@ -444,7 +827,7 @@ public:
 protected:
   //sqlite3 *smpDB = nullptr; // keep this protected, to ease multi-threading
   //string scenName = "Scen";
-  static const int NumTables = 5; // TODO : Add one to this num when new table is added
+  static const int NumTables = 7; // TODO : Add one to this num when new table is added
 
   static const int NumSQLLogGrps = 0; // TODO : Add one to this num when new logging group is added
 
@@ -470,10 +853,19 @@ protected:
   SMPBargnModel brgnMod = SMPBargnModel::InitOnlyInterpSMPBM;
   // PWCompInterSMPBM, InitOnlyInterpSMPBM or InitRcvrInterpSMPBM;
 
+  std::thread snapThread;
+
 private:
   void releaseDB();
 
   
+  // one turn's quad-map data, from the history or from a db, and the value at one point of it
+  static shared_ptr<const SMPQuadMapTurn> quadMapTurn(size_t t);
+  static shared_ptr<const SMPQuadMapTurn> quadMapTurn(const QString &connectionName,
+    const string &scenarioID, size_t turn);
+  static double quadMapPoint(const SMPQuadMapTurn & qt, size_t est_h, size_t aff_k, size_t init_i, size_t rcvr_j);
+  static vector<double> quadMapPoints(const SMPQuadMapTurn & qt, const vector<QuadMapPt> & pts);
+
   static tuple<double, double> calcContribs(VotingRule vrCltn, double wi, double wj, tuple<double, double, double, double>(utils));
 
  };
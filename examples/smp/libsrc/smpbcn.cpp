@@ -25,6 +25,9 @@
 //
 // --------------------------------------------
 
+#include <algorithm>
+#include <fstream>
+#include <sstream>
 #include "smp.h"
 #include <QSqlQuery>
 #include <QVariant>
@@ -74,27 +77,28 @@ ostream& operator<< (ostream& os, const InterVecBrgn& ivb) {
 
 // --------------------------------------------
 
-BargainSMP::BargainSMP(const SMPActor* ai, const SMPActor* ar, const VctrPstn & pi, const VctrPstn & pr) {
+BargainSMP::BargainSMP(const SMPActor* ai, const SMPActor* ar, const VctrPstn & pi, const VctrPstn & pr) :
+  BargainSMP(ai, ar, pi, pr, BargainSMP::highestBargainID++) {
+}
+
+
+BargainSMP::BargainSMP(const SMPActor* ai, const SMPActor* ar, const VctrPstn & pi, const VctrPstn & pr, uint64_t id) {
   if (nullptr == ai) {
     throw KException("BargainSMP::BargainSMP: Initiator actor is null");
   }
   if (nullptr == ar) {
     throw KException("BargainSMP::BargainSMP: Receiver actor is null");
   }
+  if ((ai->getID() < 0) || (ar->getID() < 0)) {
+    throw KException("BargainSMP::BargainSMP: actor has not been added to a model");
+  }
   actInit = ai;
   actRcvr = ar;
+  initNdx = ((unsigned int)(ai->getID()));
+  rcvrNdx = ((unsigned int)(ar->getID()));
   posInit = pi;
   posRcvr = pr;
-  myBargainID = BargainSMP::highestBargainID++;
-}
-
-BargainSMP::~BargainSMP() {
-  actInit = nullptr;
-  actRcvr = nullptr;
-  posInit = VctrPstn(KMatrix(0, 0));
-  posRcvr = VctrPstn(KMatrix(0, 0));
-  auto mbid = myBargainID;
-  myBargainID = 0;
+  myBargainID = id;
 }
 
 
@@ -108,6 +112,8 @@ uint64_t BargainSMP::getID() const {
  * combination is getting calculated and recorded in a separate method
  */
 void SMPState::calcUtils(unsigned int i, unsigned int bestJ ) const { // i == actor id
+  static const unsigned int profSite = KBase::Profiler::site("calcUtils");
+  KBase::ProfTimer profTimer(profSite);
   const unsigned int na = model->numAct;
   const bool recordTmpSQLP = true;  // Record this in SQLite
   auto pFn = [this, recordTmpSQLP](unsigned int h, unsigned int k, unsigned int i, unsigned int j) {
@@ -159,14 +165,49 @@ void SMPState::calcUtils(unsigned int i, unsigned int bestJ ) const { // i == ac
 
 // --------------------------------------------
 eduChlgsI SMPState::bestChallengeUtils(unsigned int i) const {
+  static const unsigned int profSite = KBase::Profiler::site("bestChallengeUtils");
+  KBase::ProfTimer profTimer(profSite);
   const unsigned int na = model->numAct;
   const bool recordTmpSQLP = true;  // Record this in SQLite
   eduChlgsI eduI;
+  if (model->sqlFlags[2]) { // every challenge gets recorded
+    for (unsigned int j = 0; j < na; j++) {
+      if( i != j ) {
+          eduI[j] = probEduChlg(i, i, i, j, recordTmpSQLP);
+      }
+    }
+    return eduI;
+  }
+
+  // Only the best challenge is used, so prune. i's gain from challenging j is a mix
+  // of winning (2*u_ii) and losing (2*u_ij), less the status quo (u_ii + u_ij),
+  // so it can be no more than |u_ii - u_ij|. Take targets in decreasing order of
+  // that bound, and stop when it can not beat (or tie) the best gain found so far.
+  // The slack covers round-off in probEduChlg's arithmetic.
+  const double slack = 1E-12;
+  const KMatrix & ui = aUtil[i];
+  auto bnds = vector<tuple<double, unsigned int>>();
   for (unsigned int j = 0; j < na; j++) {
-    if( i != j ) {
-        eduI[j] = probEduChlg(i, i, i, j, recordTmpSQLP);
+    if (i != j) {
+      bnds.push_back(tuple<double, unsigned int>(fabs(ui(i, i) - ui(i, j)), j));
     }
   }
+  auto gtr = [](const tuple<double, unsigned int> & b1, const tuple<double, unsigned int> & b2) {
+    return get<0>(b1) > get<0>(b2);
+  };
+  std::stable_sort(bnds.begin(), bnds.end(), gtr);
+
+  double bestEU = -1.0;
+  for (const auto & bj : bnds) {
+    const double ub = get<0>(bj) + slack;
+    if ((ub <= minSigEDU) || (ub < bestEU)) {
+      break;
+    }
+    const unsigned int j = get<1>(bj);
+    eduI[j] = probEduChlg(i, i, i, j, recordTmpSQLP);
+    const double edu = get<1>(eduI[j]);
+    bestEU = (bestEU < edu) ? edu : bestEU;
+  }
 
   return eduI;
 }
@@ -195,17 +236,7 @@ vector<double> SMPState::calcVotes(KMatrix w, KMatrix u, int k) const
 }
 
 SMPState* SMPState::doBCN() {
-  const unsigned int na = model->numAct;
-  brgns.resize(na);
-  for (unsigned int i = 0; i < na; i++) {
-    brgns[i] = vector<BargainSMP*>();
-  }
-
-  auto thrBCN = [this](unsigned int i) {
-    this->doBCN(i);
-  };
-
-  KBase::groupThreads(thrBCN, 0, na - 1);
+  makeBargains();
 
   model->beginDBTransaction();
 
@@ -238,20 +269,16 @@ SMPState* SMPState::doBCN() {
 
   //model->commitDBTransaction();
 
-  LOG(INFO) << "Bargains to be resolved";
-  showBargains(brgns);
+  if (KTRACE_ON(Medium)) {
+    LOG(INFO) << "Bargains to be resolved";
+    showBargains();
+  }
 
-  w = actrCaps();
-  LOG(INFO) << "w:";
-  w.mPrintf(" %6.2f ");
+  assessBargains();
 
   s2 = new SMPState(model);
-
-  auto thrCalcPosts = [this](unsigned int k) {
-    this->updateBestBrgnPositions(k);
-  };
-
-  KBase::groupThreads(thrCalcPosts, 0, na - 1);
+  applyBestBrgnPositions();
+  flushBCNEvents();
 
   //model->beginDBTransaction();
 
@@ -278,58 +305,152 @@ SMPState* SMPState::doBCN() {
 
   // record data so far
   if (model->sqlFlags[4]) {
-    updateBargnTable(brgns, actorBargains, actorMaxBrgNdx);
+    updateBargnTable(actorBargains, actorMaxBrgNdx);
+    recordPositionMoves();
   }
+  posMoves.clear();
 
   model->commitDBTransaction();
 
-  // Some bargains are nullptr, and there are two copies of every non-nullptr randomly
-  // arranged. If we delete them as we find them, then the second occurance will be corrupted,
-  // so the code crashes when it tries to access the memory to see if it matches something
-  // already deleted. Hence, we scan them all, building a list of unique bargains,
-  // then delete those in order.
-  auto uBrgns = vector<BargainSMP*>();
+  releaseBargains();
+  setSuccessor(s2);
+  return s2;
+}
 
-  for (unsigned int i = 0; i < brgns.size(); i++) {
-    auto ai = ((const SMPActor*)(model->actrs[i]));
-    for (unsigned int j = 0; j < brgns[i].size(); j++) {
-      BargainSMP* bij = brgns[i][j];
-      if (nullptr != bij) {
-        if (ai == bij->actInit) {
-          uBrgns.push_back(bij); // this is the initiator's copy, so save it for deletion
-        }
+void SMPState::makeBargains() {
+  const unsigned int na = model->numAct;
+  brgnArena = vector<BargainSMP>();
+  brgnArena.reserve(3 * na); // status quo, plus at most two per challenge
+  brgns = vector< vector <unsigned int> >(na);
+  bcnEvents = vector<vector<BCNEvent>>(na);
+  brgnID0 = BargainSMP::highestBargainID;
+
+  auto thrBCN = [this](unsigned int i) {
+    this->doBCN(i);
+  };
+
+  KBase::groupThreads(thrBCN, 0, na - 1);
+  BargainSMP::highestBargainID = brgnID0 + BargainSMP::idsPerInit * na;
+
+  // The threads queue bargains in whatever order they finish, so put each
+  // actor's list in initiator order (each initiator's own bargains are already
+  // in the order it made them). Otherwise a stochastic choice among them
+  // would depend on the thread schedule, not just on the seed.
+  for (auto & bk : brgns) {
+    std::sort(bk.begin(), bk.end(), [this](unsigned int m, unsigned int n) {
+      const unsigned int im = brgnArena[m].initNdx;
+      const unsigned int in = brgnArena[n].initNdx;
+      return (im < in) || ((im == in) && (m < n));
+    });
+  }
+  // likewise the rows for the Bargn and BargnCoords tables, by bargain ID,
+  // which follows the initiators' order
+  std::stable_sort(brgnVals.begin(), brgnVals.end(), [](const BrgnValue & a, const BrgnValue & b) {
+    return get<1>(a) < get<1>(b);
+  });
+  std::stable_sort(brgnCos.begin(), brgnCos.end(), [](const BrgnCoord & a, const BrgnCoord & b) {
+    return get<1>(a) < get<1>(b);
+  });
+
+  flushBCNEvents();
+  return;
+}
+
+void SMPState::flushBCNEvents() {
+  std::ofstream ef;
+  if (!SMPModel::eventFile.empty()) {
+    ef.open(SMPModel::eventFile, std::ios::app);
+    if (!ef.is_open()) {
+      throw KException("SMPState::flushBCNEvents: could not open " + SMPModel::eventFile);
+    }
+  }
+  const string scen = model->getScenarioID();
+  for (auto & evs : bcnEvents) {
+    for (const auto & e : evs) {
+      if (!e.text.empty()) {
+        LOG(INFO) << e.text;
+      }
+      if (ef.is_open()) {
+        ef << KBase::getFormattedString(
+          "{\"scenario\":\"%s\",\"turn\":%u,\"event\":\"%s\",\"init\":%u,\"rcvr\":%u,\"bargain\":%llu,\"value\":%.6f}",
+          scen.c_str(), e.turn, BCNEventKindNames[static_cast<uint8_t>(e.kind)].c_str(),
+          e.init, e.rcvr, (unsigned long long)e.brgnID, e.value) << "\n";
       }
-      brgns[i][j] = nullptr; // either way, null it out.
     }
+    evs.clear();
   }
+  return;
+}
 
-  for (auto b : uBrgns) {
-    //int aI = model->actrNdx(b->actInit);
-    //int aR = model->actrNdx(b->actRcvr);
-    //printf("Delete bargain [%2i:%2i] \n", aI, aR);
-    delete b;
+void SMPState::assessBargains() {
+  const unsigned int na = model->numAct;
+  w = actrCaps();
+  if (KTRACE_ON(High)) {
+    LOG(INFO) << "w:";
+    w.mPrintf(" %6.2f ");
   }
 
+  setBrgnUtilCache();
+  brgnChoices = vector<BrgnChoice>(na);
+  auto thrCalcPosts = [this](unsigned int k) {
+    this->updateBestBrgnPositions(k);
+  };
+
+  KBase::groupThreads(thrCalcPosts, 0, na - 1);
+  return;
+}
+
+void SMPState::releaseBargains() {
+  // All of this turn's bargains have been resolved, so release them at once.
+  brgnChoices.clear();
+  brgns = vector< vector <unsigned int> >();
+  brgnArena = vector<BargainSMP>();
+  return;
+}
+
+void SMPState::releaseTurnData() {
+  // Nothing more will be stepped from this state, or reported about it,
+  // so only its positions (and ideals) are still needed.
+  releaseBargains();
+  aUtil = vector<KMatrix>();
+  tpvData.clear();
+  phijData.clear();
+  euData.clear();
+  vDiff = KMatrix();
+  rnProb = KMatrix();
+  nra = KMatrix();
+  aUtilSQ = vector<double>();
+  nraCache = vector<double>();
+  brgnVals = BrgnValues();
+  brgnCos = BrgnCos();
+  brgnVotes = vector<BrgnVotes>();
+  brgnUtils = BrgnUtils();
+  posMoves = vector<PosMove>();
+  bcnEvents = vector<vector<BCNEvent>>();
+  return;
+}
+
+void SMPState::setSuccessor(SMPState* sn) const {
   // TODO: this really should do all the assessment: ueIndices, rnProb, all U^h_{ij}, raProb
-  s2->setUENdx();
+  sn->setUENdx();
 
   if (0 == accomodate.numC()) { // nothing to copy
-    s2->setAccomodate(1.0); // set to identity matrix
+    sn->setAccomodate(1.0); // set to identity matrix
   }
   else {
-    s2->setAccomodate(accomodate);
+    sn->setAccomodate(accomodate);
   }
 
   if (0 == ideals.size()) { // nothing to copy
-    s2->idealsFromPstns(); // set s2's current ideals to s2's current positions
+    sn->idealsFromPstns(); // set sn's current ideals to sn's current positions
   }
   else {
-    s2->ideals = ideals; // copy s1's old ideals
+    sn->ideals = ideals; // copy s1's old ideals
   }
-  s2->newIdeals(); // adjust s2 ideals toward new ones
-  double ipDist = s2->posIdealDist(ReportingLevel::Medium);
+  sn->newIdeals(); // adjust sn ideals toward new ones
+  double ipDist = sn->posIdealDist(ReportingLevel::Medium);
   LOG(INFO) << KBase::getFormattedString("rms (pstn, ideal) = %.5f", ipDist);
-  return s2;
+  return;
 }
 
 void SMPState::doBCN(unsigned int i) {
@@ -339,10 +460,10 @@ void SMPState::doBCN(unsigned int i) {
     const InterVecBrgn ivb = smod->ivBrgn;
     const SMPBargnModel bMod = smod->brgnMod;
 
-    auto sqBrgnI = new BargainSMP(ai, ai, *posI, *posI);
-    brgnsLock.lock();
-    brgns[i].push_back(sqBrgnI);
-    brgnsLock.unlock();
+    const uint64_t id0 = brgnID0 + BargainSMP::idsPerInit * i; // this initiator's block of IDs
+    auto sqBrgnI = vector<BargainSMP>{ BargainSMP(ai, ai, *posI, *posI, id0) };
+    const uint64_t sqBrgnID = sqBrgnI[0].getID();
+    addBargains(sqBrgnI);
 
     // before we can log this bargain, we need to get the group ID for this table
     // so then we can get the flag to populate the table or not
@@ -368,7 +489,7 @@ void SMPState::doBCN(unsigned int i) {
     if (model->sqlFlags[grpID])
     {
       brgnValsLock.lock();
-      brgnVals.push_back(BrgnValue(turn, sqBrgnI->getID(), i, i, 0));
+      brgnVals.push_back(BrgnValue(turn, sqBrgnID, i, i, 0));
       brgnValsLock.unlock();
     }
 
@@ -388,7 +509,12 @@ void SMPState::doBCN(unsigned int i) {
       auto aj = ((const SMPActor*)(model->actrs[j]));
       auto posJ = ((const VctrPstn*)pstns[j]);
 
-      std::thread thr(&SMPState::calcUtils, this, i, bestJ);
+      // the other perspectives on each challenge are only wanted for the challenge tables
+      const bool chlgTablesP = model->sqlFlags[2];
+      std::thread thr;
+      if (chlgTablesP) {
+        thr = std::thread(&SMPState::calcUtils, this, i, bestJ);
+      }
 
       // make the variables local to lexical scope of this block.
       // for testing, calculate and print out a block of data showing each's perspective
@@ -407,9 +533,9 @@ void SMPState::doBCN(unsigned int i) {
       auto est_jjij = pFn(j, j, i, j); // J's estimate of the effect on J of I->J
 
       // interpolate a bargain from I's perspective
-      BargainSMP* brgnIIJ = SMPActor::interpolateBrgn(ai, aj, posI, posJ, piiJ, 1 - piiJ, ivb);
-      const int nai = model->actrNdx(brgnIIJ->actInit);
-      const int naj = model->actrNdx(brgnIIJ->actRcvr);
+      BargainSMP brgnIIJ = SMPActor::interpolateBrgn(ai, aj, posI, posJ, piiJ, 1 - piiJ, ivb, id0 + 1);
+      const unsigned int nai = brgnIIJ.initNdx;
+      const unsigned int naj = brgnIIJ.rcvrNdx;
       // verify that identities match up as expected
       if (nai != i) {
         throw KException("SMPState::doBCN(i): Actor i's identity didn't match");
@@ -421,89 +547,88 @@ void SMPState::doBCN(unsigned int i) {
 
       // interpolate a bargain from targeted J's perspective
       double pjiJ = get<1>(Vjij); // j's estimate of the probability that i defeats j
-      BargainSMP* brgnJIJ = SMPActor::interpolateBrgn(ai, aj, posI, posJ, pjiJ, 1 - pjiJ, ivb);
+      BargainSMP brgnJIJ = SMPActor::interpolateBrgn(ai, aj, posI, posJ, pjiJ, 1 - pjiJ, ivb, id0 + 2);
 
       // calcluate weights as capability times salience
-      double sci = brgnIIJ->actInit->sCap;
-      double svi = sum(brgnIIJ->actInit->vSal);
+      double sci = aStore.caps[nai];
+      double svi = aStore.salSum[nai];
       double wi = sci*svi;
-      double scj = brgnJIJ->actInit->sCap;
-      double svj = sum(brgnIIJ->actRcvr->vSal);
+      double scj = aStore.caps[brgnJIJ.initNdx];
+      double svj = aStore.salSum[naj];
       double wj = scj*svj;
 
       // create a new bargain whose positions are the weighted averages
-      auto bpi = VctrPstn((wi*brgnIIJ->posInit + wj*brgnJIJ->posInit) / (wi + wj));
-      auto bpj = VctrPstn((wi*brgnIIJ->posRcvr + wj*brgnJIJ->posRcvr) / (wi + wj));
-      BargainSMP *brgnIJ = new  BargainSMP(brgnIIJ->actInit, brgnIIJ->actRcvr, bpi, bpj);
-
-      mtxLock.lock();
-      LOG(INFO) << KBase::getFormattedString(
-        "In turn %i actor %u has most advantageous target %u worth %.3f",
-        turn, i, j, bestEU);
-
-      // Look for counter-intuitive cases
-      if (piiJ < 0.5) {
-        LOG(INFO) << "turn" << turn << ","
-            << "i" << i << ","
-            << "j" << j << ","
-            << "bestEU worth" << bestEU << ","
-            << "piiJ " << piiJ;
-      }
-
-      // I's estimate of the effect on I of I->J
-      LOG(INFO) << KBase::getFormattedString(
-        "Est by %2u of prob %.4f that [%2u>%2u], with expected gain to %2u of %+.4f",
-        i, piiJ, i, j, i, get<2>(chlgI));
+      auto bpi = VctrPstn((wi*brgnIIJ.posInit + wj*brgnJIJ.posInit) / (wi + wj));
+      auto bpj = VctrPstn((wi*brgnIIJ.posRcvr + wj*brgnJIJ.posRcvr) / (wi + wj));
+      BargainSMP brgnIJ = BargainSMP(brgnIIJ.actInit, brgnIIJ.actRcvr, bpi, bpj, id0 + 3);
+
+      // The report is recorded with the event, to be logged in actor order
+      // once every initiator is done (see flushBCNEvents).
+      BCNEvent chosen;
+      chosen.kind = BCNEventKind::ChallengeChosen;
+      chosen.turn = turn;
+      chosen.init = i;
+      chosen.rcvr = j;
+      chosen.value = bestEU;
+      std::ostringstream tb;
+      if (KTRACE_ON(High)) {
+        tb << KBase::getFormattedString(
+          "In turn %i actor %u has most advantageous target %u worth %.3f",
+          turn, i, j, bestEU) << "\n";
+
+        // Look for counter-intuitive cases
+        if (piiJ < 0.5) {
+          tb << "turn " << turn << ", i " << i << ", j " << j
+             << ", bestEU worth " << bestEU << ", piiJ " << piiJ << "\n";
+        }
 
-      // I's estimate of the effect on J of I->J
-      LOG(INFO) << KBase::getFormattedString(
+        // I's estimate of the effect on I of I->J
+        tb << KBase::getFormattedString(
           "Est by %2u of prob %.4f that [%2u>%2u], with expected gain to %2u of %+.4f",
-          i, get<0>(est_ijij), i, j, j, get<1>(est_ijij));
+          i, piiJ, i, j, i, get<2>(chlgI)) << "\n";
 
-      // J's estimate of the effect on I of I->J
-      LOG(INFO) << KBase::getFormattedString(
+        // I's estimate of the effect on J of I->J
+        tb << KBase::getFormattedString(
           "Est by %2u of prob %.4f that [%2u>%2u], with expected gain to %2u of %+.4f",
-          j, get<0>(Vjij), i, j, i, get<1>(Vjij));
+          i, get<0>(est_ijij), i, j, j, get<1>(est_ijij)) << "\n";
 
-      // J's estimate of the effect on J of I->J
-      LOG(INFO) << KBase::getFormattedString(
+        // J's estimate of the effect on I of I->J
+        tb << KBase::getFormattedString(
           "Est by %2u of prob %.4f that [%2u>%2u], with expected gain to %2u of %+.4f",
-          j, get<0>(est_jjij), i, j, j, get<1>(est_jjij));
-      LOG(INFO) << "";
-
-      // Bargain positions from i's perspective
-      LOG(INFO) << "Bargain" << showOneBargain(brgnIIJ)
-        << "from" << std::to_string(i) + "'s perspective (brgnIIJ)";
-      //LOG(INFO) << i << "proposes" << i << "adopt:";
-      string proposal = string("   ") + std::to_string(i) + " proposes " + std::to_string(i) + " adopt: ";
-      (KBase::trans(brgnIIJ->posInit) * 100.0).mPrintf(" %.3f ", proposal); // print on the scale of [0,100]
-      //LOG(INFO) << i << "proposes" << j << "adopt:";
-      proposal = string("   ") + std::to_string(i) + " proposes " + std::to_string(j) + " adopt: ";
-      (KBase::trans(brgnIIJ->posRcvr) * 100.0).mPrintf(" %.3f ", proposal); // print on the scale of [0,100]
-      LOG(INFO) << "";
-
-      // Bargain positions from j's perspective
-      LOG(INFO) << "Bargain" << showOneBargain(brgnJIJ)
-        << "from" << std::to_string(j) + "'s perspective (brgnIIJ)";
-      //LOG(INFO) << j << "proposes" << i << "adopt:";
-      proposal = string("   ") + std::to_string(j) + " proposes " + std::to_string(i) + " adopt: ";
-      (KBase::trans(brgnJIJ->posInit) * 100.0).mPrintf(" %.3f ", proposal); // print on the scale of [0,100]
-      //LOG(INFO) << j << "proposes" << j << "adopt:";
-      proposal = string("   ") + std::to_string(j) + " proposes " + std::to_string(j) + " adopt: ";
-      (KBase::trans(brgnJIJ->posRcvr) * 100.0).mPrintf(" %.3f ", proposal); // print on the scale of [0,100]
-      LOG(INFO) << "";
-
-      // Power-weighted compromise
-      LOG(INFO) << "Power-weighted compromise" << showOneBargain(brgnIJ) << "bargain (brgnIJ)";
-      //LOG(INFO) << "  Compromise proposes" << i << "adopt: ";
-      proposal = string("   ") + string("  compromise proposes ") + std::to_string(i) + " adopt: ";
-      (KBase::trans(brgnIJ->posInit) * 100.0).mPrintf(" %.3f ", proposal); // print on the scale of [0,100]
-
-      //LOG(INFO) << "  Compromise proposes" << j << "adopt: ";
-      proposal = string("   ") + string("  compromise proposes ") + std::to_string(j) + " adopt: ";
-      (KBase::trans(brgnIJ->posRcvr) * 100.0).mPrintf(" %.3f ", proposal); // print on the scale of [0,100]
-      LOG(INFO) << "";
+          j, get<0>(Vjij), i, j, i, get<1>(Vjij)) << "\n";
 
+        // J's estimate of the effect on J of I->J
+        tb << KBase::getFormattedString(
+          "Est by %2u of prob %.4f that [%2u>%2u], with expected gain to %2u of %+.4f",
+          j, get<0>(est_jjij), i, j, j, get<1>(est_jjij)) << "\n";
+        tb << "\n";
+
+        // Bargain positions from i's perspective, on the scale of [0,100]
+        tb << "Bargain " << showOneBargain(&brgnIIJ)
+           << " from " << i << "'s perspective (brgnIIJ)\n";
+        string proposal = string("   ") + std::to_string(i) + " proposes " + std::to_string(i) + " adopt: ";
+        tb << (KBase::trans(brgnIIJ.posInit) * 100.0).mFormat(" %.3f ", proposal) << "\n";
+        proposal = string("   ") + std::to_string(i) + " proposes " + std::to_string(j) + " adopt: ";
+        tb << (KBase::trans(brgnIIJ.posRcvr) * 100.0).mFormat(" %.3f ", proposal) << "\n";
+        tb << "\n";
+
+        // Bargain positions from j's perspective
+        tb << "Bargain " << showOneBargain(&brgnJIJ)
+           << " from " << j << "'s perspective (brgnIIJ)\n";
+        proposal = string("   ") + std::to_string(j) + " proposes " + std::to_string(i) + " adopt: ";
+        tb << (KBase::trans(brgnJIJ.posInit) * 100.0).mFormat(" %.3f ", proposal) << "\n";
+        proposal = string("   ") + std::to_string(j) + " proposes " + std::to_string(j) + " adopt: ";
+        tb << (KBase::trans(brgnJIJ.posRcvr) * 100.0).mFormat(" %.3f ", proposal) << "\n";
+        tb << "\n";
+
+        // Power-weighted compromise
+        tb << "Power-weighted compromise " << showOneBargain(&brgnIJ) << " bargain (brgnIJ)\n";
+        proposal = string("   ") + string("  compromise proposes ") + std::to_string(i) + " adopt: ";
+        tb << (KBase::trans(brgnIJ.posInit) * 100.0).mFormat(" %.3f ", proposal) << "\n";
+        proposal = string("   ") + string("  compromise proposes ") + std::to_string(j) + " adopt: ";
+        tb << (KBase::trans(brgnIJ.posRcvr) * 100.0).mFormat(" %.3f ", proposal) << "\n";
+        tb << "\n";
+      }
 
       // TODO: make one-perspective an option.
       // For now, emulate it by swapping
@@ -512,33 +637,44 @@ void SMPState::doBCN(unsigned int i) {
       //brgnIJ = tIIJ;
       //brgnIIJ = tIJ;
 
-      LOG(INFO) << "Using" << bMod << "to form proposed bargains";
-      mtxLock.unlock();
+      if (KTRACE_ON(Medium)) {
+        tb << "Using " << bMod << " to form proposed bargains";
+        chosen.text = tb.str();
+      }
+      bcnEvents[i].push_back(chosen);
+
+      auto proposed = [this, i, j, bestEU](const BargainSMP & b) {
+        BCNEvent e;
+        e.kind = BCNEventKind::BargainProposed;
+        e.turn = turn;
+        e.init = i;
+        e.rcvr = j;
+        e.brgnID = b.getID();
+        e.value = bestEU;
+        bcnEvents[i].push_back(e);
+      };
+
       switch (bMod) {
       case SMPBargnModel::InitOnlyInterpSMPBM:
         // record the only one used into SQLite JAH 20160802 use the flag
         if(model->sqlFlags[grpID])
         {
           brgnValsLock.lock();
-          brgnVals.push_back(BrgnValue(turn, brgnIIJ->getID(), i, j, bestEU));
+          brgnVals.push_back(BrgnValue(turn, brgnIIJ.getID(), i, j, bestEU));
           brgnValsLock.unlock();
         }
         if(model->sqlFlags[3])
         {          
           brgnCosLock.lock();
-          brgnCos.push_back(BrgnCoord(turn, brgnIIJ->getID(), brgnIIJ->posInit, brgnIIJ->posRcvr));
+          brgnCos.push_back(BrgnCoord(turn, brgnIIJ.getID(), brgnIIJ.posInit, brgnIIJ.posRcvr));
           brgnCosLock.unlock();
         }
         // record this one onto BOTH the initiator and receiver queues
-        brgnsLock.lock();
-        brgns[i].push_back(brgnIIJ); // initiator's copy, delete only it later
-        brgns[j].push_back(brgnIIJ); // receiver's copy, just null it out later
-        brgnsLock.unlock();
-        // clean up unused
-        delete brgnIJ;
-        brgnIJ = nullptr;
-        delete brgnJIJ;
-        brgnJIJ = nullptr;
+        proposed(brgnIIJ);
+        {
+          auto used = vector<BargainSMP>{ brgnIIJ };
+          addBargains(used);
+        }
         break;
 
 
@@ -547,27 +683,24 @@ void SMPState::doBCN(unsigned int i) {
         if(model->sqlFlags[grpID])
         {
           brgnValsLock.lock();
-          brgnVals.push_back(BrgnValue(turn, brgnIIJ->getID(), i, j, bestEU));
-          brgnVals.push_back(BrgnValue(turn, brgnJIJ->getID(), i, j, bestEU));
+          brgnVals.push_back(BrgnValue(turn, brgnIIJ.getID(), i, j, bestEU));
+          brgnVals.push_back(BrgnValue(turn, brgnJIJ.getID(), i, j, bestEU));
           brgnValsLock.unlock();
         }
         if(model->sqlFlags[3])
         {
           brgnCosLock.lock();
-          brgnCos.push_back(BrgnCoord(turn, brgnIIJ->getID(), brgnIIJ->posInit, brgnIIJ->posRcvr));
-          brgnCos.push_back(BrgnCoord(turn, brgnJIJ->getID(), brgnJIJ->posInit, brgnJIJ->posRcvr));
+          brgnCos.push_back(BrgnCoord(turn, brgnIIJ.getID(), brgnIIJ.posInit, brgnIIJ.posRcvr));
+          brgnCos.push_back(BrgnCoord(turn, brgnJIJ.getID(), brgnJIJ.posInit, brgnJIJ.posRcvr));
           brgnCosLock.unlock();
         }
         // record these both onto BOTH the initiator and receiver queues
-        brgnsLock.lock();
-        brgns[i].push_back(brgnIIJ); // initiator's copy, delete only it later
-        brgns[i].push_back(brgnJIJ); // initiator's copy, delete only it later
-        brgns[j].push_back(brgnIIJ); // receiver's copy, just null it out later
-        brgns[j].push_back(brgnJIJ); // receiver's copy, just null it out later
-        brgnsLock.unlock();
-        // clean up unused
-        delete brgnIJ;
-        brgnIJ = nullptr;
+        proposed(brgnIIJ);
+        proposed(brgnJIJ);
+        {
+          auto used = vector<BargainSMP>{ brgnIIJ, brgnJIJ };
+          addBargains(used);
+        }
         break;
 
 
@@ -576,25 +709,21 @@ void SMPState::doBCN(unsigned int i) {
         if(model->sqlFlags[grpID])
         {
           brgnValsLock.lock();
-          brgnVals.push_back(BrgnValue(turn, brgnIJ->getID(), i, j, bestEU));
+          brgnVals.push_back(BrgnValue(turn, brgnIJ.getID(), i, j, bestEU));
           brgnValsLock.unlock();
         }
         if(model->sqlFlags[3])
         {
           brgnCosLock.lock();
-          brgnCos.push_back(BrgnCoord(turn, brgnIJ->getID(), brgnIJ->posInit, brgnIJ->posRcvr));
+          brgnCos.push_back(BrgnCoord(turn, brgnIJ.getID(), brgnIJ.posInit, brgnIJ.posRcvr));
           brgnCosLock.unlock();
         }
         // record this one onto BOTH the initiator and receiver queues
-        brgnsLock.lock();
-        brgns[i].push_back(brgnIJ); // initiator's copy, delete only it later
-        brgns[j].push_back(brgnIJ); // receiver's copy, just null it out later
-        brgnsLock.unlock();
-        // clean up unused
-        delete brgnIIJ;
-        brgnIIJ = nullptr;
-        delete brgnJIJ;
-        brgnJIJ = nullptr;
+        proposed(brgnIJ);
+        {
+          auto used = vector<BargainSMP>{ brgnIJ };
+          addBargains(used);
+        }
         break;
 
       default:
@@ -603,200 +732,327 @@ void SMPState::doBCN(unsigned int i) {
         throw KException("SMPState::doBCN(i): unrecognized SMPBargnModel");
       }
 
-      thr.join();
+      if (chlgTablesP) {
+        thr.join();
+      }
     }
     else {
-      LOG(INFO) << "In turn" << turn << "Actor" << i << "has no advantageous targets";
+      BCNEvent none;
+      none.kind = BCNEventKind::NoTarget;
+      none.turn = turn;
+      none.init = i;
+      none.rcvr = i;
+      if (KTRACE_ON(Medium)) {
+        none.text = KBase::getFormattedString("In turn %u Actor %u has no advantageous targets", turn, i);
+      }
+      bcnEvents[i].push_back(none);
     }
 }
 
-void SMPState::updateBestBrgnPositions(int k) {
-  auto ndxMaxProb = [](const KMatrix & cv) {
-    const double pTol = 1E-8;
-    if (fabs(KBase::sum(cv) - 1.0) >= pTol) {
-      throw KException("SMPState::updateBestBrgnPositions: Sum of cv is greater than 1");
-    }
-    if (0 == cv.numR()) {
-      throw KException("SMPState::updateBestBrgnPositions: cv doesn't have records");
+void SMPState::addBargains(vector<BargainSMP> & bs) {
+  brgnsLock.lock();
+  if (brgnArena.capacity() < brgnArena.size() + bs.size()) {
+    // growing would move bargains other threads may be reading
+    brgnsLock.unlock();
+    throw KException("SMPState::addBargains: bargain arena is full");
+  }
+  const unsigned int n0 = brgnArena.size();
+  for (auto & b : bs) {
+    brgnArena.push_back(std::move(b));
+  }
+  for (unsigned int n = n0; n < brgnArena.size(); n++) {
+    brgns[brgnArena[n].initNdx].push_back(n);
+  }
+  for (unsigned int n = n0; n < brgnArena.size(); n++) {
+    if (brgnArena[n].rcvrNdx != brgnArena[n].initNdx) {
+      brgns[brgnArena[n].rcvrNdx].push_back(n);
     }
-    if (1 != cv.numC()) {
-      throw KException("SMPState::updateBestBrgnPositions: cv must be a column matrix");
+  }
+  brgnsLock.unlock();
+  return;
+}
+
+void SMPState::setBrgnUtilCache() {
+  const unsigned int na = model->numAct;
+  if (na != aUtil.size()) {
+    throw KException("SMPState::setBrgnUtilCache: aUtil must be set first");
+  }
+  if (na != aStore.numAct) {
+    throw KException("SMPState::setBrgnUtilCache: actor store must be set first");
+  }
+  aUtilSQ = vector<double>(na, 0.0);
+  nraCache = vector<double>(na, 0.0);
+  for (unsigned int i = 0; i < na; i++) {
+    double uSQ = 0.0;
+    for (unsigned int n = 0; n < na; n++) {
+      // i's estimate of the utility to i of position n, i.e. the true value
+      uSQ = uSQ + aUtil[i](i, n);
     }
-    auto ndxIJ = ndxMaxAbs(cv);
-    unsigned int iMax = get<0>(ndxIJ);
-    return iMax;
-  };
+    aUtilSQ[i] = uSQ;
+    nraCache[i] = aNRA(i);
+  }
+  return;
+}
+
 
-  // what is the utility to actor nai of the state resulting after
-  // the nbj-th bargain of the k-th actor is implemented?
-  auto brgnUtil = [this](unsigned int nk, unsigned int nai, unsigned int nbj) {
-    const unsigned int na = model->numAct;
-    BargainSMP * b = brgns[nk][nbj];
-    if (nullptr == b) {
-      throw KException("SMPState::updateBestBrgnPositions: bargain smp pointer is null");
+void SMPState::posUtils(const VctrPstn & p, vector<double> & u) const {
+  // the same arithmetic as SMPActor::posUtil, for every actor at once
+  const unsigned int na = nraCache.size();
+  const unsigned int nd = p.numR();
+  if ((na != aStore.numAct) || (nd != aStore.numDim)) {
+    throw KException("SMPState::posUtils: position has the wrong number of dimensions");
+  }
+  u.resize(na);
+  for (unsigned int i = 0; i < na; i++) {
+    const double * idl = &(aStore.ideal[i * nd]);
+    const double * sal = &(aStore.sal[i * nd]);
+    double dsSqr = 0.0;
+    for (unsigned int d = 0; d < nd; d++) {
+      const double ds = (idl[d] - p(d, 0)) * sal[d];
+      dsSqr = dsSqr + (ds * ds);
     }
-    double uAvrg = 0.0;
+    u[i] = SMPModel::bsUtil(sqrt(dsSqr / aStore.salSq[i]), nraCache[i]);
+  }
+  return;
+}
+
+
+void SMPState::updateBestBrgnPositions(int k) {
+  static const unsigned int profSite = KBase::Profiler::site("updateBestBrgnPositions");
+  KBase::ProfTimer profTimer(profSite);
+  auto smod = dynamic_cast<SMPModel *>(model);
+  const unsigned int na = smod->numAct;
+  const unsigned int nb = brgns[k].size();
 
-    if (b->actInit == b->actRcvr) { // SQ bargain
-      uAvrg = 0.0;
-      for (unsigned int n = 0; n < na; n++) {
-        // nai's estimate of the utility to nai of position n, i.e. the true value
-        uAvrg = uAvrg + aUtil[nai](nai, n);
+  // The key is to build the usual matrix of U_ai (Brgn_m) for all bargains in brgns[k],
+  // making sure to divide the sum of the utilities of positions by 1/N
+  // so 0 <= Util(state after Brgn_m) <= 1, then do the standard scalarPCE for bargains involving k.
+  // Everything here is read-only except brgnChoices[k], which only this call writes,
+  // so all actors are done concurrently. Logging and choosing are left to applyBestBrgnPositions.
+  //
+  // A bargain leaves all positions unchanged, except Init and Rcvr, so the utility to nai
+  // of the resulting state is nai's status-quo sum (cached in aUtilSQ) with those two
+  // positions swapped for the bargained ones.
+  auto u_im = KMatrix(na, nb);
+  vector<double> uInit = {};
+  vector<double> uRcvr = {};
+  for (unsigned int j = 0; j < nb; j++) {
+    const BargainSMP & b = brgnAt(k, j);
+    if (b.initNdx == b.rcvrNdx) { // SQ bargain
+      for (unsigned int nai = 0; nai < na; nai++) {
+        u_im(nai, j) = aUtilSQ[nai];
       }
     }
-
-    else { // all positions unchanged, except Init and Rcvr
-      uAvrg = 0.0;
-      auto ndxInit = model->actrNdx(b->actInit);
-      if ((0 > ndxInit) || (ndxInit >= na)) { // must find it
+    else {
+      auto ndxInit = b.initNdx;
+      if (ndxInit >= na) { // must find it
         throw KException("SMPState::updateBestBrgnPositions This initiator actor number is not present in model");
       }
-      double uPosInit = ((SMPActor*)(model->actrs[nai]))->posUtil(&(b->posInit), this);
-      uAvrg = uAvrg + uPosInit;
-
-      auto ndxRcvr = model->actrNdx(b->actRcvr);
-      if ((0 > ndxRcvr) || (ndxRcvr >= na)) {
+      auto ndxRcvr = b.rcvrNdx;
+      if (ndxRcvr >= na) {
         throw KException("SMPState::updateBestBrgnPositions: This receiver actor number is not present in model");
       }
-      double uPosRcvr = ((SMPActor*)(model->actrs[nai]))->posUtil(&(b->posRcvr), this);
-      uAvrg = uAvrg + uPosRcvr;
+      posUtils(b.posInit, uInit);
+      posUtils(b.posRcvr, uRcvr);
+      for (unsigned int nai = 0; nai < na; nai++) {
+        const KMatrix & ua = aUtil[nai];
+        u_im(nai, j) = (aUtilSQ[nai] - ua(nai, ndxInit) - ua(nai, ndxRcvr)) + (uInit[nai] + uRcvr[nai]);
+      }
+    }
 
-      for (unsigned int n = 0; n < na; n++) {
-        if ((ndxInit != n) && (ndxRcvr != n)) {
-          // again, nai's estimate of the utility to nai of position n, i.e. the true value
-          uAvrg = uAvrg + aUtil[nai](nai, n);
-        }
+    for (unsigned int nai = 0; nai < na; nai++) {
+      const double uAvrg = u_im(nai, j) / na;
+      if (0.0 >= uAvrg) { // none negative, at least own is positive
+        throw KException("SMPState::updateBestBrgnPositions: uAvrg should be non-negative");
+      }
+      if (uAvrg > 1.0) { // can not all be over 1.0
+        throw KException("SMPState::updateBestBrgnPositions: uAvrg can't be over 1.0");
       }
+      u_im(nai, j) = uAvrg;
     }
+  }
 
-    uAvrg = uAvrg / na;
+  // the same as Model::scalarPCE, keeping the intermediate results to report later
+  const auto vr = smod->vrCltn;
+  auto vfn = [vr, this, &u_im](unsigned int ak, unsigned int pi, unsigned int pj) {
+    return Model::vote(vr, w(0, ak), u_im(ak, pi), u_im(ak, pj));
+  };
+  auto c = Model::coalitions(vfn, na, nb);
+  auto pv2 = Model::probCE2(smod->pcem, smod->vpm, c);
+  auto p = get<0>(pv2);
+  if (nb != p.numR()) {
+    throw KException("SMPState::updateBestBrgnPositions: number of bargains mismatched with scalar PCE row count");
+  }
+  if (1 != p.numC()) {
+    throw KException("SMPState::updateBestBrgnPositions: scalar pce column size is not 1");
+  }
 
-    if (0.0 >= uAvrg) { // none negative, at least own is positive
-      throw KException("SMPState::updateBestBrgnPositions: uAvrg should be non-negative");
+  // the Bargain Vote table
+  // JAH added sql flag logging control
+  BrgnVotes votes = {};
+  if (model->sqlFlags[3]) {
+    vector< std::tuple<uint64_t, uint64_t>> barginIDsPair_i_j;
+    for (unsigned int brgnFirst = 0; brgnFirst < nb; brgnFirst++) {
+      for (unsigned int brgnSecond = 0; brgnSecond < brgnFirst; brgnSecond++) {
+        barginIDsPair_i_j.push_back(tuple<uint64_t, uint64_t>(brgnAt(k, brgnFirst).getID(), brgnAt(k, brgnSecond).getID()));
+      }
     }
-    if (uAvrg > 1.0) { // can not all be over 1.0
-      throw KException("SMPState::updateBestBrgnPositions: uAvrg can't be over 1.0");
+    for (unsigned int actor = 0; actor < na; ++actor) {
+      auto pv_ij = calcVotes(w, u_im, actor);
+      votes.push_back(BrgnVote(turn, barginIDsPair_i_j, pv_ij, actor));
     }
-    return uAvrg;
-  };
-  // end of λ-fn
+  }
 
+  brgnChoices[k] = BrgnChoice(u_im, c, get<1>(pv2), p, votes);
+  return;
+}
 
-  // The key is to build the usual matrix of U_ai (Brgn_m) for all bargains in brgns[k],
-  // making sure to divide the sum of the utilities of positions by 1/N
-  // so 0 <= Util(state after Brgn_m) <= 1, then do the standard scalarPCE for bargains involving k.
 
-    auto buk = [brgnUtil, k](unsigned int nai, unsigned int nbj) {
-      return brgnUtil(k, nai, nbj);
-    };
-    auto smod = dynamic_cast<SMPModel *>(model);
-    unsigned int na = smod->numAct;
-    unsigned int nb = brgns[k].size();
+void SMPState::applyBestBrgnPositions() {
+  auto smod = dynamic_cast<SMPModel *>(model);
+  const unsigned int na = smod->numAct;
 
-    mtxLock.lock();
-    auto u_im = KMatrix::map(buk, na, nb);
+  // in actor order, so that the log, the tables, and any random choices
+  // are the same however the concurrent part was scheduled
+  for (unsigned int k = 0; k < na; k++) {
+    const unsigned int nb = brgns[k].size();
+    const KMatrix & u_im = get<0>(brgnChoices[k]);
+    const KMatrix & p = get<3>(brgnChoices[k]);
 
-    LOG(INFO) << "u_im:";
-    u_im.mPrintf(" %.5f ");
+    if (KTRACE_ON(High)) {
+      LOG(INFO) << "u_im:";
+      u_im.mPrintf(" %.5f ");
 
-    LOG(INFO) << "Doing scalarPCE for the" << nb << "bargains of actor" << k << "...";
-    auto p = Model::scalarPCE(na, nb, w, u_im, smod->vrCltn, smod->vpm, smod->pcem, ReportingLevel::Medium);
-    if (nb != p.numR()) {
-      throw KException("SMPState::updateBestBrgnPositions: number of bargains mismatched with scalar PCE row count");
-    }
-    if (1 != p.numC()) {
-      throw KException("SMPState::updateBestBrgnPositions: scalar pce column size is not 1");
+      LOG(INFO) << "Doing scalarPCE for the" << nb << "bargains of actor" << k << "...";
+      Model::showScalarPCE(w, u_im, smod->vrCltn, get<1>(brgnChoices[k]), get<2>(brgnChoices[k]), p);
     }
     actorBargains.insert(map<unsigned int, KBase::KMatrix>::value_type(k, p));
 
-    unsigned int mMax = nb; // indexing actors by i, bargains by m
-    switch (smod->stm) {
-    case StateTransMode::DeterminsticSTM:
-      mMax = ndxMaxProb(p);
-      break;
-    case StateTransMode::StochasticSTM:
-      mMax = model->rng->probSel(p);
-      break;
-    default:
-      throw KException("SMPState::updateBestBrgnPositions - unrecognized StateTransMode");
-      break;
-    }
-    // 0 <= mMax assured for uint
-    if (mMax >= nb) {
-      throw KException("SMPState::updateBestBrgnPositions: Bargain number with max probability can't be more than bargain count");
-    }
+    const unsigned int mMax = chooseBrgn(k, model->rng); // indexing actors by i, bargains by m
     actorMaxBrgNdx.insert(map<unsigned int, unsigned int>::value_type(k, mMax));
-    auto bkm = brgns[k][mMax];
-    LOG(INFO) << "Chosen bargain (" << smod->stm << "):" << bkm->getID()
-      << mMax + 1 << "out of" << nb << "bargains";
-    mtxLock.unlock();
+    BCNEvent sel;
+    sel.kind = BCNEventKind::BargainSelected;
+    sel.turn = turn;
+    sel.init = k;
+    sel.rcvr = brgnAt(k, mMax).rcvrNdx;
+    sel.brgnID = brgnAt(k, mMax).getID();
+    sel.value = p(mMax, 0);
+    if (KTRACE_ON(Medium)) {
+      std::ostringstream os;
+      os << "Chosen bargain (" << smod->stm << "): " << sel.brgnID << " "
+         << mMax + 1 << " out of " << nb << " bargains";
+      sel.text = os.str();
+    }
+    bcnEvents[k].push_back(sel);
 
     //populate the Bargain Vote & Util tables
     // JAH added sql flag logging control
-  if (model->sqlFlags[3])
-  {
-    auto brgns_k = brgns[k];
-    vector< std::tuple<uint64_t, uint64_t>> barginIDsPair_i_j;
-    vector<uint64_t> bargnIdsRows = {};
-    for (int j = 0; j < nb; j++)
-    {
-      bargnIdsRows.push_back(brgns[k][j]->getID());
+    if (model->sqlFlags[3]) {
+      vector<uint64_t> bargnIdsRows = {};
+      for (unsigned int j = 0; j < nb; j++) {
+        bargnIdsRows.push_back(brgnAt(k, j).getID());
+      }
+      brgnVotes.push_back(get<4>(brgnChoices[k]));
+      brgnUtils.push_back(BrgnUtil(turn, bargnIdsRows, u_im));
     }
-    for (unsigned int brgnFirst = 0; brgnFirst < nb; brgnFirst++)
-    {
-      for (unsigned int brgnSecond = 0; brgnSecond < brgnFirst; brgnSecond++)
-      {
-        barginIDsPair_i_j.push_back(tuple<uint64_t, uint64_t>(brgns_k[brgnFirst]->getID(), brgns_k[brgnSecond]->getID()));
+
+    // Make sure that the pk is stored at right position in s2.
+    auto pk = brgnPstn(k, mMax, s2);
+    s2->pstns[k] = pk;
+
+    if (model->sqlFlags[4]) {
+      const BargainSMP & bkm = brgnAt(k, mMax);
+      auto oldPK = dynamic_cast<const VctrPstn *>(pstns[k]);
+      for (unsigned int dimen = 0; dimen < pk->numR(); dimen++) {
+        const double pOld = (*oldPK)(dimen, 0) * 100.0; // Use the scale of [0,100], as VectorPosition does
+        const double pNew = (*pk)(dimen, 0) * 100.0;
+        if (pNew != pOld) {
+          posMoves.push_back(PosMove(k, dimen, pOld, pNew, bkm.getID(), bkm.initNdx, bkm.rcvrNdx));
+        }
       }
     }
+  }
+  brgnChoices.clear();
+  return;
+}
 
-    BrgnVotes votes;
-    for (unsigned int actor = 0; actor < na; ++actor) {
-      auto pv_ij = calcVotes(w, u_im, actor);
 
-      votes.push_back(BrgnVote(turn, barginIDsPair_i_j, pv_ij, actor));
+unsigned int SMPState::chooseBrgn(unsigned int k, PRNG* rng) const {
+  auto ndxMaxProb = [](const KMatrix & cv) {
+    const double pTol = 1E-8;
+    if (fabs(KBase::sum(cv) - 1.0) >= pTol) {
+      throw KException("SMPState::chooseBrgn: Sum of cv is greater than 1");
     }
-    brgnPosLock.lock();
-    brgnVotes.push_back(votes);
-    brgnUtils.push_back(BrgnUtil(turn, bargnIdsRows, u_im));
-    brgnPosLock.unlock();
+    if (0 == cv.numR()) {
+      throw KException("SMPState::chooseBrgn: cv doesn't have records");
+    }
+    if (1 != cv.numC()) {
+      throw KException("SMPState::chooseBrgn: cv must be a column matrix");
+    }
+    auto ndxIJ = ndxMaxAbs(cv);
+    unsigned int iMax = get<0>(ndxIJ);
+    return iMax;
+  };
+
+  auto smod = dynamic_cast<const SMPModel *>(model);
+  const unsigned int nb = brgns[k].size();
+  const KMatrix & p = get<3>(brgnChoices[k]);
+
+  unsigned int mMax = nb;
+  switch (smod->stm) {
+  case StateTransMode::DeterminsticSTM:
+    mMax = ndxMaxProb(p);
+    break;
+  case StateTransMode::StochasticSTM:
+    mMax = rng->probSel(p);
+    break;
+  default:
+    throw KException("SMPState::chooseBrgn - unrecognized StateTransMode");
+    break;
   }
+  // 0 <= mMax assured for uint
+  if (mMax >= nb) {
+    throw KException("SMPState::chooseBrgn: Bargain number with max probability can't be more than bargain count");
+  }
+  return mMax;
+}
+
 
-    // TODO: create a fresh position for k, from the selected bargain mMax.
-    VctrPstn * pk = nullptr;
-    auto oldPK = dynamic_cast<VctrPstn *>(pstns[k]);
-    if (bkm->actInit == bkm->actRcvr) { // SQ
-      pk = new VctrPstn(*oldPK);
+VctrPstn* SMPState::brgnPstn(unsigned int k, unsigned int m, SMPState* sn) const {
+  // TODO: create a fresh position for k, from the selected bargain m.
+  const BargainSMP & bkm = brgnAt(k, m);
+  VctrPstn * pk = nullptr;
+  auto oldPK = dynamic_cast<VctrPstn *>(pstns[k]);
+  if (bkm.initNdx == bkm.rcvrNdx) { // SQ
+    pk = new VctrPstn(*oldPK);
+  }
+  else {
+    const unsigned int ndxInit = bkm.initNdx;
+    const unsigned int ndxRcvr = bkm.rcvrNdx;
+    if (ndxInit == k) {
+      pk = new VctrPstn(bkm.posInit);
+    }
+    else if (ndxRcvr == k) {
+      pk = new VctrPstn(bkm.posRcvr);
     }
     else {
-      const unsigned int ndxInit = model->actrNdx(bkm->actInit);
-      const unsigned int ndxRcvr = model->actrNdx(bkm->actRcvr);
-      if (ndxInit == k) {
-        pk = new VctrPstn(bkm->posInit);
-      }
-      else if (ndxRcvr == k) {
-        pk = new VctrPstn(bkm->posRcvr);
-      }
-      else {
-        LOG(INFO) << "unrecognized actor in bargain";
-        throw KException("SMPState::updateBestBrgnPositions: unrecognized actor in bargain");
-      }
+      LOG(INFO) << "unrecognized actor in bargain";
+      throw KException("SMPState::brgnPstn: unrecognized actor in bargain");
+    }
 
-      // If the actor has changed its position, record the bargain id
-      for (int dimen = 0; dimen < pk->numR(); dimen++) {
-        auto pCoordOld = (*oldPK)(dimen, 0);
-        auto pCoord = (*pk)(dimen, 0);
-        if (pCoord != pCoordOld) {
-          s2->setPosMoverBargain(k, bkm->getID());
-        }
+    // If the actor has changed its position, record the bargain id
+    for (int dimen = 0; dimen < pk->numR(); dimen++) {
+      auto pCoordOld = (*oldPK)(dimen, 0);
+      auto pCoord = (*pk)(dimen, 0);
+      if (pCoord != pCoordOld) {
+        sn->setPosMoverBargain(k, bkm.getID());
       }
     }
-    if (nullptr == pk) {
-      throw KException("SMPState::updateBestBrgnPositions: pk is null pointer");
-    }
-
-    // Make sure that the pk is stored at right position in s2.
-    s2->pstns[k] = pk;
+  }
+  if (nullptr == pk) {
+    throw KException("SMPState::brgnPstn: pk is null pointer");
+  }
+  return pk;
 }
 
 
@@ -817,37 +1073,42 @@ tuple<double, double> SMPState::probEduChlg(unsigned int h, unsigned int k, unsi
   double uji = aUtil[h](j, i);
   double ujj = aUtil[h](j, j);
 
+  // valid inputs keep every utility on [0,1] and each salience sum on (0,1],
+  // so once SMPModel::preflight has passed, the range checks are skipped
+  const bool rangeChecks = !sMod->prevalidated;
+
   // h's estimate of utility to k of status-quo positions of i and j
   const double euSQ = aUtil[h](k, i) + aUtil[h](k, j);
-  if ((0.0 > euSQ) || (euSQ > 2.0)) {
+  if (rangeChecks && ((0.0 > euSQ) || (euSQ > 2.0))) {
     LOG(INFO) << "euSQ =" << euSQ;
     throw KException("SMPState::probEduChlg: euSQ must be in the range [0.0, 2.0]");
   }
 
   // h's estimate of utility to k of i defeating j, so j adopts i's position
   const double uhkij = aUtil[h](k, i) + aUtil[h](k, i);
-  if ((0.0 > uhkij) || (uhkij > 2.0)) {
+  if (rangeChecks && ((0.0 > uhkij) || (uhkij > 2.0))) {
     LOG(INFO) << "uhkij =" << uhkij;
     throw KException("SMPState::probEduChlg: uhkij must be in the range [0.0, 2.0]");
   }
 
   // h's estimate of utility to k of j defeating i, so i adopts j's position
   const double uhkji = aUtil[h](k, j) + aUtil[h](k, j);
-  if ((0.0 > uhkji) || (uhkji > 2.0)) {
+  if (rangeChecks && ((0.0 > uhkji) || (uhkji > 2.0))) {
     LOG(INFO) << "uhkji =" << uhkji;
     throw KException("SMPState::probEduChlg: uhkji must be in the range [0.0, 2.0]");
   }
 
-  auto ai = ((const SMPActor*)(model->actrs[i]));
-  double si = KBase::sum(ai->vSal);
-  double ci = ai->sCap;
-  auto aj = ((const SMPActor*)(model->actrs[j]));
-  double sj = KBase::sum(aj->vSal);
-  if ((0 >= sj) || (sj > 1)) {
+  if (model->numAct != aStore.numAct) {
+    throw KException("SMPState::probEduChlg: actor store must be set first");
+  }
+  double si = aStore.salSum[i];
+  double ci = aStore.caps[i];
+  double sj = aStore.salSum[j];
+  if (rangeChecks && ((0 >= sj) || (sj > 1))) {
     LOG(INFO) << "sj =" << sj;
     throw KException("SMPState::probEduChlg: sj must be in the range (0, 1]");
   }
-  double cj = aj->sCap;
+  double cj = aStore.caps[j];
   const double minCltn = 1E-10;
 
   // get h's estimate of the principal actors' contribution to their own contest
@@ -925,10 +1186,8 @@ tuple<double, double> SMPState::probEduChlg(unsigned int h, unsigned int k, unsi
   auto tpvArray = KMatrix(na, 3);
   for (unsigned int n = 0; n < na; n++) {
     if ((n != i) && (n != j)) { // already got their influence-contributions
-      auto an = ((const SMPActor*)(model->actrs[n]));
-
-      double cn = an->sCap;
-      double sn = KBase::sum(an->vSal);
+      double cn = aStore.caps[n];
+      double sn = aStore.salSum[n];
       double uni = aUtil[h](n, i);
       double unj = aUtil[h](n, j);
       double unn = aUtil[h](n, n);
@@ -1017,10 +1276,6 @@ tuple<int, double, double> SMPState::bestChallenge(eduChlgsI &eduI) const {
   double pIJ = 0;
   double bestEU = -1.00;
 
-  // for SMP, positive expected gains on the first turn are typically in the 0.5 to 0.01 range
-  // I take a fraction of the minimum.
-  const double minSigEDU = 1e-5; // TODO: 1/20 of the minimum, or 0.0005
-
   for(const auto& eduIJ : eduI) {
     double pij = get<0>(eduIJ.second);
     double edu = get<1>(eduIJ.second);
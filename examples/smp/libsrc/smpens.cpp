@@ -0,0 +1,233 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+//
+// Run an ensemble of stochastic SMP replicas, sharing the states they have in common.
+//
+// --------------------------------------------
+
+#include <set>
+#include "smp.h"
+
+namespace SMPLib {
+using std::function;
+using std::get;
+using std::string;
+using std::tuple;
+
+using KBase::PRNG;
+using KBase::KMatrix;
+using KBase::KException;
+using KBase::Model;
+using KBase::State;
+using KBase::StateTransMode;
+
+// --------------------------------------------
+
+void SMPModel::runEnsemble(SMPModel * md0) {
+  const unsigned int nRep = md0->ensembleSize;
+  const unsigned int na = md0->numAct;
+  const unsigned int nd = md0->numDim;
+  if (1 != md0->history.size()) {
+    throw KException("SMPModel::runEnsemble: history should hold only the initial state");
+  }
+  if (0 == nRep) {
+    throw KException("SMPModel::runEnsemble: ensemble must have at least one replica");
+  }
+  if (StateTransMode::StochasticSTM != md0->stm) {
+    LOG(INFO) << "Ensemble uses stochastic state transitions, in place of " << md0->stm;
+    md0->stm = StateTransMode::StochasticSTM;
+  }
+
+  // Replicas are distinguished only by the bargains they draw, so nothing
+  // is recorded per turn. The tables written after the run describe replica 0.
+  const vector<bool> oldFlags = md0->sqlFlags;
+  for (unsigned int g = 1; g < md0->sqlFlags.size(); g++) {
+    md0->sqlFlags[g] = false;
+  }
+
+  // replica 0 draws from the model's own PRNG, as a single run would
+  auto rngs = vector<PRNG*>(nRep, md0->rng);
+  for (unsigned int r = 1; r < nRep; r++) {
+    rngs[r] = new PRNG(md0->getSeed() + r);
+  }
+  // each replica's stopping function records the cycles it finds in its own slot
+  auto cycles = vector<tuple<unsigned int, unsigned int>>(nRep, tuple<unsigned int, unsigned int>(0, 0));
+  auto stops = vector<function<bool(unsigned int, const State *)>>();
+  for (unsigned int r = 0; r < nRep; r++) {
+    stops.push_back(smpStopFn(md0->stopParams, &(cycles[r])));
+  }
+  auto paths = vector<vector<State*>>(nRep, md0->history);
+  auto made = vector<State*>();
+
+  // However the ensemble ends, the replicas' PRNGs are freed and the flags put
+  // back. If a replica throws, the model is also left as it was before: just
+  // the initial state, with none of the states made since.
+  struct EnsembleGuard {
+    SMPModel * md;
+    const vector<bool> flags;
+    vector<PRNG*> & rngs;
+    vector<State*> & made;
+    bool finished;
+    ~EnsembleGuard() {
+      if (!finished) {
+        auto s0 = ((SMPState*)(md->history[0]));
+        md->history = vector<State*>{ s0 };
+        s0->releaseBargains();
+        for (auto s : made) {
+          delete s;
+        }
+      }
+      for (unsigned int r = 1; r < rngs.size(); r++) {
+        delete rngs[r];
+      }
+      md->sqlFlags = flags;
+    }
+  } guard { md0, oldFlags, rngs, made, false };
+
+  md0->ensembleTurns = vector<unsigned int>(nRep, 0);
+  md0->ensemblePstns = vector<KMatrix>(nRep);
+  md0->ensembleCycles = cycles;
+
+  // each live state, with the replicas whose latest state it is
+  using EnsNode = tuple<SMPState*, vector<unsigned int>>;
+  auto s0 = ((SMPState*)(md0->history[0]));
+  s0->setupStep();
+  auto allReps = vector<unsigned int>(nRep);
+  for (unsigned int r = 0; r < nRep; r++) {
+    allReps[r] = r;
+  }
+  auto live = vector<EnsNode>{ EnsNode(s0, allReps) };
+
+  unsigned int nAssessed = 0;
+  unsigned int nRepTurns = 0;
+  unsigned int iter = 0;
+  while (0 < live.size()) {
+    iter++;
+    LOG(INFO) << KBase::getFormattedString(
+      "Starting ensemble iteration %u, with %u distinct states", iter, live.size());
+    auto next = vector<EnsNode>();
+    for (auto & node : live) {
+      SMPState* st = get<0>(node);
+      const vector<unsigned int> & reps = get<1>(node);
+      // states look back along their own path, e.g. for the turn number
+      md0->history = paths[reps[0]];
+      st->makeBargains();
+      st->assessBargains();
+      nAssessed++;
+      nRepTurns = nRepTurns + reps.size();
+
+      // group the replicas by the bargains their own draws choose,
+      // drawing in actor order, just as applyBestBrgnPositions does
+      auto branches = map<vector<unsigned int>, vector<unsigned int>>();
+      for (auto r : reps) {
+        auto choice = vector<unsigned int>(na);
+        for (unsigned int k = 0; k < na; k++) {
+          choice[k] = st->chooseBrgn(k, rngs[r]);
+        }
+        branches[choice].push_back(r);
+      }
+
+      for (auto & br : branches) {
+        const vector<unsigned int> & choice = br.first;
+        const vector<unsigned int> & brReps = br.second;
+        auto sn = new SMPState(md0);
+        for (unsigned int k = 0; k < na; k++) {
+          sn->pstns[k] = st->brgnPstn(k, choice[k], sn);
+        }
+        st->setSuccessor(sn);
+        sn->setupStep();
+        sn->step = [sn]() {
+          return sn->stepBCN();
+        };
+        made.push_back(sn);
+        for (auto r : brReps) {
+          paths[r].push_back(sn);
+        }
+
+        // Replicas on one path would reach the same decision, so ask only the first.
+        // The others' stopping functions catch up on the path when next called.
+        md0->history = paths[brReps[0]];
+        if (stops[brReps[0]](iter, sn)) {
+          auto pm = KMatrix(nd, na);
+          for (unsigned int k = 0; k < na; k++) {
+            auto pk = ((const VctrPstn*)(sn->pstns[k]));
+            for (unsigned int d = 0; d < nd; d++) {
+              pm(d, k) = (*pk)(d, 0);
+            }
+          }
+          for (auto r : brReps) {
+            md0->ensembleTurns[r] = iter;
+            md0->ensemblePstns[r] = pm;
+            md0->ensembleCycles[r] = cycles[brReps[0]];
+          }
+          // only replica 0's states are reported after the run
+          if (0 != brReps[0]) {
+            sn->releaseTurnData();
+          }
+        }
+        else {
+          next.push_back(EnsNode(sn, brReps));
+        }
+      }
+      // st has left the live states. Replica 0's are reported after the run,
+      // so they keep their utilities; the rest need only their positions.
+      if (0 == reps[0]) {
+        st->releaseBargains();
+      }
+      else {
+        st->releaseTurnData();
+      }
+    }
+    live = next;
+  }
+
+  // keep replica 0's path as the model's history, and delete the states no other path needs
+  md0->history = paths[0];
+  md0->cycleStart = get<0>(md0->ensembleCycles[0]);
+  md0->cycleLen = get<1>(md0->ensembleCycles[0]);
+  const std::set<State*> kept(paths[0].begin(), paths[0].end());
+  for (auto s : made) {
+    if (0 == kept.count(s)) {
+      delete s;
+    }
+  }
+  guard.finished = true;
+
+  for (unsigned int r = 0; r < nRep; r++) {
+    LOG(INFO) << KBase::getFormattedString("Replica %u stopped after %u turns", r, md0->ensembleTurns[r]);
+    if (0 < get<1>(md0->ensembleCycles[r])) {
+      LOG(INFO) << KBase::getFormattedString("Replica %u was last in a cycle of length %u from state %u",
+        r, get<1>(md0->ensembleCycles[r]), get<0>(md0->ensembleCycles[r]));
+    }
+  }
+  LOG(INFO) << KBase::getFormattedString(
+    "Ensemble of %u replicas assessed %u states for %u replica-turns",
+    nRep, nAssessed, nRepTurns);
+  return;
+}
+
+}; // end of namespace
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,313 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+//
+// Generate synthetic SMP scenarios, with controllable structure, for scaling
+// studies, and write them in any of the forms the readers accept.
+//
+// --------------------------------------------
+
+#include <cmath>
+#include <cstdio>
+#include "smp.h"
+
+namespace SMPLib {
+using std::string;
+using std::vector;
+
+using KBase::KMatrix;
+using KBase::KException;
+using KBase::PRNG;
+
+// --------------------------------------------
+
+SMPScenario SMPModel::genScenario(const SMPGenParams & gp) {
+  const unsigned int na = gp.numAct;
+  const unsigned int nd = gp.numDim;
+  if (na < Model::minNumActor) {
+    throw KException("SMPModel::genScenario: too few actors");
+  }
+  if (0 == nd) {
+    throw KException("SMPModel::genScenario: number of dimensions must be positive");
+  }
+  if (na < gp.numClusters) {
+    throw KException("SMPModel::genScenario: more clusters than actors");
+  }
+  if ((gp.salDensity <= 0.0) || (1.0 < gp.salDensity)) {
+    throw KException("SMPModel::genScenario: salience density must be in (0, 1]");
+  }
+  if ((gp.clusterSD < 0.0) || (gp.capAlpha < 0.0)) {
+    throw KException("SMPModel::genScenario: cluster spread and capability exponent must not be negative");
+  }
+  if ((gp.capMin <= 0.0) || (gp.capMax < gp.capMin) || (1E8 < gp.capMax)) {
+    throw KException("SMPModel::genScenario: capabilities must satisfy 0 < capMin <= capMax <= 1E8");
+  }
+  if ((gp.accSelf < 0.0) || (gp.accBlock < 0.0) || (1.0 < gp.accSelf + gp.accBlock)) {
+    throw KException("SMPModel::genScenario: accommodation weights must be non-negative, with a sum of at most 1");
+  }
+  if ((0.0 < gp.accBlock) && ((1.0 <= gp.accSelf) || (0 == gp.numClusters))) {
+    throw KException("SMPModel::genScenario: block accommodation needs clusters, and accSelf below 1");
+  }
+
+  auto rng = PRNG(gp.seed);
+  auto normal = [&rng]() {
+    // Box-Muller; 1-u is never zero, as uniform is on [0,1)
+    const double u1 = rng.uniform(0.0, 1.0);
+    const double u2 = rng.uniform(0.0, 1.0);
+    return sqrt(-2.0 * log(1.0 - u1)) * cos(2.0 * 3.14159265358979323846 * u2);
+  };
+  auto clusterOf = [na, &gp](unsigned int i) {
+    return (unsigned int)((((uint64_t)i) * gp.numClusters) / na);
+  };
+
+  SMPScenario sc;
+  sc.name = gp.name;
+  sc.desc = gp.desc;
+  sc.seed = gp.seed;
+
+  auto digits = [](unsigned int n) {
+    unsigned int w = 2;
+    for (unsigned int m = 100; m <= n; m = 10 * m) {
+      w++;
+    }
+    return w;
+  };
+  const unsigned int aw = digits(na - 1);
+  const unsigned int dw = digits(nd - 1);
+  for (unsigned int d = 0; d < nd; d++) {
+    sc.dName.push_back(KBase::getFormattedString("GDim-%0*u", dw, d));
+  }
+  for (unsigned int i = 0; i < na; i++) {
+    sc.aName.push_back(KBase::getFormattedString("GActor-%0*u", aw, i));
+    sc.aDesc.push_back((0 == gp.numClusters) ? string("Synthetic actor")
+                       : KBase::getFormattedString("Synthetic actor in cluster %u", clusterOf(i)));
+  }
+
+  // positions, around the cluster centers if there are any
+  auto ctr = KMatrix::uniform(&rng, std::max(1U, gp.numClusters), nd, 0.0, 100.0);
+  sc.pos = KMatrix(na, nd);
+  for (unsigned int i = 0; i < na; i++) {
+    const unsigned int c = clusterOf(i);
+    for (unsigned int d = 0; d < nd; d++) {
+      double x = (0 == gp.numClusters) ? rng.uniform(0.0, 100.0) : ctr(c, d) + gp.clusterSD * normal();
+      sc.pos(i, d) = std::min(100.0, std::max(0.0, x));
+    }
+  }
+
+  // capabilities, by inverting the Pareto distribution function
+  sc.cap = KMatrix(na, 1);
+  for (unsigned int i = 0; i < na; i++) {
+    if (0.0 == gp.capAlpha) {
+      sc.cap(i, 0) = rng.uniform(10.0, 200.0);
+    }
+    else {
+      const double u = rng.uniform(0.0, 1.0);
+      sc.cap(i, 0) = std::min(gp.capMax, gp.capMin * pow(1.0 - u, -1.0 / gp.capAlpha));
+    }
+  }
+
+  // saliences, on a random subset of the dimensions, chosen by a partial shuffle
+  const unsigned int nSal = std::max(1U, (unsigned int)(0.5 + gp.salDensity * nd));
+  sc.sal = KMatrix(na, nd);
+  auto dNdx = vector<unsigned int>(nd);
+  for (unsigned int i = 0; i < na; i++) {
+    for (unsigned int d = 0; d < nd; d++) {
+      dNdx[d] = d;
+    }
+    const double s = rng.uniform(75.0, 99.0);
+    double wSum = 0.0;
+    for (unsigned int k = 0; k < nSal; k++) {
+      const unsigned int r = k + (unsigned int)(rng.uniform() % (nd - k));
+      std::swap(dNdx[k], dNdx[r]);
+      const double w = rng.uniform(0.1, 1.0);
+      sc.sal(i, dNdx[k]) = w;
+      wSum = wSum + w;
+    }
+    for (unsigned int k = 0; k < nSal; k++) {
+      sc.sal(i, dNdx[k]) = s * sc.sal(i, dNdx[k]) / wSum;
+    }
+  }
+
+  // accommodation: the identity, or blocks along the clusters
+  sc.acc = KBase::iMat(na);
+  if (gp.accSelf < 1.0) {
+    auto first = vector<unsigned int>(std::max(1U, gp.numClusters) + 1, na);
+    for (unsigned int i = na; 0 < i; i--) {
+      first[clusterOf(i - 1)] = i - 1;
+    }
+    for (unsigned int i = 0; i < na; i++) {
+      const unsigned int c = clusterOf(i);
+      const unsigned int m = first[c + 1] - first[c];
+      sc.acc(i, i) = gp.accSelf;
+      if ((0.0 < gp.accBlock) && (1 < m)) {
+        for (unsigned int j = first[c]; j < first[c + 1]; j++) {
+          if (j != i) {
+            sc.acc(i, j) = gp.accBlock / (m - 1);
+          }
+        }
+      }
+    }
+  }
+
+  LOG(INFO) << KBase::getFormattedString(
+    "Generated scenario %s: %u actors, %u dimensions, %u clusters, seed %llu",
+    sc.name.c_str(), na, nd, gp.numClusters, (unsigned long long)(gp.seed));
+  return sc;
+}
+
+
+// the accommodation entries that differ from the identity
+static vector<std::tuple<unsigned int, unsigned int, double>> accOffIdentity(const KMatrix & acc) {
+  auto ia = vector<std::tuple<unsigned int, unsigned int, double>>();
+  for (unsigned int i = 0; i < acc.numR(); i++) {
+    for (unsigned int j = 0; j < acc.numC(); j++) {
+      const double aij = acc(i, j);
+      if (((i == j) && (1.0 != aij)) || ((i != j) && (0.0 != aij))) {
+        ia.push_back(std::make_tuple(i, j, aij));
+      }
+    }
+  }
+  return ia;
+}
+
+
+void SMPModel::writeScenarioCSV(const SMPScenario & sc, string fName) {
+  const unsigned int na = sc.aName.size();
+  const unsigned int nd = sc.dName.size();
+  FILE* f = fopen(fName.c_str(), "w");
+  if (nullptr == f) {
+    throw KException("SMPModel::writeScenarioCSV: could not open " + fName);
+  }
+  fprintf(f, "%s,\"%s\",%u,%u,\n", sc.name.c_str(), sc.desc.c_str(), na, nd);
+  fprintf(f, "Actor,Description,Power,");
+  for (unsigned int d = 0; d < nd; d++) {
+    fprintf(f, "%s,Sal%u,", sc.dName[d].c_str(), d + 1);
+  }
+  fprintf(f, "\n");
+  for (unsigned int i = 0; i < na; i++) {
+    fprintf(f, "%s,%s,%.3f,", sc.aName[i].c_str(), sc.aDesc[i].c_str(), sc.cap(i, 0));
+    for (unsigned int d = 0; d < nd; d++) {
+      fprintf(f, "%.4f,%.4f,", sc.pos(i, d), sc.sal(i, d));
+    }
+    fprintf(f, "\n");
+  }
+  const bool ok = (0 == ferror(f));
+  fclose(f);
+  if (!ok) {
+    throw KException("SMPModel::writeScenarioCSV: could not write " + fName);
+  }
+  if (0 < accOffIdentity(sc.acc).size()) {
+    LOG(INFO) << "CSV scenarios have no accommodation matrix, so" << fName << "will use the identity";
+  }
+  return;
+}
+
+
+void SMPModel::writeScenarioXML(const SMPScenario & sc, string fName) {
+  auto esc = [](const string & s) {
+    string e = "";
+    for (auto c : s) {
+      switch (c) {
+      case '&': e.append("&amp;"); break;
+      case '<': e.append("&lt;"); break;
+      case '>': e.append("&gt;"); break;
+      default: e.push_back(c);
+      }
+    }
+    return e;
+  };
+
+  const unsigned int na = sc.aName.size();
+  const unsigned int nd = sc.dName.size();
+  FILE* f = fopen(fName.c_str(), "w");
+  if (nullptr == f) {
+    throw KException("SMPModel::writeScenarioXML: could not open " + fName);
+  }
+  // no ModelParameters, so xmlRead uses the defaults
+  fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+  fprintf(f, "<Scenario xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" xsi:noNamespaceSchemaLocation=\"smpSchema.xsd\">\n");
+  fprintf(f, "  <name>%s</name>\n", esc(sc.name).c_str());
+  fprintf(f, "  <desc>%s</desc>\n", esc(sc.desc).c_str());
+  fprintf(f, "  <prngSeed>%020llu</prngSeed>\n", (unsigned long long)(sc.seed));
+  fprintf(f, "  <Dimensions>\n");
+  for (auto dn : sc.dName) {
+    fprintf(f, "    <dName>%s</dName>\n", esc(dn).c_str());
+  }
+  fprintf(f, "  </Dimensions>\n");
+  fprintf(f, "  <Actors>\n");
+  for (unsigned int i = 0; i < na; i++) {
+    fprintf(f, "    <Actor>\n");
+    fprintf(f, "      <name>%s</name>\n", esc(sc.aName[i]).c_str());
+    fprintf(f, "      <description>%s</description>\n", esc(sc.aDesc[i]).c_str());
+    fprintf(f, "      <capability>%.3f</capability>\n", sc.cap(i, 0));
+    fprintf(f, "      <Position>\n");
+    for (unsigned int d = 0; d < nd; d++) {
+      fprintf(f, "        <dCoord>%.4f</dCoord>\n", sc.pos(i, d));
+    }
+    fprintf(f, "      </Position>\n");
+    fprintf(f, "      <Salience>\n");
+    for (unsigned int d = 0; d < nd; d++) {
+      fprintf(f, "        <dSal>%.4f</dSal>\n", sc.sal(i, d));
+    }
+    fprintf(f, "      </Salience>\n");
+    fprintf(f, "    </Actor>\n");
+  }
+  fprintf(f, "  </Actors>\n");
+  const auto ia = accOffIdentity(sc.acc);
+  if (0 < ia.size()) {
+    fprintf(f, "  <IdealAdjustment>\n");
+    for (auto p : ia) {
+      fprintf(f, "    <iaPair>\n");
+      fprintf(f, "      <adjustingIdeal>%s</adjustingIdeal>\n", esc(sc.aName[std::get<0>(p)]).c_str());
+      fprintf(f, "      <referencePos>%s</referencePos>\n", esc(sc.aName[std::get<1>(p)]).c_str());
+      fprintf(f, "      <adjust>%.6f</adjust>\n", std::get<2>(p));
+      fprintf(f, "    </iaPair>\n");
+    }
+    fprintf(f, "  </IdealAdjustment>\n");
+  }
+  fprintf(f, "</Scenario>\n");
+  const bool ok = (0 == ferror(f));
+  fclose(f);
+  if (!ok) {
+    throw KException("SMPModel::writeScenarioXML: could not write " + fName);
+  }
+  return;
+}
+
+
+void SMPModel::writeScenarioSnapshot(const SMPScenario & sc, string fName) {
+  // the snapshot is of turn 0, before any database is needed
+  auto f = vector<bool>(Model::NumSQLLogGrps + NumSQLLogGrps, false);
+  auto sm0 = initModel(sc.aName, sc.aDesc, sc.dName, sc.cap, sc.pos / 100.0, sc.sal / 100.0, sc.acc,
+                       sc.seed, f, sc.desc, sc.name, false);
+  sm0->saveSnapshot(fName);
+  sm0->waitSnapshot();
+  delete sm0;
+  sm0 = nullptr;
+  return;
+}
+
+}; // end of namespace
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,218 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+//
+// Check a scenario before running it, and estimate what the run will cost.
+//
+// --------------------------------------------
+
+#include <cmath>
+#include "smp.h"
+
+namespace SMPLib {
+using std::string;
+using std::vector;
+
+using KBase::KMatrix;
+using KBase::VctrPstn;
+
+SMPPreflightMode SMPModel::preflightMode = SMPPreflightMode::Off;
+
+// CPU seconds per unit of work in one turn, fitted to smpc runs of generated
+// scenarios (smpgen) of 40 to 120 actors, with 1 to 8 dimensions
+static const double cpuPerA3 = 6E-7; // challenges and bargains, numAct^3
+static const double cpuPerA2D = 5E-8; // utilities, numAct^2 * numDim
+static const double cpuPerA4 = 8E-7; // the challenge tables of SQL group 2, numAct^4
+static const double cpuPerRow = 2E-6; // one row inserted within a transaction
+static const double bytesPerRow = 64.0;
+
+// --------------------------------------------
+
+SMPPreflight SMPModel::preflight() const {
+  SMPPreflight pf;
+  const unsigned int na = numAct;
+  const unsigned int nd = numDim;
+
+  if ((na < Model::minNumActor) || (Model::maxNumActor < na)) {
+    pf.errors.push_back(KBase::getFormattedString("%u actors, outside the range [%u, %u]",
+                                                  na, Model::minNumActor, Model::maxNumActor));
+  }
+  if (0 == nd) {
+    pf.errors.push_back("no dimensions");
+  }
+  if (0 == history.size()) {
+    pf.errors.push_back("no state to start from");
+    return pf;
+  }
+  auto st = ((const SMPState*)(history.back()));
+  if ((na != actrs.size()) || (na != st->pstns.size()) || (na != st->ideals.size())) {
+    pf.errors.push_back("actors, positions and ideals do not match in number");
+    return pf;
+  }
+  const KMatrix & acc = st->accomodate;
+  if ((na != acc.numR()) || (na != acc.numC())) {
+    pf.errors.push_back("accommodation matrix does not match the number of actors");
+    return pf;
+  }
+
+  // each actor's problems, collected in actor order whatever the thread schedule
+  auto aErrs = vector<vector<string>>(na);
+  auto checkActor = [this, st, nd, na, &acc, &aErrs](unsigned int i) {
+    auto bad = [&aErrs, i](const string & what) {
+      aErrs[i].push_back(KBase::getFormattedString("actor %u: ", i) + what);
+      return;
+    };
+    // positions and ideals on [0,1] keep every utility on [0,1]
+    auto inUnit = [nd, &bad](const KMatrix & p, const char * what) {
+      if ((nd != p.numR()) || (1 != p.numC())) {
+        bad(string(what) + " has the wrong size");
+        return;
+      }
+      for (unsigned int d = 0; d < nd; d++) {
+        if (!((0.0 <= p(d, 0)) && (p(d, 0) <= 1.0))) {
+          bad(KBase::getFormattedString("%s %g on dimension %u is not in [0, 1]", what, p(d, 0), d));
+        }
+      }
+      return;
+    };
+
+    auto ai = ((const SMPActor*)(actrs[i]));
+    if (!((0.0 < ai->sCap) && std::isfinite(ai->sCap))) {
+      bad(KBase::getFormattedString("capability %g is not positive", ai->sCap));
+    }
+    if ((nd != ai->vSal.numR()) || (1 != ai->vSal.numC())) {
+      bad("salience has the wrong size");
+    }
+    else {
+      double sSum = 0.0;
+      for (unsigned int d = 0; d < nd; d++) {
+        const double sd = ai->vSal(d, 0);
+        if (!((0.0 <= sd) && std::isfinite(sd))) {
+          bad(KBase::getFormattedString("salience %g on dimension %u is negative", sd, d));
+        }
+        sSum = sSum + sd;
+      }
+      if (!((0.0 < sSum) && (sSum <= 1.0))) {
+        bad(KBase::getFormattedString("total salience %g is not in (0, 1]", sSum));
+      }
+    }
+    inUnit(*((const VctrPstn*)(st->pstns[i])), "position");
+    inUnit(st->ideals[i], "ideal");
+
+    const double tol = 1E-10; // as in SMPState::setAccomodate
+    double rSum = 0.0;
+    for (unsigned int j = 0; j < na; j++) {
+      const double aij = acc(i, j);
+      if (!((0.0 <= aij) && (aij <= 1.0))) {
+        bad(KBase::getFormattedString("accommodation of actor %u's position %g is not in [0, 1]", j, aij));
+      }
+      rSum = rSum + aij;
+    }
+    if (rSum > 1.0 + tol) {
+      bad(KBase::getFormattedString("accommodation row sum %g exceeds 1", rSum));
+    }
+    return;
+  };
+  if (0 < na) {
+    KBase::groupThreads(checkActor, 0, na - 1);
+  }
+  for (const auto & ae : aErrs) {
+    pf.errors.insert(pf.errors.end(), ae.begin(), ae.end());
+  }
+
+  // Rows each SQL group writes, with about four bargains per initiator: while
+  // each turn runs, then after the run (LogInfoTables, sqlAUtil, showVPHistory),
+  // both for each state and once.
+  const double n = na;
+  const double m = nd;
+  const double b = BargainSMP::idsPerInit * n;
+  const double numPhases = KBase::Profiler::enabled() ? KBase::Profiler::snapshot().size() : 0.0;
+  const double grpTurnRows[] = {
+    numPhases, // 0: RunStats
+    2 * n * n * (n - 1) + n * n + n, // 1: PosVote, PosProb, PosEquiv
+    n * n * n * n + 3 * n * n * n, // 2: TPProbVictLoss, UtilChlg, ProbVict
+    b * m + b * n + 16 * n * n, // 3: BargnCoords, BargnUtil, BargnVote
+    b + n // 4: Bargn, PositionMoves
+  };
+  const double grpStateRows[] = {
+    n + n * m, // 0: SpatialCapability, SpatialSalience
+    0.0,
+    0.0,
+    0.0,
+    n * m + n * n * n // 4: VectorPosition, PosUtil
+  };
+  const double grpOnceRows[] = {
+    n + 1 + m + n * n, // 0: ActorDescription, ScenarioDesc, DimensionDescription, Accommodation
+    2 * n * n * (n - 1) + n * n + n, // 1: the last state's PosVote, PosProb, PosEquiv
+    0.0,
+    0.0,
+    1 // 4: PositionCube
+  };
+  double turnRows = 0.0;
+  double stateRows = 0.0;
+  double onceRows = 0.0;
+  for (unsigned int g = 0; (g < sqlFlags.size()) && (g < 5); g++) {
+    if (sqlFlags[g]) {
+      turnRows = turnRows + grpTurnRows[g];
+      stateRows = stateRows + grpStateRows[g];
+      onceRows = onceRows + grpOnceRows[g];
+    }
+  }
+  const bool chlgTablesP = (2 < sqlFlags.size()) && sqlFlags[2];
+
+  // ensemble replicas share states until they part, so count each as a full run;
+  // only replica 0 is recorded, and only its rows are written after the run
+  const double replicas = (0 < ensembleSize) ? ensembleSize : 1;
+  pf.turns = stopParams.maxIter;
+  const double postRows = (pf.turns + 1) * stateRows + onceRows;
+  pf.turnDBRows = (uint64_t)turnRows;
+  pf.runDBRows = (uint64_t)(pf.turns * turnRows + postRows);
+  pf.turnCPUSec = cpuPerA3 * n * n * n + cpuPerA2D * n * n * m
+    + (chlgTablesP ? cpuPerA4 * n * n * n * n : 0.0) + cpuPerRow * turnRows;
+  pf.runCPUSec = replicas * pf.turns * pf.turnCPUSec + cpuPerRow * postRows;
+  pf.runDBBytes = (uint64_t)(pf.runDBRows * bytesPerRow);
+  pf.utilBytes = (uint64_t)(n * n * n * sizeof(double));
+  return pf;
+}
+
+
+void SMPModel::showPreflight(const SMPPreflight & pf) {
+  LOG(INFO) << KBase::getFormattedString("Pre-flight check: %u problems", (unsigned int)(pf.errors.size()));
+  for (const auto & e : pf.errors) {
+    LOG(INFO) << e;
+  }
+  LOG(INFO) << KBase::getFormattedString(
+    "Pre-flight estimate: %.3g CPU seconds per turn, %.3g for %u turns",
+    pf.turnCPUSec, pf.runCPUSec, pf.turns);
+  LOG(INFO) << KBase::getFormattedString(
+    "Pre-flight estimate: %llu database rows per turn, %llu rows (%.1f MB) for %u turns and after",
+    (unsigned long long)(pf.turnDBRows), (unsigned long long)(pf.runDBRows), pf.runDBBytes / 1E6, pf.turns);
+  LOG(INFO) << KBase::getFormattedString(
+    "Pre-flight estimate: %.1f MB of utility matrices per state", pf.utilBytes / 1E6);
+  return;
+}
+
+}; // end of namespace
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,429 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+//
+// Export the history of actors' positions, and their effective powers, for Sankey diagrams
+// and other post-processing, from a model in memory or from any number of logged scenarios.
+//
+// --------------------------------------------
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include "smp.h"
+#include <QSqlQuery>
+#include <QVariant>
+#include <QSqlError>
+
+namespace SMPLib {
+using std::map;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+using KBase::KException;
+using KBase::VctrPstn;
+
+// --------------------------------------------
+// An output file with a large buffer, as the exports are written a few bytes at a time.
+class SankeyFile {
+public:
+  explicit SankeyFile(const string & fName) : name(fName) {
+    f = fopen(fName.c_str(), "w");
+    if (nullptr == f) {
+      throw KException("SankeyFile: could not open " + fName);
+    }
+    setvbuf(f, nullptr, _IOFBF, 1 << 20);
+  }
+  ~SankeyFile() {
+    if (nullptr != f) {
+      fclose(f);
+      f = nullptr;
+    }
+  }
+  SankeyFile(const SankeyFile &) = delete;
+  SankeyFile & operator=(const SankeyFile &) = delete;
+
+  FILE* f = nullptr;
+  const string name;
+};
+
+// the line of model parameters at the top of each Wide file
+static string sankeyHeadLine(const string & seed, int vpm, int vr, int pcem, int stm,
+                             int bigRRng, int bigRAdj, int tpc, int ivb, int bm) {
+  return "PRNG Seed:" + seed
+    + ";VictoryProbModel:" + KBase::VPModelNames.at(vpm)
+    + ";VotingRule:" + KBase::VotingRuleNames.at(vr)
+    + ";PCEModel:" + KBase::PCEModelNames.at(pcem)
+    + ";StateTransitions:" + KBase::StateTransModeNames.at(stm)
+    + ";BigRRange:" + KBase::BigRRangeNames.at(bigRRng)
+    + ";BigRAdjust:" + KBase::BigRAdjustNames.at(bigRAdj)
+    + ";ThirdPartyCommit:" + KBase::ThirdPartyCommitNames.at(tpc)
+    + ";InterVecBrgn:" + InterVecBrgnNames.at(ivb)
+    + ";BargnModel:" + SMPBargnModelNames.at(bm);
+}
+
+static const char* sankeyScenarioCols = "ScenarioId,RNGSeed,VictoryProbModel,VotingRule,PCEModel,"
+  "StateTransitions,BigRRange,BigRAdjust,ThirdPartyCommit,InterVecBrgn,BargnModel";
+
+// the same parameters, as one row of _scenarios.csv
+static string sankeyScenarioRow(const string & scenId, const string & seed, int vpm, int vr, int pcem,
+                                int stm, int bigRRng, int bigRAdj, int tpc, int ivb, int bm) {
+  return scenId + "," + seed
+    + "," + KBase::VPModelNames.at(vpm)
+    + "," + KBase::VotingRuleNames.at(vr)
+    + "," + KBase::PCEModelNames.at(pcem)
+    + "," + KBase::StateTransModeNames.at(stm)
+    + "," + KBase::BigRRangeNames.at(bigRRng)
+    + "," + KBase::BigRAdjustNames.at(bigRAdj)
+    + "," + KBase::ThirdPartyCommitNames.at(tpc)
+    + "," + InterVecBrgnNames.at(ivb)
+    + "," + SMPBargnModelNames.at(bm);
+}
+
+// --------------------------------------------
+void SMPModel::sankeyOutput(string outputFile, SankeyFormat fmt) const {
+  if (numAct != actrs.size()) {
+    throw KException("SMPModel::sankeyOutput: actor count is in error");
+  }
+  if (numDim != dimName.size()) {
+    throw KException("SMPModel::sankeyOutput: dimension count is in error");
+  }
+
+  auto effPow = [this](unsigned int i, unsigned int k) {
+    auto ai = ((const SMPActor*)actrs[i]);
+    const double ci = ai->sCap;
+    if (0.0 >= ci) {
+      throw KException("SMPModel::sankeyOutput: ci must be non-negative");
+    }
+    const double si = (ai->vSal)(k, 0);
+    if (0.0 >= si) {
+      throw KException("SMPModel::sankeyOutput: si must be non-negative");
+    }
+    if (si > 1.0) {
+      throw KException("SMPModel::sankeyOutput: si must not be more than 1.0");
+    }
+    return ci * si;
+  };
+
+  auto posCoord = [this](unsigned int t, unsigned int i, unsigned int k) {
+    auto vpit = (const VctrPstn*)(history[t]->pstns[i]);
+    if (numDim != vpit->numR()) {
+      throw KException("SMPModel::sankeyOutput: number of rows in vpit should be equal to the count of dimensions");
+    }
+    return 100 * (*vpit)(k, 0);
+  };
+
+  const string seed = KBase::getFormattedString("%20llu", getSeed());
+  const int vpmI = static_cast<int>(vpm);
+  const int vrI = static_cast<int>(vrCltn);
+  const int pcemI = static_cast<int>(pcem);
+  const int stmI = static_cast<int>(stm);
+  const int rngI = static_cast<int>(bigRRng);
+  const int adjI = static_cast<int>(bigRAdj);
+  const int tpcI = static_cast<int>(tpCommit);
+  const int ivbI = static_cast<int>(ivBrgn);
+  const int bmI = static_cast<int>(brgnMod);
+
+  if (SankeyFormat::Long == fmt) {
+    SankeyFile fs(outputFile + "_scenarios.csv");
+    fprintf(fs.f, "%s\n", sankeyScenarioCols);
+    fprintf(fs.f, "%s\n", sankeyScenarioRow(scenId, std::to_string(getSeed()), vpmI, vrI, pcemI, stmI, rngI, adjI, tpcI, ivbI, bmI).c_str());
+
+    SankeyFile fe(outputFile + "_effPowLong.csv");
+    LOG(INFO) << "Record effective power in" << fe.name << "...";
+    fprintf(fe.f, "ScenarioId,Act_i,Actor,Dim_k,EffPow\n");
+    for (unsigned int i = 0; i < numAct; i++) {
+      for (unsigned int k = 0; k < numDim; k++) {
+        fprintf(fe.f, "%s,%u,%s,%u,%.4f\n", scenId.c_str(), i, actrs[i]->name.c_str(), k, effPow(i, k));
+      }
+    }
+
+    SankeyFile fp(outputFile + "_posLong.csv");
+    LOG(INFO) << "Record positions over time in" << fp.name << "...";
+    fprintf(fp.f, "ScenarioId,Act_i,Dim_k,Turn_t,Pos_Coord\n");
+    for (unsigned int i = 0; i < numAct; i++) {
+      for (unsigned int k = 0; k < numDim; k++) {
+        for (unsigned int t = 0; t < history.size(); t++) {
+          fprintf(fp.f, "%s,%u,%u,%u,%.4f\n", scenId.c_str(), i, k, t, posCoord(t, i, k));
+        }
+      }
+    }
+    LOG(INFO) << "done";
+    return;
+  }
+
+  const string headLine = sankeyHeadLine(seed, vpmI, vrI, pcemI, stmI, rngI, adjI, tpcI, ivbI, bmI);
+
+  {
+    SankeyFile f1(outputFile + "_effPow.csv");
+    LOG(INFO) << "Record effective power in" << f1.name << "...";
+    fprintf(f1.f, "%s\n", headLine.c_str());
+    for (unsigned int i = 0; i < numAct; i++) {
+      fprintf(f1.f, "%s", actrs[i]->name.c_str());
+      for (unsigned int k = 0; k < numDim; k++) {
+        // increased precision since we divided by 100 when the saliences were import
+        fprintf(f1.f, ",%5.2f", effPow(i, k));
+      }
+      fprintf(f1.f, "\n");
+    }
+    LOG(INFO) << "done";
+  }
+
+  SankeyFile f2(outputFile + "_posLog.csv");
+  LOG(INFO) << "Record 1D positions over time, without dimension-name in" << f2.name << "...";
+  fprintf(f2.f, "%s\n", headLine.c_str());
+  for (unsigned int i = 0; i < numAct; i++) {
+    fprintf(f2.f, "%s", actrs[i]->name.c_str());
+    for (unsigned int k = 0; k < numDim; k++) {
+      for (unsigned int t = 0; t < history.size(); t++) {
+        fprintf(f2.f, ",%5.2f", posCoord(t, i, k)); // have to print "100.0" sometimes
+      }
+    }
+    fprintf(f2.f, "\n");
+  }
+  LOG(INFO) << "done";
+  return;
+}
+
+// --------------------------------------------
+void SMPModel::sankeyOutput(string outputFile, string dbName, string scenarioId) {
+  sankeyOutput(outputFile, dbName, vector<string>{ scenarioId }, SankeyFormat::Wide);
+  return;
+}
+
+void SMPModel::sankeyOutput(string outputFile, string dbName, const vector<string> & scenarioIds,
+                            SankeyFormat fmt) {
+  QSqlDatabase qdb = QSqlDatabase::addDatabase(dbDriver, QString("sankey"));
+  qdb.setDatabaseName(QString::fromStdString(dbName));
+  if (0 == dbDriver.compare("QPSQL")) {
+    qdb.setHostName(server);
+    qdb.setPort(port);
+
+    if (!qdb.open(userName, password)) {
+      LOG(INFO) << "Could not connect with postgres DB.";
+      LOG(INFO) << qdb.lastError().text().toStdString();
+      throw KException("SMPModel::sankeyOutput: Postgres DB connection failed");
+    }
+  }
+  else if (0 == dbDriver.compare("QSQLITE")) {
+    if (!qdb.open()) {
+      LOG(INFO) << "Could not connect with sqlite DB.";
+      LOG(INFO) << qdb.lastError().text().toStdString();
+      throw KException("SMPModel::sankeyOutput: SQLite DB connection failed");
+    }
+  }
+  else {
+    LOG(INFO) << "Invalid DB driver name";
+    throw KException("SMPModel::sankeyOutput: Invalid DB driver name");
+  }
+
+  auto closeDB = [&qdb]() {
+    qdb.close();
+    qdb = QSqlDatabase();
+    QSqlDatabase::removeDatabase(QString("sankey"));
+  };
+
+  try {
+    QSqlQuery qtQry = QSqlQuery(qdb);
+    qtQry.setForwardOnly(true); // results are only read once, in order
+
+    auto runQuery = [&qtQry](const string & sql, const string & table) {
+      if (!qtQry.exec(QString::fromStdString(sql))) {
+        LOG(INFO) << qtQry.lastError().text().toStdString();
+        throw KException("SMPModel::sankeyOutput: could not read the " + table + " table");
+      }
+    };
+
+    // restrict a table (aliased or not) to the requested scenarios
+    auto scenFilter = [&scenarioIds](const string & col) {
+      if (scenarioIds.empty()) {
+        return string("");
+      }
+      string ids = "";
+      for (const auto & id : scenarioIds) {
+        ids += (ids.empty() ? "'" : ", '") + id + "'";
+      }
+      return " and " + col + " in (" + ids + ")";
+    };
+
+    // the small tables first: parameters and actor names of every scenario
+    map<string, string> headLines = {};
+    vector<string> scenOrder = {};
+    unique_ptr<SankeyFile> fs = nullptr;
+    if (SankeyFormat::Long == fmt) {
+      fs.reset(new SankeyFile(outputFile + "_scenarios.csv"));
+      fprintf(fs->f, "%s\n", sankeyScenarioCols);
+    }
+    runQuery("SELECT ScenarioId, RNGSeed, VictoryProbModel, VotingRule, ProbCondorcetElection, "
+      "StateTransition, BigRRange, BigRAdjust, ThirdPartyCommit, InterVecBrgn, BargnModel "
+      "FROM ScenarioDesc WHERE 1 = 1" + scenFilter("ScenarioId") + " ORDER BY ScenarioId", "ScenarioDesc");
+    while (qtQry.next()) {
+      const string sId = qtQry.value(0).toString().toStdString();
+      const string seed = qtQry.value(1).toString().toStdString();
+      int prm[9];
+      for (unsigned int c = 0; c < 9; c++) {
+        prm[c] = qtQry.value(2 + c).toInt();
+      }
+      scenOrder.push_back(sId);
+      if (SankeyFormat::Long == fmt) {
+        fprintf(fs->f, "%s\n", sankeyScenarioRow(sId, seed, prm[0], prm[1], prm[2], prm[3],
+          prm[4], prm[5], prm[6], prm[7], prm[8]).c_str());
+      }
+      else {
+        headLines[sId] = sankeyHeadLine(seed, prm[0], prm[1], prm[2], prm[3],
+          prm[4], prm[5], prm[6], prm[7], prm[8]);
+      }
+    }
+    fs = nullptr;
+    for (const auto & id : scenarioIds) {
+      if (std::find(scenOrder.begin(), scenOrder.end(), id) == scenOrder.end()) {
+        throw KException("SMPModel::sankeyOutput: no such scenario in the database: " + id);
+      }
+    }
+
+    map<string, vector<string>> actorNames = {};
+    runQuery("SELECT ScenarioId, Name FROM ActorDescription WHERE 1 = 1"
+      + scenFilter("ScenarioId") + " ORDER BY ScenarioId, Act_i", "ActorDescription");
+    while (qtQry.next()) {
+      actorNames[qtQry.value(0).toString().toStdString()].push_back(qtQry.value(1).toString().toStdString());
+    }
+    auto actorName = [&actorNames](const string & sId, unsigned int i) {
+      const auto & names = actorNames[sId];
+      if (i >= names.size()) {
+        throw KException("SMPModel::sankeyOutput: actor " + std::to_string(i) + " is not described in scenario " + sId);
+      }
+      return names[i].c_str();
+    };
+
+    const bool oneScen = (1 == scenarioIds.size());
+    auto wideName = [&outputFile, oneScen](const string & sId, const string & suffix) {
+      return oneScen ? outputFile + suffix : outputFile + "_" + sId + suffix;
+    };
+
+    // Then the big ones, each read in a single pass, ordered so that every file is written
+    // front to back, and one scenario's Wide file is finished before the next is opened.
+    unique_ptr<SankeyFile> fo = nullptr;
+    string curScen = "";
+    int curAct = -1;
+    auto nextRow = [&](const string & sId, int act, const string & suffix) {
+      if (sId != curScen) {
+        if (nullptr != fo) {
+          fprintf(fo->f, "\n");
+        }
+        fo.reset(new SankeyFile(wideName(sId, suffix)));
+        fprintf(fo->f, "%s\n", headLines[sId].c_str());
+        curScen = sId;
+        curAct = -1;
+      }
+      if (act != curAct) {
+        if (0 <= curAct) {
+          fprintf(fo->f, "\n");
+        }
+        fprintf(fo->f, "%s", actorName(sId, act));
+        curAct = act;
+      }
+    };
+    auto finishWide = [&]() {
+      if (nullptr != fo) {
+        fprintf(fo->f, "\n");
+      }
+      fo = nullptr;
+      curScen = "";
+      curAct = -1;
+    };
+
+    // effective power: salience times capability, both at turn 0
+    LOG(INFO) << "Record effective power for" << scenOrder.size() << "scenarios in" << outputFile << "...";
+    if (SankeyFormat::Long == fmt) {
+      fo.reset(new SankeyFile(outputFile + "_effPowLong.csv"));
+      fprintf(fo->f, "ScenarioId,Act_i,Actor,Dim_k,EffPow\n");
+    }
+    runQuery("SELECT S.ScenarioId, S.Act_i, S.Dim_k, S.Sal * C.Cap FROM SpatialSalience S "
+      "INNER JOIN SpatialCapability C ON S.ScenarioId = C.ScenarioId and S.Act_i = C.Act_i and C.Turn_t = 0 "
+      "WHERE S.Turn_t = 0" + scenFilter("S.ScenarioId") + " ORDER BY S.ScenarioId, S.Act_i, S.Dim_k",
+      "SpatialSalience");
+    while (qtQry.next()) {
+      const string sId = qtQry.value(0).toString().toStdString();
+      const unsigned int act = qtQry.value(1).toUInt();
+      const double ep = qtQry.value(3).toDouble();
+      if (SankeyFormat::Long == fmt) {
+        fprintf(fo->f, "%s,%u,%s,%u,%.4f\n", sId.c_str(), act, actorName(sId, act), qtQry.value(2).toUInt(), ep);
+      }
+      else {
+        nextRow(sId, act, "_effPow.csv");
+        fprintf(fo->f, ",%5.2f", ep);
+      }
+    }
+    if (SankeyFormat::Long == fmt) {
+      fo = nullptr;
+    }
+    else {
+      finishWide();
+    }
+
+    // positions, by actor, then dimension, then turn
+    LOG(INFO) << "Record positions over time for" << scenOrder.size() << "scenarios in" << outputFile << "...";
+    if (SankeyFormat::Long == fmt) {
+      fo.reset(new SankeyFile(outputFile + "_posLong.csv"));
+      fprintf(fo->f, "ScenarioId,Act_i,Dim_k,Turn_t,Pos_Coord\n");
+    }
+    runQuery("SELECT ScenarioId, Act_i, Dim_k, Turn_t, Pos_Coord FROM VectorPosition WHERE 1 = 1"
+      + scenFilter("ScenarioId") + " ORDER BY ScenarioId, Act_i, Dim_k, Turn_t", "VectorPosition");
+    while (qtQry.next()) {
+      const string sId = qtQry.value(0).toString().toStdString();
+      const unsigned int act = qtQry.value(1).toUInt();
+      const double pos = qtQry.value(4).toDouble();
+      if (SankeyFormat::Long == fmt) {
+        fprintf(fo->f, "%s,%u,%u,%u,%.4f\n", sId.c_str(), act, qtQry.value(2).toUInt(), qtQry.value(3).toUInt(), pos);
+      }
+      else {
+        nextRow(sId, act, "_posLog.csv");
+        fprintf(fo->f, ",%5.2f", pos);
+      }
+    }
+    if (SankeyFormat::Long == fmt) {
+      fo = nullptr;
+    }
+    else {
+      finishWide();
+    }
+    LOG(INFO) << "done";
+
+    qtQry.finish();
+    qtQry.clear();
+  }
+  catch (...) {
+    closeDB();
+    throw;
+  }
+  closeDB();
+  return;
+}
+
+};
+// end of namespace
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,367 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+//
+// Save an SMP run to a binary snapshot, and rebuild it from one.
+//
+// --------------------------------------------
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include "smp.h"
+
+namespace SMPLib {
+using std::string;
+using std::vector;
+
+using KBase::KMatrix;
+using KBase::KException;
+using KBase::VctrPstn;
+using KBase::State;
+
+// bump the version whenever the layout changes
+static const string snapMagic = "KTABSMP";
+static const uint32_t snapVersion = 1;
+
+// --------------------------------------------
+// Plain values are stored in host byte order, strings with their length first.
+
+static void snapPut(string & b, const void * x, size_t n) {
+  b.append((const char*)x, n);
+  return;
+}
+
+static void snapU32(string & b, uint32_t x) {
+  snapPut(b, &x, sizeof(x));
+  return;
+}
+
+static void snapU64(string & b, uint64_t x) {
+  snapPut(b, &x, sizeof(x));
+  return;
+}
+
+static void snapF64(string & b, double x) {
+  snapPut(b, &x, sizeof(x));
+  return;
+}
+
+static void snapStr(string & b, const string & s) {
+  snapU64(b, s.size());
+  b.append(s);
+  return;
+}
+
+// reads back what the snapPut family wrote, checking that it does not run off the end
+class SnapReader {
+public:
+  explicit SnapReader(const string & b) : buf(b) {}
+
+  void get(void * x, size_t n) {
+    if (buf.size() < at + n) {
+      throw KException("SnapReader::get: snapshot is truncated");
+    }
+    memcpy(x, buf.data() + at, n);
+    at = at + n;
+    return;
+  }
+  uint32_t u32() {
+    uint32_t x = 0;
+    get(&x, sizeof(x));
+    return x;
+  }
+  uint64_t u64() {
+    uint64_t x = 0;
+    get(&x, sizeof(x));
+    return x;
+  }
+  double f64() {
+    double x = 0.0;
+    get(&x, sizeof(x));
+    return x;
+  }
+  string str() {
+    const uint64_t n = u64();
+    if (buf.size() < at + n) {
+      throw KException("SnapReader::str: snapshot is truncated");
+    }
+    string s = buf.substr(at, n);
+    at = at + n;
+    return s;
+  }
+
+private:
+  const string & buf;
+  size_t at = 0;
+};
+
+// --------------------------------------------
+
+void SMPModel::saveSnapshot(string fName) {
+  const unsigned int na = numAct;
+  const unsigned int nd = numDim;
+  const unsigned int ns = history.size();
+  if (0 == ns) {
+    throw KException("SMPModel::saveSnapshot: there is no state to save");
+  }
+
+  string b = "";
+  snapPut(b, snapMagic.c_str(), snapMagic.size() + 1);
+  snapU32(b, snapVersion);
+
+  snapStr(b, scenName);
+  snapStr(b, scenDesc);
+  snapU64(b, getSeed());
+  snapStr(b, rng->getState());
+  snapU64(b, BargainSMP::highestBargainID);
+  const vector<int> params = { (int)vpm, (int)pcem, (int)stm, (int)vrCltn, (int)bigRAdj,
+                               (int)bigRRng, (int)tpCommit, (int)ivBrgn, (int)brgnMod };
+  snapU32(b, params.size());
+  for (auto p : params) {
+    snapU32(b, p);
+  }
+
+  snapU32(b, nd);
+  for (auto dn : dimName) {
+    snapStr(b, dn);
+  }
+  snapU32(b, na);
+  for (auto a : actrs) {
+    auto sa = ((const SMPActor*)a);
+    snapStr(b, sa->name);
+    snapStr(b, sa->desc);
+    snapF64(b, sa->sCap);
+    snapU32(b, (uint32_t)(sa->vr));
+    for (unsigned int d = 0; d < nd; d++) {
+      snapF64(b, sa->vSal(d, 0));
+    }
+  }
+
+  // every state carries the same accommodation forward, so just the last one's
+  auto sLast = ((const SMPState*)(history[ns - 1]));
+  const KMatrix & accM = sLast->accomodate;
+  if ((na != accM.numR()) || (na != accM.numC())) {
+    throw KException("SMPModel::saveSnapshot: accommodation matrix has the wrong size");
+  }
+  snapU32(b, na);
+  for (unsigned int i = 0; i < accM.numR(); i++) {
+    for (unsigned int j = 0; j < accM.numC(); j++) {
+      snapF64(b, accM(i, j));
+    }
+  }
+
+  snapU32(b, ns);
+  for (auto s : history) {
+    auto ss = ((const SMPState*)s);
+    if ((na != ss->pstns.size()) || (na != ss->ideals.size())) {
+      throw KException("SMPModel::saveSnapshot: state is missing positions or ideals");
+    }
+    for (unsigned int i = 0; i < na; i++) {
+      auto pi = ((const VctrPstn*)(ss->pstns[i]));
+      const VctrPstn & ii = ss->ideals[i];
+      for (unsigned int d = 0; d < nd; d++) {
+        snapF64(b, (*pi)(d, 0));
+        snapF64(b, ii(d, 0));
+      }
+    }
+  }
+
+  // Write to a scratch file and rename it, so that a crash part way
+  // through never leaves a damaged snapshot in place of the last good one.
+  waitSnapshot();
+  snapThread = std::thread([b, fName]() {
+    const string tmpName = fName + ".tmp";
+    std::ofstream os(tmpName, std::ios::binary | std::ios::trunc);
+    os.write(b.data(), b.size());
+    os.close();
+    if (os.fail() || (0 != std::rename(tmpName.c_str(), fName.c_str()))) {
+      LOG(INFO) << "SMPModel::saveSnapshot: could not write" << fName;
+      return;
+    }
+    LOG(INFO) << KBase::getFormattedString("Saved snapshot %s (%u bytes)", fName.c_str(), b.size());
+  });
+  return;
+}
+
+
+void SMPModel::waitSnapshot() {
+  if (snapThread.joinable()) {
+    snapThread.join();
+  }
+  return;
+}
+
+
+SMPModel * SMPModel::readSnapshot(string fName, vector<bool> f, int lastTurn) {
+  std::ifstream is(fName, std::ios::binary);
+  if (!is) {
+    throw KException("SMPModel::readSnapshot: could not open " + fName);
+  }
+  const string b((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+  SnapReader rd(b);
+
+  auto magic = string(snapMagic.size() + 1, '\0');
+  rd.get(&magic[0], magic.size());
+  if (0 != snapMagic.compare(magic.c_str())) {
+    throw KException("SMPModel::readSnapshot: " + fName + " is not an SMP snapshot");
+  }
+  if (snapVersion != rd.u32()) {
+    throw KException("SMPModel::readSnapshot: unsupported snapshot version");
+  }
+
+  const string sName = rd.str();
+  const string sDesc = rd.str();
+  const uint64_t seed = rd.u64();
+  const string rngState = rd.str();
+  const uint64_t brgnID = rd.u64();
+  auto params = vector<int>(rd.u32());
+  for (auto & p : params) {
+    p = rd.u32();
+  }
+  // the model parameters, in the order of updateModelParameters, must each name a value of their enum
+  const vector<const vector<string> *> paramNames = { &KBase::VPModelNames, &KBase::PCEModelNames,
+    &KBase::StateTransModeNames, &KBase::VotingRuleNames, &KBase::BigRAdjustNames, &KBase::BigRRangeNames,
+    &KBase::ThirdPartyCommitNames, &InterVecBrgnNames, &SMPBargnModelNames };
+  if (paramNames.size() != params.size()) {
+    throw KException("SMPModel::readSnapshot: snapshot has the wrong number of model parameters");
+  }
+  for (unsigned int k = 0; k < params.size(); k++) {
+    if ((0 > params[k]) || (paramNames[k]->size() <= ((unsigned int)params[k]))) {
+      throw KException("SMPModel::readSnapshot: model parameter " + std::to_string(k)
+        + " is out of range: " + std::to_string(params[k]));
+    }
+  }
+
+  const unsigned int nd = rd.u32();
+  auto dName = vector<string>(nd);
+  for (auto & dn : dName) {
+    dn = rd.str();
+  }
+  const unsigned int na = rd.u32();
+  auto aName = vector<string>(na);
+  auto aDesc = vector<string>(na);
+  auto aVR = vector<VotingRule>(na);
+  auto cap = KMatrix(na, 1);
+  auto sal = KMatrix(na, nd);
+  for (unsigned int i = 0; i < na; i++) {
+    aName[i] = rd.str();
+    aDesc[i] = rd.str();
+    cap(i, 0) = rd.f64();
+    const uint32_t vr = rd.u32();
+    if (KBase::VotingRuleNames.size() <= vr) {
+      throw KException("SMPModel::readSnapshot: voting rule of actor " + std::to_string(i)
+        + " is out of range: " + std::to_string(vr));
+    }
+    aVR[i] = (VotingRule)vr;
+    for (unsigned int d = 0; d < nd; d++) {
+      sal(i, d) = rd.f64();
+    }
+  }
+
+  if (na != rd.u32()) {
+    throw KException("SMPModel::readSnapshot: accommodation matrix has the wrong size");
+  }
+  auto accM = KMatrix(na, na);
+  for (unsigned int i = 0; i < na; i++) {
+    for (unsigned int j = 0; j < na; j++) {
+      accM(i, j) = rd.f64();
+    }
+  }
+
+  unsigned int ns = rd.u32();
+  if (0 == ns) {
+    throw KException("SMPModel::readSnapshot: snapshot has no states");
+  }
+  if (0 <= lastTurn) {
+    if (ns <= ((unsigned int)lastTurn)) {
+      throw KException("SMPModel::readSnapshot: snapshot ends before the requested turn");
+    }
+    ns = lastTurn + 1;
+  }
+  // positions, then ideals, of every state: [numAct, numDim] each
+  auto pos = vector<KMatrix>(ns);
+  auto idl = vector<KMatrix>(ns);
+  for (unsigned int t = 0; t < ns; t++) {
+    pos[t] = KMatrix(na, nd);
+    idl[t] = KMatrix(na, nd);
+    for (unsigned int i = 0; i < na; i++) {
+      for (unsigned int d = 0; d < nd; d++) {
+        pos[t](i, d) = rd.f64();
+        idl[t](i, d) = rd.f64();
+      }
+    }
+  }
+
+  auto sm0 = initModel(aName, aDesc, dName, cap, pos[0], sal, accM, seed, f, sDesc, sName);
+  updateModelParameters(sm0, params);
+  for (unsigned int i = 0; i < na; i++) {
+    ((SMPActor*)(sm0->actrs[i]))->vr = aVR[i];
+  }
+
+  auto setIdeals = [na, nd](SMPState * st, const KMatrix & im) {
+    st->ideals = vector<VctrPstn>();
+    for (unsigned int i = 0; i < na; i++) {
+      auto vi = VctrPstn(nd, 1);
+      for (unsigned int d = 0; d < nd; d++) {
+        vi(d, 0) = im(i, d);
+      }
+      st->ideals.push_back(vi);
+    }
+    return;
+  };
+  setIdeals((SMPState*)(sm0->history[0]), idl[0]);
+
+  for (unsigned int t = 1; t < ns; t++) {
+    auto st = new SMPState(sm0);
+    for (unsigned int i = 0; i < na; i++) {
+      auto vpi = new VctrPstn(nd, 1);
+      for (unsigned int d = 0; d < nd; d++) {
+        (*vpi)(d, 0) = pos[t](i, d);
+      }
+      st->pstns[i] = vpi;
+    }
+    st->setAccomodate(accM);
+    setIdeals(st, idl[t]);
+    st->step = [st]() {
+      return st->stepBCN();
+    };
+    sm0->addState(st);
+  }
+
+  // everything the original run had computed for its states
+  for (auto s : sm0->history) {
+    ((SMPState*)s)->setupStep();
+  }
+
+  sm0->rng->setState(rngState);
+  BargainSMP::highestBargainID = brgnID;
+  LOG(INFO) << KBase::getFormattedString(
+    "Read snapshot %s: %u actors, %u dimensions, %u states", fName.c_str(), na, nd, ns);
+  return sm0;
+}
+
+}; // end of namespace
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
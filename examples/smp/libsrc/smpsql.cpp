@@ -130,6 +130,41 @@ KTable * SMPModel::createSQL(unsigned int n)  {
         grpID = 0;
         break;
     }
+    case 5: // dense turn x actor x dimension cubes of positions and ideals, one row per scenario
+    {
+        // element (t,i,k) is at index (t*NumActors + i)*NumDims + k, as host-order doubles
+        // on the same [0,100] scale as VectorPosition, so the GUI can load a run in one read
+        const string blobType = (0 == dbDriver.compare("QPSQL")) ? "BYTEA" : "BLOB";
+        sql = "create table if not exists PositionCube ("  \
+            "ScenarioId VARCHAR(32) NOT NULL DEFAULT 'None', "\
+            "NumTurns   INTEGER NOT NULL DEFAULT 0, "\
+            "NumActors  INTEGER NOT NULL DEFAULT 0, "\
+            "NumDims    INTEGER NOT NULL DEFAULT 0, "\
+            "Pos_Cube   " + blobType + " NOT NULL, "\
+            "Idl_Cube   " + blobType + " NOT NULL"\
+            ");";
+        name = "PositionCube";
+        grpID = 4; // written along with VectorPosition
+        break;
+    }
+    case 6: // each coordinate move between successive turns, with the bargain which caused it
+    {
+        sql = "create table if not exists PositionMoves ("  \
+            "ScenarioId VARCHAR(32) NOT NULL DEFAULT 'None', "\
+            "Movd_Turn  INTEGER NOT NULL DEFAULT 0, "\
+            "Act_i      INTEGER NOT NULL DEFAULT 0, "\
+            "Dim_k      INTEGER NOT NULL DEFAULT 0, "\
+            "PrevPos    FLOAT NOT NULL DEFAULT 0, "\
+            "CurrPos    FLOAT NOT NULL DEFAULT 0, "\
+            "Diff       FLOAT NOT NULL DEFAULT 0, "\
+            "Mover_BargnId INTEGER NOT NULL DEFAULT 0, "\
+            "Init_Act_i INTEGER NOT NULL DEFAULT 0, "\
+            "Recd_Act_j INTEGER NOT NULL DEFAULT 0"\
+            ");";
+        name = "PositionMoves";
+        grpID = 4; // written along with VectorPosition
+        break;
+    }
     default:
       throw(KException("SMPModel::createSQL unrecognized table number"));
     }
@@ -364,8 +399,7 @@ void SMPModel::LogInfoTables()
 
 
 // --------------------------------------------
-void SMPState::updateBargnTable(const vector<vector<BargainSMP*>> & brgns,
-                                map<unsigned int, KBase::KMatrix>  actorBargains,
+void SMPState::updateBargnTable(map<unsigned int, KBase::KMatrix>  actorBargains,
                                 map<unsigned int, unsigned int>   actorMaxBrgNdx) const {
 
   string sql = string("UPDATE Bargn SET Init_Prob = :init_prob, Init_Seld = :init_seld, "
@@ -421,26 +455,23 @@ void SMPState::updateBargnTable(const vector<vector<BargainSMP*>> & brgns,
   // Update the bargain table for the bargain values for init actor and recd actor
   // along with the info whether a bargain got selected or not in the respective actor's queue
   for (unsigned int i = 0; i < brgns.size(); i++) {
-    auto ai = ((const SMPActor*)(model->actrs[i]));
     double initProb = -0.1;
     int initSelected = -1;
-    auto bargains_i = brgns[i];
+    const auto & bargains_i = brgns[i];
     int initBgnNdx = 0;
     auto initActr = -1;
     auto rcvrActr = -1;
     //uint64_t bgID = 0; // tag uninitialized value
     int countDown = 2; // Stop iterating if cases for i:i and i:j processed
-    for (auto bg : bargains_i) {
-      if (nullptr == bg) {
-        throw KException("SMPState::updateBargnTable: bg is null pointer");
-      }
-      if (bg->actInit == bg->actRcvr) { // For SQ case
-        initActr = model->actrNdx(bg->actInit);
+    for (auto bgNdx : bargains_i) {
+      const BargainSMP & bg = brgnArena[bgNdx];
+      if (bg.initNdx == bg.rcvrNdx) { // For SQ case
+        initActr = bg.initNdx;
         rcvrActr = initActr;
         initProb = (actorBargains[initActr])(initBgnNdx, 0);
         initSelected = initBgnNdx == actorMaxBrgNdx[initActr] ? 1 : 0;
 
-        updateBargn(bg->getID(),
+        updateBargn(bg.getID(),
           initActr, initProb, initSelected,
           rcvrActr, -1.0, 0);
 
@@ -449,29 +480,26 @@ void SMPState::updateBargnTable(const vector<vector<BargainSMP*>> & brgns,
         }
       }
       else {
-        if (ai == bg->actInit) { // this bargain is initiated by current actor
-          initActr = model->actrNdx(bg->actInit);
+        if (i == bg.initNdx) { // this bargain is initiated by current actor
+          initActr = bg.initNdx;
           initProb = (actorBargains[initActr])(initBgnNdx, 0);
           initSelected = initBgnNdx == actorMaxBrgNdx[initActr] ? 1 : 0;
-          rcvrActr = model->actrNdx(bg->actRcvr);
+          rcvrActr = bg.rcvrNdx;
 
           // Get the bargains of receiver actor
-          auto brgnRcvr = brgns[rcvrActr];
+          const auto & brgnRcvr = brgns[rcvrActr];
           int rcvrBgNdx = 0;
           double rcvrProb = -1.0;
           int rcvrSelected = -1;
-          for (auto bgRcv : brgnRcvr) {
-            if (nullptr == bgRcv) {
-              throw KException("SMPState::updateBargnTable: bgRcv is null pointer");
-            }
-            if (ai == bgRcv->actInit) {
+          for (auto bgRcvNdx : brgnRcvr) {
+            if (i == brgnArena[bgRcvNdx].initNdx) {
               rcvrProb = (actorBargains[rcvrActr])(rcvrBgNdx, 0);
 
               // Check if it is the selected bargain for receiver actor
               rcvrSelected = actorMaxBrgNdx[rcvrActr] == rcvrBgNdx ? 1 : 0;
 
               --countDown;
-              updateBargn(bg->getID(),
+              updateBargn(bg.getID(),
                 initActr, initProb, initSelected,
                 rcvrActr, rcvrProb, rcvrSelected);
               break;
@@ -630,6 +658,38 @@ void SMPState::recordProbEduChlg() const {
   return;
 }
 
+// Written at the end of each turn, inside doBCN's transaction, so the GUI can list
+// the moves without self-joining VectorPosition across turns.
+void SMPState::recordPositionMoves() const {
+  string sql = string("INSERT INTO PositionMoves "
+    "(ScenarioId, Movd_Turn, Act_i, Dim_k, PrevPos, CurrPos, Diff, Mover_BargnId, Init_Act_i, Recd_Act_j) "
+    "VALUES ('") + model->getScenarioID() + "', "
+    ":turn_t, :act_i, :dim_k, :prev_pos, :curr_pos, :diff, :bgnId, :init_act_i, :recd_act_j)";
+
+  QSqlQuery query = model->getQuery();
+  query.prepare(QString::fromStdString(sql));
+
+  for (const auto & mv : posMoves) {
+    const double prevPos = get<2>(mv);
+    const double currPos = get<3>(mv);
+    query.bindValue(":turn_t", turn + 1); // the turn whose state has the new position
+    query.bindValue(":act_i", get<0>(mv));
+    query.bindValue(":dim_k", get<1>(mv));
+    query.bindValue(":prev_pos", prevPos);
+    query.bindValue(":curr_pos", currPos);
+    query.bindValue(":diff", currPos - prevPos);
+    query.bindValue(":bgnId", (qulonglong)(get<4>(mv)));
+    query.bindValue(":init_act_i", get<5>(mv));
+    query.bindValue(":recd_act_j", get<6>(mv));
+
+    if (!query.exec()) {
+      LOG(INFO) << query.lastError().text().toStdString();
+      throw KException("SMPState::recordPositionMoves: DB query failed");
+    }
+  }
+  return;
+}
+
 };
 // end of namespace
 
@@ -76,12 +76,19 @@ int main(int ac, char **av) {
   bool randAccP = false;
   bool csvP = false;
   bool xmlP = false;
+  bool snapP = false;
   bool logMin = false;
   bool saveHist = false;
   string inputCSV = "";
   string inputDBname = "";
   string inputXML = "";
+  string inputSnap = "";
   string connstr;
+  SMPLib::SMPStopParams stopPrms;
+  unsigned int ensembleSize = 0;
+  unsigned int snapEvery = 0;
+  unsigned int mergeShards = 0;
+  string traceLvl = "";
 
   auto showHelp = []() {
     printf("\n");
@@ -91,13 +98,41 @@ int main(int ac, char **av) {
     printf("--ra             randomize the adjustment of ideal points with euSMP \n");
     printf("--csv <f>        read a scenario from CSV\n");
     printf("--xml <f>        read a scenario from XML\n");
-    printf("--logmin         log only scenario information + position histories\n");
+    printf("--logmin         log only scenario information + position histories;\n");
+    printf("                 also lowers the trace level to low unless --trace is given\n");
+    printf("--trace <l>      how much detail of each turn to log: silent, low, medium, high,\n");
+    printf("                 or debugging (or 0 to 4)\n");
+    printf("                 or debugging (the default)\n");
     printf("--savehist       export by-dim by-turn position histories (input+'_posLog.csv') and\n");
     printf("                 by-dim actor effective powers (input+'_effPower.csv')\n");
     printf("--seed <n>       set a 64bit seed; default is %020llu; 0 means truly random\n", dSeed);
+    printf("--events <f>     append each turn's bargaining events to the file f, as JSON lines,\n");
+    printf("                 in actor order whatever the thread schedule\n");
+    printf("--profile        log the time spent in each phase of each turn (also to the RunStats table)\n");
+    printf("--profcsv <f>    as --profile, and also append each turn's profile to the CSV file f\n");
+    printf("--maxiter <n>    stop after at most n turns; default is %u\n", SMPLib::SMPStopParams().maxIter);
+    printf("--maxactors <n>  allow scenarios of up to n actors, e.g. from smpgen; default is %u\n",
+           KBase::Model::maxNumActor);
+    printf("--preflight      check the scenario and estimate the cost of the run before starting it,\n");
+    printf("                 refusing to run a bad scenario and skipping hot-path range checks otherwise\n");
+    printf("--dryrun         as --preflight, but stop after the check and the estimate\n");
+    printf("--cycles <q>     detect states repeating earlier ones, comparing positions rounded\n");
+    printf("                 to multiples of q on the [0,100] scale (e.g. 0.01)\n");
+    printf("--cyclestop <n>  stop once the states have gone round a detected cycle n more times;\n");
+    printf("                 uses --cycles 0.01 unless given\n");
+    printf("--ensemble <n>   run n replicas with stochastic state transitions, replica r\n");
+    printf("                 using seed+r; replica 0 is the one logged to the database\n");
+    printf("--checkpoint <n> save a snapshot of the run (input+'.snap') every n turns, and at the end\n");
+    printf("--resume <f>     carry on the run saved in snapshot f, e.g. with a larger --maxiter\n");
+    printf("                 (checkpoints then go to f's name + '_resumed.snap', not to f)\n");
+    printf("--shardmerge <n> after any runs, append the results in shards 0 to n-1 of the SQLite\n");
+    printf("                 database to the database itself, e.g. <DB_name>_shard0.db to <DB_name>.db\n");
+    printf("                 At most %u shards (SQLite's limit on attached databases)\n",
+           KBase::Model::maxMergeShards);
     printf("--connstr        a semicolon separated string for database server credentials:\n");
     printf("                 \"Driver=<QPSQL|QSQLITE>;Server=<IP>*;[Port=<port>]*;Database=<DB_name>;\n");
-    printf("                 Uid=<user_id>*;Pwd=<password>*\"*for QPSQL only\n");
+    printf("                 Uid=<user_id>*;Pwd=<password>*;[Shard=<k>]**\"*for QPSQL only\n");
+    printf("                 **for QSQLITE only: write to <DB_name>_shard<k>.db, e.g. one per sweep worker\n");
   };
 
   if (ac > 1) {
@@ -144,9 +179,152 @@ int main(int ac, char **av) {
       else if (strcmp(av[i], "--logmin") == 0) {
         logMin = true;
       }
+      else if (strcmp(av[i], "--trace") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                traceLvl = av[i];
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--maxactors") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                KBase::Model::maxNumActor = std::stoul(av[i]);
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--preflight") == 0) {
+        SMPLib::SMPModel::preflightMode = SMPLib::SMPPreflightMode::Check;
+      }
+      else if (strcmp(av[i], "--dryrun") == 0) {
+        SMPLib::SMPModel::preflightMode = SMPLib::SMPPreflightMode::DryRun;
+      }
       else if (strcmp(av[i], "--savehist") == 0) {
         saveHist = true;
       }
+      else if (strcmp(av[i], "--events") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                SMPLib::SMPModel::eventFile = av[i];
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--profile") == 0) {
+        KBase::Profiler::enable(true);
+      }
+      else if (strcmp(av[i], "--profcsv") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                KBase::Profiler::enable(true);
+                KBase::Profiler::csvFile = av[i];
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--maxiter") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                stopPrms.maxIter = std::stoul(av[i]);
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--cycles") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                stopPrms.cycleGrid = std::stod(av[i]) / 100.0;
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--cyclestop") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                stopPrms.cycleRepeats = std::stoul(av[i]);
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--ensemble") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                ensembleSize = std::stoul(av[i]);
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--checkpoint") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                snapEvery = std::stoul(av[i]);
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--resume") == 0) {
+        snapP = true;
+        i++;
+        if (av[i] != NULL)
+        {
+                inputSnap = av[i];
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--shardmerge") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                mergeShards = std::stoul(av[i]);
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
       else if(strcmp(av[i], "--connstr") == 0) {
         i++;
         connstr = av[i];
@@ -173,6 +351,34 @@ int main(int ac, char **av) {
     sqlFlags = {true,false,false,false,true};
   }
 
+  // the hot-path tracing costs more than the database logging it accompanies,
+  // so a minimal-logging run skips it too
+  if (!traceLvl.empty()) {
+    try {
+      KBase::Tracer::setLevel(KBase::Tracer::parseLevel(traceLvl));
+    }
+    catch (KBase::KException &ke) {
+      printf("%s\n", ke.msg.c_str());
+      printf("Valid trace levels are silent, low, medium, high and debugging (or 0 to 4)\n");
+      showHelp();
+      return 1;
+    }
+  }
+  else if (logMin) {
+    KBase::Tracer::setLevel(KBase::ReportingLevel::Low);
+  }
+
+  if ((0 < stopPrms.cycleRepeats) && (0.0 >= stopPrms.cycleGrid)) {
+    stopPrms.cycleGrid = 0.01 / 100.0;
+  }
+
+  // refuse before any run, rather than after it
+  if (KBase::Model::maxMergeShards < mergeShards) {
+    printf("Can merge at most %u shards at once, not %u\n", KBase::Model::maxMergeShards, mergeShards);
+    showHelp();
+    return 1;
+  }
+
   if (!run) {
     showHelp();
     return 0;
@@ -217,22 +423,40 @@ int main(int ac, char **av) {
     catch (...) {
       LOG(INFO) << "Exception caught in randomSMP. Check previous messages for error";
     }
+    SMPLib::SMPModel::destroyModel();
   }
   if (csvP) {
-    string scenid = SMPLib::SMPModel::runModel(sqlFlags, inputCSV, seed, saveHist);
+    string scenid = SMPLib::SMPModel::runModel(sqlFlags, inputCSV, seed, saveHist, std::vector<int>(), stopPrms, ensembleSize, snapEvery);
     if (scenid.empty()) {
       LOG(INFO) << "Error: " << KBase::Model::getLastError();
     }
     SMPLib::SMPModel::destroyModel();
   }
   if (xmlP) {
-    string scenid = SMPLib::SMPModel::runModel(sqlFlags, inputXML, seed, saveHist);
+    string scenid = SMPLib::SMPModel::runModel(sqlFlags, inputXML, seed, saveHist, std::vector<int>(), stopPrms, ensembleSize, snapEvery);
     if (scenid.empty()) {
       LOG(INFO) << "Error: " << KBase::Model::getLastError();
     }
     SMPLib::SMPModel::destroyModel();
   }
 
+  if (snapP) {
+    string scenid = SMPLib::SMPModel::runModel(sqlFlags, inputSnap, seed, saveHist, std::vector<int>(), stopPrms, ensembleSize, snapEvery);
+    if (scenid.empty()) {
+      LOG(INFO) << "Error: " << KBase::Model::getLastError();
+    }
+    SMPLib::SMPModel::destroyModel();
+  }
+
+  if (0 < mergeShards) {
+    try {
+      KBase::Model::mergeShards(mergeShards);
+    }
+    catch (KBase::KException &ke) {
+      LOG(INFO) << "Error: " << ke.msg;
+    }
+  }
+
   KBase::displayProgramEnd(sTime);
   return 0;
 }
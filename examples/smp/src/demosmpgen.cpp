@@ -0,0 +1,174 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+//
+// Write synthetic SMP scenarios, of any size and with controllable
+// structure, as CSV, XML or snapshot files; see SMPGenParams.
+//
+// --------------------------------------------
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <easylogging++.h>
+
+#include "smp.h"
+
+
+int main(int ac, char **av) {
+  using std::string;
+  using SMPLib::SMPModel;
+
+  SMPLib::SMPGenParams gp;
+  string csvFile = "";
+  string xmlFile = "";
+  string snapFile = "";
+  bool log = false;
+  bool run = true;
+
+  auto showHelp = [gp]() {
+    printf("\n");
+    printf("Usage: specify one or more of these options\n");
+    printf("--help           print this message\n");
+    printf("--actors <n>     number of actors; default is %u\n", gp.numAct);
+    printf("--dims <n>       number of dimensions; default is %u\n", gp.numDim);
+    printf("--seed <s>       seed for the generator, also written to XML and snapshots\n");
+    printf("--name <s>       scenario name; default is %s\n", gp.name.c_str());
+    printf("--desc <s>       scenario description\n");
+    printf("--clusters <k>   cluster the positions around k centers; default is uniform\n");
+    printf("--spread <x>     standard deviation within a cluster, on [0,100]; default is %.1f\n", gp.clusterSD);
+    printf("--capalpha <a>   Pareto capabilities with tail exponent a; default is uniform\n");
+    printf("--capmin <x>     smallest Pareto capability; default is %.1f\n", gp.capMin);
+    printf("--capmax <x>     largest Pareto capability; default is %.0f\n", gp.capMax);
+    printf("--saldensity <f> fraction of the dimensions each actor attends to; default is %.2f\n", gp.salDensity);
+    printf("--accself <a>    weight of an actor's own position in its new ideal; default is %.2f\n", gp.accSelf);
+    printf("--accblock <b>   weight shared by the rest of its cluster; default is %.2f\n", gp.accBlock);
+    printf("--csv <f>        write the scenario to f as CSV, which has no accommodation\n");
+    printf("--xml <f>        write the scenario to f as XML\n");
+    printf("--snap <f>       write the scenario to f as a snapshot, for smpc --resume\n");
+    printf("--log            log the generation\n");
+    printf("Beyond %u actors, run the scenario with smpc --maxactors.\n", KBase::Model::maxNumActor);
+  };
+
+  auto nextArg = [ac, av, &run](int & i) {
+    i++;
+    if ((i < ac) && (av[i] != NULL)) {
+      return string(av[i]);
+    }
+    run = false;
+    return string();
+  };
+
+  try {
+    for (int i = 1; run && (i < ac); i++) {
+      if (strcmp(av[i], "--actors") == 0) {
+        gp.numAct = std::stoul(nextArg(i));
+      }
+      else if (strcmp(av[i], "--dims") == 0) {
+        gp.numDim = std::stoul(nextArg(i));
+      }
+      else if (strcmp(av[i], "--seed") == 0) {
+        gp.seed = std::stoull(nextArg(i));
+      }
+      else if (strcmp(av[i], "--name") == 0) {
+        gp.name = nextArg(i);
+      }
+      else if (strcmp(av[i], "--desc") == 0) {
+        gp.desc = nextArg(i);
+      }
+      else if (strcmp(av[i], "--clusters") == 0) {
+        gp.numClusters = std::stoul(nextArg(i));
+      }
+      else if (strcmp(av[i], "--spread") == 0) {
+        gp.clusterSD = std::stod(nextArg(i));
+      }
+      else if (strcmp(av[i], "--capalpha") == 0) {
+        gp.capAlpha = std::stod(nextArg(i));
+      }
+      else if (strcmp(av[i], "--capmin") == 0) {
+        gp.capMin = std::stod(nextArg(i));
+      }
+      else if (strcmp(av[i], "--capmax") == 0) {
+        gp.capMax = std::stod(nextArg(i));
+      }
+      else if (strcmp(av[i], "--saldensity") == 0) {
+        gp.salDensity = std::stod(nextArg(i));
+      }
+      else if (strcmp(av[i], "--accself") == 0) {
+        gp.accSelf = std::stod(nextArg(i));
+      }
+      else if (strcmp(av[i], "--accblock") == 0) {
+        gp.accBlock = std::stod(nextArg(i));
+      }
+      else if (strcmp(av[i], "--csv") == 0) {
+        csvFile = nextArg(i);
+      }
+      else if (strcmp(av[i], "--xml") == 0) {
+        xmlFile = nextArg(i);
+      }
+      else if (strcmp(av[i], "--snap") == 0) {
+        snapFile = nextArg(i);
+      }
+      else if (strcmp(av[i], "--log") == 0) {
+        log = true;
+      }
+      else {
+        run = false;
+        printf("Unrecognized argument %s\n", av[i]);
+      }
+    }
+    run = run && ((!csvFile.empty()) || (!xmlFile.empty()) || (!snapFile.empty()));
+    if (!run) {
+      showHelp();
+      return 0;
+    }
+
+    if (!log) {
+      el::Configurations conf;
+      conf.set(el::Level::Global, el::ConfigurationType::Enabled, "false");
+      el::Loggers::reconfigureAllLoggers(conf);
+    }
+
+    const auto sc = SMPModel::genScenario(gp);
+    if (!csvFile.empty()) {
+      SMPModel::writeScenarioCSV(sc, csvFile);
+    }
+    if (!xmlFile.empty()) {
+      SMPModel::writeScenarioXML(sc, xmlFile);
+    }
+    if (!snapFile.empty()) {
+      // building the model checks the actor cap, so lift it as far as needed
+      KBase::Model::maxNumActor = std::max(KBase::Model::maxNumActor, gp.numAct);
+      SMPModel::writeScenarioSnapshot(sc, snapFile);
+    }
+    return 0;
+  }
+  catch (KBase::KException & ke) {
+    printf("%s\n", ke.msg.c_str());
+    return 2;
+  }
+}
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
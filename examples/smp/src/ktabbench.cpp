@@ -0,0 +1,738 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+//
+// Benchmark harness; see ktabbench.h
+//
+// --------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <new>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <easylogging++.h>
+
+#include "ktabbench.h"
+
+
+// -------------------------------------------------
+// Every allocation in the process goes through these, so an SMP case can
+// report how many it made. The counters are touched with relaxed atomics,
+// as the model's worker threads allocate too.
+// They are kept out of line: were GCC to inline malloc into a new and free
+// into a delete, it would warn that the pair is mismatched (which it is not).
+namespace {
+std::atomic<uint64_t> allocCount(0);
+std::atomic<uint64_t> allocBytes(0);
+};
+
+#if defined(__GNUC__)
+#define KTAB_BENCH_NOINLINE __attribute__((noinline))
+#else
+#define KTAB_BENCH_NOINLINE
+#endif
+
+KTAB_BENCH_NOINLINE void* operator new(std::size_t n) {
+  allocCount.fetch_add(1, std::memory_order_relaxed);
+  allocBytes.fetch_add(n, std::memory_order_relaxed);
+  void* p = std::malloc((0 < n) ? n : 1);
+  if (nullptr == p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+KTAB_BENCH_NOINLINE void* operator new[](std::size_t n) {
+  return ::operator new(n);
+}
+
+KTAB_BENCH_NOINLINE void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+KTAB_BENCH_NOINLINE void operator delete[](void* p) noexcept {
+  std::free(p);
+}
+
+
+namespace KTABBench {
+
+using std::get;
+using KBase::KException;
+using KBase::Profiler;
+using KBase::ReportingLevel;
+using KBase::VctrPstn;
+using SMPLib::SMPModel;
+
+namespace {
+
+// find the value following "key": in a line written by toJSON,
+// returning the index of its first character, or npos
+size_t jsonFind(const string & line, const string & key) {
+  const string k = "\"" + key + "\":";
+  size_t n = line.find(k);
+  return (string::npos == n) ? n : n + k.size();
+}
+
+double jsonNum(const string & line, const string & key, double dflt) {
+  const size_t n = jsonFind(line, key);
+  return (string::npos == n) ? dflt : std::strtod(line.c_str() + n, nullptr);
+}
+
+// a line which toJSON could not have written
+[[noreturn]] void badJSON(const string & line, const string & key) {
+  throw KException("KTABBench::fromJSON: malformed \"" + key + "\" in the line " + line);
+}
+
+string jsonStr(const string & line, const string & key) {
+  const size_t n = jsonFind(line, key);
+  if ((string::npos == n) || ('"' != line[n])) {
+    return "";
+  }
+  const size_t e = line.find('"', n + 1);
+  if (string::npos == e) {
+    badJSON(line, key);
+  }
+  return line.substr(n + 1, e - n - 1);
+}
+
+vector<double> jsonNums(const string & line, const string & key) {
+  auto xs = vector<double>();
+  size_t n = jsonFind(line, key);
+  if ((string::npos == n) || ('[' != line[n])) {
+    return xs;
+  }
+  const char * c = line.c_str() + n + 1;
+  if (']' == *c) {
+    return xs;
+  }
+  while (true) {
+    char * e = nullptr;
+    const double x = std::strtod(c, &e);
+    if ((e == c) || ('\0' == *e)) {
+      badJSON(line, key); // not a number, or the line ends before the ']'
+    }
+    xs.push_back(x);
+    if (']' == *e) {
+      return xs;
+    }
+    if (',' != *e) {
+      badJSON(line, key);
+    }
+    c = e + 1;
+  }
+}
+
+vector<ProfRecord> jsonPhases(const string & line) {
+  auto ps = vector<ProfRecord>();
+  size_t n = jsonFind(line, "phases");
+  if ((string::npos == n) || ('{' != line[n])) {
+    return ps;
+  }
+  n++;
+  while ((n < line.size()) && ('"' == line[n])) {
+    const size_t e = line.find('"', n + 1);
+    if ((string::npos == e) || (e + 1 >= line.size()) || (':' != line[e + 1])) {
+      badJSON(line, "phases");
+    }
+    ProfRecord pr;
+    pr.name = line.substr(n + 1, e - n - 1);
+    const char * v = line.c_str() + e + 2;
+    char * c = nullptr;
+    pr.seconds = std::strtod(v, &c);
+    if (c == v) {
+      badJSON(line, "phases");
+    }
+    ps.push_back(pr);
+    n = c - line.c_str();
+    n = ((n < line.size()) && (',' == line[n])) ? n + 1 : n;
+  }
+  if ((n >= line.size()) || ('}' != line[n])) {
+    badJSON(line, "phases");
+  }
+  return ps;
+}
+
+// Each case gets its own database, named after the one in connstr with the
+// case's name appended, so that no case's timing includes appending to the
+// tables of the cases before it. A SQLite file is deleted before the case runs.
+string caseConnStr(const string & connstr, const string & name) {
+  string lc = connstr;
+  std::transform(lc.begin(), lc.end(), lc.begin(), [](unsigned char c) {
+    return std::tolower(c);
+  });
+  const size_t k = lc.find("database");
+  const size_t eq = (string::npos == k) ? k : lc.find('=', k);
+  if (string::npos == eq) {
+    return connstr; // loginCredentials will say what is wrong
+  }
+  size_t v = eq + 1;
+  while ((v < connstr.size()) && (' ' == connstr[v])) {
+    v++;
+  }
+  size_t e = connstr.find(';', v);
+  e = (string::npos == e) ? connstr.size() : e;
+  while ((v < e) && (' ' == connstr[e - 1])) {
+    e--;
+  }
+  string sfx = "_" + name;
+  for (auto & c : sfx) {
+    c = std::isalnum((unsigned char)c) ? c : '_';
+  }
+  string cs = connstr;
+  cs.insert(e, sfx);
+  if (string::npos != lc.find("qsqlite")) {
+    const string dbFile = cs.substr(v, e + sfx.size() - v) + ".db";
+    std::remove(dbFile.c_str());
+  }
+  return cs;
+}
+
+// the SMP part of a case, run in the child process
+BenchResult runSMP(const BenchCase & bc, const RunOptions & ro) {
+  BenchResult br;
+  KBase::Tracer::setLevel(ro.trace);
+  if (ro.log) {
+    KBase::Model::configLogger("./smpc-logger.conf");
+  }
+  else {
+    el::Configurations conf;
+    conf.set(el::Level::Global, el::ConfigurationType::Enabled, "false");
+    el::Loggers::reconfigureAllLoggers(conf);
+  }
+  if (!SMPModel::loginCredentials(caseConnStr(ro.connstr, bc.name))) {
+    fprintf(stderr, "%s: %s\n", bc.name.c_str(), KBase::Model::getLastError().c_str());
+    br.status = 2;
+    return br;
+  }
+
+  Profiler::enable(true);
+  const auto prof0 = Profiler::snapshot();
+  const uint64_t n0 = allocCount.load(std::memory_order_relaxed);
+  const uint64_t b0 = allocBytes.load(std::memory_order_relaxed);
+  const auto t0 = std::chrono::steady_clock::now();
+  try {
+    if (CaseKind::SMPRand == bc.kind) {
+      SMPModel::randomSMP(bc.numAct, bc.numDim, false, bc.seed, ro.sqlFlags);
+    }
+    else if (SMPModel::runModel(ro.sqlFlags, bc.file, bc.seed, false).empty()) {
+      fprintf(stderr, "%s: %s\n", bc.name.c_str(), KBase::Model::getLastError().c_str());
+      br.status = 1;
+    }
+  }
+  catch (KException & ke) {
+    fprintf(stderr, "%s: %s\n", bc.name.c_str(), ke.msg.c_str());
+    br.status = 1;
+  }
+  const auto t1 = std::chrono::steady_clock::now();
+  br.wallSec = std::chrono::duration<double>(t1 - t0).count();
+  br.allocs = allocCount.load(std::memory_order_relaxed) - n0;
+  br.allocBytes = allocBytes.load(std::memory_order_relaxed) - b0;
+  br.phases = Profiler::delta(Profiler::snapshot(), prof0);
+
+  // random scenarios are as reproducible as read ones, so both record their final positions
+  SMPModel * md = SMPModel::getSmpModel();
+  if ((0 == br.status) && (nullptr != md) && (0 < md->history.size())) {
+    br.turns = md->history.size();
+    const KBase::State * st = md->history.back();
+    for (unsigned int i = 0; i < md->numAct; i++) {
+      auto pi = ((const VctrPstn*)(st->pstns[i]));
+      for (unsigned int k = 0; k < md->numDim; k++) {
+        br.result.push_back(100.0 * (*pi)(k, 0));
+      }
+    }
+  }
+  SMPModel::destroyModel();
+  return br;
+}
+
+void writeAll(int fd, const string & s) {
+  size_t done = 0;
+  while (done < s.size()) {
+    const ssize_t n = write(fd, s.data() + done, s.size() - done);
+    if (n <= 0) {
+      return;
+    }
+    done = done + n;
+  }
+  return;
+}
+
+};
+
+// -------------------------------------------------
+vector<BenchCase> readSuite(const string & fName) {
+  std::ifstream in(fName);
+  if (!in.is_open()) {
+    throw KException("KTABBench::readSuite: could not open " + fName);
+  }
+  auto cs = vector<BenchCase>();
+  string line;
+  unsigned int ln = 0;
+  while (std::getline(in, line)) {
+    ln++;
+    const size_t h = line.find('#');
+    if (string::npos != h) {
+      line = line.substr(0, h);
+    }
+    std::istringstream ls(line);
+    string kind;
+    BenchCase bc;
+    if (!(ls >> kind)) {
+      continue; // blank
+    }
+    if (!(ls >> bc.name)) {
+      throw KException(KBase::getFormattedString("KTABBench::readSuite: no case name on line %u of %s",
+                                                 ln, fName.c_str()));
+    }
+    bool ok = true;
+    if ("smpcsv" == kind) {
+      bc.kind = CaseKind::SMPCSV;
+      ok = bool(ls >> bc.file);
+    }
+    else if ("smprand" == kind) {
+      bc.kind = CaseKind::SMPRand;
+      ok = bool(ls >> bc.numAct >> bc.numDim);
+      uint64_t s = 0;
+      if (ok && (ls >> s)) {
+        bc.seed = s;
+      }
+    }
+    else if ("app" == kind) {
+      bc.kind = CaseKind::App;
+      std::getline(ls, bc.cmd);
+      const size_t c0 = bc.cmd.find_first_not_of(" \t");
+      bc.cmd = (string::npos == c0) ? "" : bc.cmd.substr(c0);
+      ok = !bc.cmd.empty();
+    }
+    else {
+      ok = false;
+    }
+    if (!ok) {
+      throw KException(KBase::getFormattedString("KTABBench::readSuite: bad case on line %u of %s",
+                                                 ln, fName.c_str()));
+    }
+    cs.push_back(bc);
+  }
+  return cs;
+}
+
+
+BenchResult runCase(const BenchCase & bc, const RunOptions & ro) {
+  int fds[2];
+  if (0 != pipe(fds)) {
+    throw KException("KTABBench::runCase: could not create a pipe");
+  }
+  fflush(stdout);
+  const auto t0 = std::chrono::steady_clock::now();
+  const pid_t pid = fork();
+  if (pid < 0) {
+    throw KException("KTABBench::runCase: could not fork");
+  }
+  if (0 == pid) {
+    close(fds[0]);
+    if (ro.quiet) {
+      const int dn = open("/dev/null", O_WRONLY);
+      dup2(dn, STDOUT_FILENO);
+      close(dn);
+    }
+    if (CaseKind::App == bc.kind) {
+      close(fds[1]);
+      execl("/bin/sh", "sh", "-c", bc.cmd.c_str(), (char*)nullptr);
+      _exit(127);
+    }
+    const BenchResult br = runSMP(bc, ro);
+    writeAll(fds[1], toJSON(br) + "\n");
+    close(fds[1]);
+    _exit(br.status);
+  }
+
+  close(fds[1]);
+  string line;
+  char buff[4096];
+  ssize_t n = 0;
+  while (0 < (n = read(fds[0], buff, sizeof(buff)))) {
+    line.append(buff, n);
+  }
+  close(fds[0]);
+  int st = 0;
+  struct rusage ru;
+  wait4(pid, &st, 0, &ru);
+  const auto t1 = std::chrono::steady_clock::now();
+
+  BenchResult br = line.empty() ? BenchResult() : fromJSON(line);
+  br.name = bc.name;
+  br.kind = CaseKindNames[static_cast<unsigned int>(bc.kind)];
+  if (CaseKind::App == bc.kind) {
+    br.wallSec = std::chrono::duration<double>(t1 - t0).count();
+  }
+#ifdef __APPLE__
+  br.peakRSSKB = ru.ru_maxrss / 1024; // bytes, on OS X
+#else
+  br.peakRSSKB = ru.ru_maxrss;
+#endif
+  br.status = WIFEXITED(st) ? WEXITSTATUS(st) : 128 + WTERMSIG(st);
+  return br;
+}
+
+
+string toJSON(const BenchResult & br) {
+  string js = KBase::getFormattedString(
+    "{\"name\":\"%s\",\"kind\":\"%s\",\"status\":%i,\"wall_s\":%.6f,\"peak_rss_kb\":%li,"
+    "\"allocs\":%lli,\"alloc_bytes\":%lli,\"turns\":%u,\"phases\":{",
+    br.name.c_str(), br.kind.c_str(), br.status, br.wallSec, br.peakRSSKB,
+    (long long)br.allocs, (long long)br.allocBytes, br.turns);
+  bool first = true;
+  for (const auto & pr : br.phases) {
+    if (0 < pr.calls) {
+      js += KBase::getFormattedString("%s\"%s\":%.6f", first ? "" : ",", pr.name.c_str(), pr.seconds);
+      first = false;
+    }
+  }
+  js += "},\"result\":[";
+  for (unsigned int i = 0; i < br.result.size(); i++) {
+    js += KBase::getFormattedString("%s%.12g", (0 < i) ? "," : "", br.result[i]);
+  }
+  js += "]}";
+  return js;
+}
+
+
+BenchResult fromJSON(const string & line) {
+  BenchResult br;
+  br.name = jsonStr(line, "name");
+  br.kind = jsonStr(line, "kind");
+  br.status = (int)jsonNum(line, "status", 0);
+  br.wallSec = jsonNum(line, "wall_s", 0.0);
+  br.peakRSSKB = (long)jsonNum(line, "peak_rss_kb", -1);
+  br.allocs = (int64_t)jsonNum(line, "allocs", -1);
+  br.allocBytes = (int64_t)jsonNum(line, "alloc_bytes", -1);
+  br.turns = (unsigned int)jsonNum(line, "turns", 0);
+  br.phases = jsonPhases(line);
+  for (auto & pr : br.phases) {
+    pr.calls = 1; // so that it is written out again
+  }
+  br.result = jsonNums(line, "result");
+  return br;
+}
+
+
+void writeResults(const string & fName, const vector<BenchResult> & rs) {
+  std::ofstream out(fName);
+  if (!out.is_open()) {
+    throw KException("KTABBench::writeResults: could not open " + fName);
+  }
+  out << "{\"ktab_bench\":[" << std::endl;
+  for (unsigned int i = 0; i < rs.size(); i++) {
+    out << toJSON(rs[i]) << ((i + 1 < rs.size()) ? "," : "") << std::endl;
+  }
+  out << "]}" << std::endl;
+  return;
+}
+
+
+vector<BenchResult> readResults(const string & fName) {
+  std::ifstream in(fName);
+  if (!in.is_open()) {
+    throw KException("KTABBench::readResults: could not open " + fName);
+  }
+  auto rs = vector<BenchResult>();
+  string line;
+  while (std::getline(in, line)) {
+    if (0 == line.compare(0, 8, "{\"name\":")) {
+      rs.push_back(fromJSON(line));
+    }
+  }
+  return rs;
+}
+
+
+unsigned int compare(const vector<BenchResult> & cur, const vector<BenchResult> & base,
+                     const Tolerances & tol) {
+  // the ratio of current to baseline cost, if both were measured
+  auto ratio = [](double c, double b) {
+    return ((0 <= c) && (0 < b)) ? c / b : -1.0;
+  };
+  auto showRatio = [](double r) {
+    return (r < 0) ? string("       -") : KBase::getFormattedString("%7.3fx", r);
+  };
+
+  unsigned int nBad = 0;
+  printf("%-28s %8s %8s %8s %8s  %s\n", "case", "time", "rss", "allocs", "result", "verdict");
+  for (const auto & c : cur) {
+    const BenchResult * b = nullptr;
+    for (const auto & x : base) {
+      if (x.name == c.name) {
+        b = &x;
+        break;
+      }
+    }
+    if (nullptr == b) {
+      printf("%-28s %8s %8s %8s %8s  %s\n", c.name.c_str(), "-", "-", "-", "-",
+             (0 == c.status) ? "new" : "FAILED");
+      nBad = nBad + ((0 == c.status) ? 0 : 1);
+      continue;
+    }
+    const double rt = ratio(c.wallSec, b->wallSec);
+    const double rm = ratio(c.peakRSSKB, b->peakRSSKB);
+    const double ra = ratio(c.allocs, b->allocs);
+    string res = "-";
+    bool sameRes = true;
+    if ((0 < c.result.size()) || (0 < b->result.size())) {
+      sameRes = (c.result.size() == b->result.size()) && (c.turns == b->turns);
+      for (unsigned int i = 0; sameRes && (i < c.result.size()); i++) {
+        sameRes = (fabs(c.result[i] - b->result[i]) <= tol.result);
+      }
+      res = sameRes ? "same" : "DIFF";
+    }
+    string verdict = "ok";
+    if (0 != c.status) {
+      verdict = "FAILED";
+    }
+    else if (!sameRes) {
+      verdict = "RESULTS CHANGED";
+    }
+    else if ((tol.time < rt) || (tol.mem < rm) || (tol.alloc < ra)) {
+      verdict = "REGRESSION";
+    }
+    else if ((0 < rt) && (rt < 1.0 / tol.time)) {
+      verdict = "faster";
+    }
+    nBad = nBad + ((("ok" == verdict) || ("faster" == verdict)) ? 0 : 1);
+    printf("%-28s %8s %8s %8s %8s  %s\n", c.name.c_str(), showRatio(rt).c_str(),
+           showRatio(rm).c_str(), showRatio(ra).c_str(), res.c_str(), verdict.c_str());
+  }
+
+  // a case which has been dropped must not pass unnoticed
+  for (const auto & b : base) {
+    bool found = false;
+    for (const auto & c : cur) {
+      found = found || (c.name == b.name);
+    }
+    if (!found) {
+      printf("%-28s %8s %8s %8s %8s  %s\n", b.name.c_str(), "-", "-", "-", "-", "MISSING");
+      nBad++;
+    }
+  }
+  return nBad;
+}
+
+}; // end of namespace
+
+
+// -------------------------------------------------
+int main(int ac, char **av) {
+  using std::string;
+  using std::vector;
+  using KTABBench::BenchCase;
+  using KTABBench::BenchResult;
+  using KTABBench::CaseKind;
+
+  string suiteFile = "";
+  string outFile = "ktab_bench.json";
+  string baseFile = "";
+  string only = "";
+  unsigned int repeat = 1;
+  vector<BenchCase> extra = {};
+  KTABBench::Tolerances tol;
+  KTABBench::RunOptions ro;
+  bool run = true;
+
+  auto showHelp = [tol]() {
+    printf("\n");
+    printf("Usage: specify one or more of these options\n");
+    printf("--help           print this message\n");
+    printf("--suite <f>      run the cases listed in f, one per line, each one of\n");
+    printf("                   smpcsv  <name> <file.csv>\n");
+    printf("                   smprand <name> <numActors> <numDims> [seed]\n");
+    printf("                   app     <name> <command line>\n");
+    printf("--rand <AxD,...> also run random SMP scenarios of A actors and D dimensions\n");
+    printf("--only <name>    run only the named case\n");
+    printf("--repeat <n>     run each case n times, keeping the fastest; default is 1\n");
+    printf("--out <f>        write the results to f as JSON; default is ktab_bench.json\n");
+    printf("--baseline <f>   compare the results with those in f, from an earlier --out,\n");
+    printf("                 and exit with 1 if any case failed, changed, or regressed\n");
+    printf("--timetol <x>    wall time may grow by the factor x; default is %.2f\n", tol.time);
+    printf("--memtol <x>     peak memory may grow by the factor x; default is %.2f\n", tol.mem);
+    printf("--alloctol <x>   allocation count may grow by the factor x; default is %.2f\n", tol.alloc);
+    printf("--tol <d>        final positions may differ by d on the [0,100] scale; default is %g\n", tol.result);
+    printf("--connstr <s>    database for the SMP cases, as for smpc; each case gets its own,\n");
+    printf("                 with its name appended, e.g. ktab_bench_SOE_Pol_Comp.db\n");
+    printf("--sqlfull        record all the SMP tables, not just those of smpc --logmin\n");
+    printf("--trace <l>      trace level for the SMP cases; default is low\n");
+    printf("--maxactors <n>  allow SMP cases of up to n actors, e.g. from smpgen\n");
+    printf("--log            log the SMP cases as smpc does, rather than not at all\n");
+    printf("--verbose        show the cases' standard output\n");
+  };
+
+  auto nextArg = [ac, av, &run](int & i) {
+    i++;
+    if ((i < ac) && (av[i] != NULL)) {
+      return string(av[i]);
+    }
+    run = false;
+    return string();
+  };
+
+  try {
+    for (int i = 1; run && (i < ac); i++) {
+      if (strcmp(av[i], "--suite") == 0) {
+        suiteFile = nextArg(i);
+      }
+      else if (strcmp(av[i], "--rand") == 0) {
+        std::istringstream rs(nextArg(i));
+        string sz;
+        while (std::getline(rs, sz, ',')) {
+          BenchCase bc;
+          bc.kind = CaseKind::SMPRand;
+          if (2 != sscanf(sz.c_str(), "%ux%u", &bc.numAct, &bc.numDim)) {
+            run = false;
+            break;
+          }
+          bc.name = "rand-a" + std::to_string(bc.numAct) + "-d" + std::to_string(bc.numDim);
+          extra.push_back(bc);
+        }
+      }
+      else if (strcmp(av[i], "--only") == 0) {
+        only = nextArg(i);
+      }
+      else if (strcmp(av[i], "--repeat") == 0) {
+        repeat = std::stoul(nextArg(i));
+      }
+      else if (strcmp(av[i], "--out") == 0) {
+        outFile = nextArg(i);
+      }
+      else if (strcmp(av[i], "--baseline") == 0) {
+        baseFile = nextArg(i);
+      }
+      else if (strcmp(av[i], "--timetol") == 0) {
+        tol.time = std::stod(nextArg(i));
+      }
+      else if (strcmp(av[i], "--memtol") == 0) {
+        tol.mem = std::stod(nextArg(i));
+      }
+      else if (strcmp(av[i], "--alloctol") == 0) {
+        tol.alloc = std::stod(nextArg(i));
+      }
+      else if (strcmp(av[i], "--tol") == 0) {
+        tol.result = std::stod(nextArg(i));
+      }
+      else if (strcmp(av[i], "--connstr") == 0) {
+        ro.connstr = nextArg(i);
+      }
+      else if (strcmp(av[i], "--sqlfull") == 0) {
+        ro.sqlFlags = { true, true, true, true, true };
+      }
+      else if (strcmp(av[i], "--trace") == 0) {
+        ro.trace = KBase::Tracer::parseLevel(nextArg(i));
+      }
+      else if (strcmp(av[i], "--maxactors") == 0) {
+        KBase::Model::maxNumActor = std::stoul(nextArg(i));
+      }
+      else if (strcmp(av[i], "--log") == 0) {
+        ro.log = true;
+      }
+      else if (strcmp(av[i], "--verbose") == 0) {
+        ro.quiet = false;
+      }
+      else {
+        run = false;
+        printf("Unrecognized argument %s\n", av[i]);
+      }
+    }
+    run = run && ((!suiteFile.empty()) || (0 < extra.size())) && (0 < repeat);
+    if (!run) {
+      showHelp();
+      return 0;
+    }
+
+    auto cases = suiteFile.empty() ? vector<BenchCase>() : KTABBench::readSuite(suiteFile);
+    cases.insert(cases.end(), extra.begin(), extra.end());
+
+    auto results = vector<BenchResult>();
+    for (const auto & bc : cases) {
+      if ((!only.empty()) && (only != bc.name)) {
+        continue;
+      }
+      // the fastest run, but the largest footprint and the worst status of any
+      BenchResult best = KTABBench::runCase(bc, ro);
+      for (unsigned int r = 1; r < repeat; r++) {
+        BenchResult br = KTABBench::runCase(bc, ro);
+        const long rss = std::max(best.peakRSSKB, br.peakRSSKB);
+        const int st = std::max(best.status, br.status);
+        if (br.wallSec < best.wallSec) {
+          best = br;
+        }
+        best.peakRSSKB = rss;
+        best.status = st;
+      }
+      printf("%-28s %10.3f s %10li KB %12lli allocs  %s\n", best.name.c_str(), best.wallSec,
+             best.peakRSSKB, (long long)best.allocs, (0 == best.status) ? "" : "FAILED");
+      results.push_back(best);
+    }
+    KTABBench::writeResults(outFile, results);
+
+    unsigned int nBad = 0;
+    for (const auto & br : results) {
+      nBad = nBad + ((0 == br.status) ? 0 : 1);
+    }
+    if (!baseFile.empty()) {
+      printf("\nCompared with %s\n", baseFile.c_str());
+      auto base = KTABBench::readResults(baseFile);
+      if (!only.empty()) { // the other cases were not meant to run
+        base.erase(std::remove_if(base.begin(), base.end(), [&only](const BenchResult & b) {
+          return (only != b.name);
+        }), base.end());
+      }
+      nBad = KTABBench::compare(results, base, tol);
+    }
+    return (0 == nBad) ? 0 : 1;
+  }
+  catch (KBase::KException & ke) {
+    printf("%s\n", ke.msg.c_str());
+    return 2;
+  }
+  catch (std::exception & se) {
+    // e.g. std::stoul or std::stod on an option value which is not a number
+    printf("Invalid option value: %s\n", se.what());
+    showHelp();
+    return 2;
+  }
+}
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
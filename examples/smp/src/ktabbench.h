@@ -0,0 +1,132 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+//
+// A benchmark harness for KTAB: run a suite of reference scenarios and demo
+// applications, record their cost, and compare it (and the results) with a
+// baseline from an earlier build.
+//
+// Each case runs in a child process of its own, so that its peak resident
+// memory is its own. SMP cases run in-process in that child, which also
+// counts every allocation and reports the profiler's time for each phase.
+// Other applications are run by the shell, and only their wall time, peak
+// memory, and exit status are recorded.
+//
+// --------------------------------------------
+
+#ifndef KTAB_BENCH_H
+#define KTAB_BENCH_H
+
+#include "smp.h"
+
+namespace KTABBench {
+
+using std::string;
+using std::vector;
+using KBase::ProfRecord;
+
+const string appName = "ktab_bench";
+const string appVersion = "0.1";
+
+enum class CaseKind {
+  SMPCSV,  // SMP run of a CSV scenario
+  SMPRand, // SMP run of a random scenario (SMPModel::randomSMP)
+  App      // any other program, run by the shell
+};
+const vector<string> CaseKindNames = {
+  "smpcsv", "smprand", "app" };
+
+// One line of a suite file, which is one of these (# starts a comment)
+//   smpcsv  <name> <file.csv>
+//   smprand <name> <numActors> <numDims> [seed]
+//   app     <name> <command line>
+class BenchCase {
+public:
+  CaseKind kind = CaseKind::App;
+  string name = "";
+  string file = "";
+  unsigned int numAct = 0;
+  unsigned int numDim = 0;
+  uint64_t seed = KBase::dSeed;
+  string cmd = "";
+};
+
+// what a case cost, and what it found. Negative counts were not measured.
+class BenchResult {
+public:
+  string name = "";
+  string kind = "";
+  int status = 0;           // exit status of the case's process
+  double wallSec = 0.0;     // the fastest of the repeats
+  long peakRSSKB = -1;      // the largest of the repeats
+  int64_t allocs = -1;
+  int64_t allocBytes = -1;
+  unsigned int turns = 0;
+  vector<ProfRecord> phases = {};
+  vector<double> result = {}; // final positions, actor-major, on [0,100]
+};
+
+// how far the current run may drift from the baseline before it counts
+// as a regression: ratios for costs, absolute difference for results
+class Tolerances {
+public:
+  double time = 1.25;
+  double mem = 1.25;
+  double alloc = 1.10;
+  double result = 1e-6;
+};
+
+// what the SMP cases log and record
+class RunOptions {
+public:
+  string connstr = "Driver=QSQLITE;Database=ktab_bench";
+  vector<bool> sqlFlags = { true, false, false, false, true };
+  KBase::ReportingLevel trace = KBase::ReportingLevel::Low;
+  bool log = false; // log via smpc-logger.conf, rather than not at all
+  bool quiet = true; // discard the cases' standard output
+};
+
+vector<BenchCase> readSuite(const string & fName);
+BenchResult runCase(const BenchCase & bc, const RunOptions & ro);
+
+// one JSON object, on one line
+string toJSON(const BenchResult & br);
+BenchResult fromJSON(const string & line);
+
+// a file of results as written by writeResults: one case per line
+void writeResults(const string & fName, const vector<BenchResult> & rs);
+vector<BenchResult> readResults(const string & fName);
+
+// print a comparison of each case with its baseline, if it has one,
+// and return the number of regressions, counting any baseline case
+// missing from cur as one
+unsigned int compare(const vector<BenchResult> & cur, const vector<BenchResult> & base,
+                     const Tolerances & tol);
+
+}; // end of namespace
+
+
+// --------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------